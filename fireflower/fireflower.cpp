@@ -11,6 +11,31 @@
 #include <variant>
 #include <thread>
 #include <atomic>
+#include <mutex>
+#include <cerrno>
+#include <cstring>
+#include <random>
+#include <functional>
+#include <string_view>
+#include <span>
+#include <bit>
+
+#ifdef _WIN32
+	#define NOMINMAX
+	#define WIN32_LEAN_AND_MEAN
+	#include <windows.h>
+#elif defined __linux__
+	#include <spawn.h>
+	#include <signal.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <sys/wait.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <sys/inotify.h>
+	#include <poll.h>
+	extern char** environ;
+#endif
 
 #include "common.h"
 #include "rapidjson/document.h"
@@ -129,6 +154,10 @@ inline bool isCompilableFile(const fs::path& p) {
 	return ext == ".cpp" || ext == ".c" || ext == ".s" || ext == ".S";
 }
 
+inline s32 signExtend(u32 value, u32 bits) {
+	return static_cast<s32>(value << (32 - bits)) >> (32 - bits);
+}
+
 
 
 //armv5te
@@ -139,7 +168,11 @@ enum ARMOpcodes : u32 {
 	ARM_BX_R = 0x012FFF10,
 	ARM_BLX_R = 0x012FFF30,
 	ARM_PUSH = 0x09200000,
-	ARM_POP = 0x08B00000
+	ARM_POP = 0x08B00000,
+	ARM_MRS = 0x010F0000,
+	ARM_MSR_F = 0x0128F000,
+	ARM_LDR_PC = 0x051FF004,
+	ARM_LDR_R12 = 0x059FC000
 };
 
 
@@ -151,7 +184,8 @@ enum ThumbOpcodes : u16 {
 	THUMB_BL1 = 0xF800,
 	THUMB_BLX1 = 0xE800,
 	THUMB_PUSH = 0xB400,
-	THUMB_POP = 0xBC00
+	THUMB_POP = 0xBC00,
+	THUMB_NOP = 0x46C0
 };
 
 
@@ -176,9 +210,30 @@ enum ARMConditions : u32 {
 //armv4t has no support for blx instructions
 
 
+//Relocations emitted by gcc/as for the DS processors
+enum ARMRelocations : u32 {
+	R_ARM_NONE = 0,
+	R_ARM_PC24 = 1,
+	R_ARM_ABS32 = 2,
+	R_ARM_REL32 = 3,
+	R_ARM_ABS16 = 5,
+	R_ARM_ABS8 = 8,
+	R_ARM_THM_CALL = 10,
+	R_ARM_CALL = 28,
+	R_ARM_JUMP24 = 29,
+	R_ARM_TARGET1 = 38,
+	R_ARM_V4BX = 40,
+	R_ARM_TARGET2 = 41,
+	R_ARM_PREL31 = 42,
+	R_ARM_THM_JUMP11 = 102,
+	R_ARM_THM_JUMP8 = 103
+};
+
+
 struct BuildSettings {
 
 	std::vector<fs::path> includeDirs;
+	std::vector<fs::path> preludeHeaders;
 	fs::path nitroFSDir;
 	fs::path sourceDir;
 	fs::path toolchainDir;
@@ -186,10 +241,12 @@ struct BuildSettings {
 	fs::path buildDir;
 	fs::path objectDir;
 	fs::path depsDir;
+	fs::path unityDir;
 	fs::path outputFile;
 	fs::path symbol7File;
 	fs::path symbol9File;
 	fs::path libraryDir;
+	fs::path cacheDir;
 
 	std::string prebuildCmd;
 	std::string postbuildCmd;
@@ -210,7 +267,13 @@ struct BuildSettings {
 
 	bool pedantic;
 	bool useAEABI;
+	bool contentHash;
+	bool precompilePrelude;
+	bool internalLinker;
+	bool analyzeSafeHooks;
 	u32 threadCount;
+	u32 unitySize;
+	u64 cacheMaxSize;
 
 };
 
@@ -228,6 +291,16 @@ struct PatchSettings {
 
 	} arm9, arm7;
 
+	struct OverlaySettings {
+
+		u32 start;
+		u32 end;
+		u32 initSize;
+
+	};
+
+	std::map<CodeTarget, OverlaySettings> overlays;
+
 };
 
 
@@ -253,6 +326,15 @@ struct SectionData {
 };
 
 
+struct SectionWrite {
+
+	u32 address;
+	u32 value;
+	u32 size;
+
+};
+
+
 enum class HookType {
 	None,
 	Hook,
@@ -268,6 +350,21 @@ struct Hook {
 	HookType hookType;
 	u32 hookAddress;
 	u32 funcAddress;
+	u32 safeRegisters;
+	bool safeFlags;
+
+};
+
+constexpr u32 allSafeRegisters = 0x5FFF;
+constexpr u32 callerSavedRegisters = 0x100F;
+
+
+//Registers and flags written by the function of a safe hook
+struct SafeHookUsage {
+
+	u32 registers;
+	bool flags;
+	bool external;
 
 };
 
@@ -281,6 +378,10 @@ struct Patch {
 	u32 binSize;
 	u32 bssSize;
 	u32 bssAlign;
+	u32 initStart = 0;
+	u32 initEnd = 0;
+	u32 veneerStart = 0;
+	u32 veneerEnd = 0;
 
 };
 
@@ -303,35 +404,218 @@ struct OverlayEntry {
 };
 
 
+struct FileState {
+
+	u64 time;
+	u64 size;
+	u64 hash;
+
+};
+
+
+struct FileTreeEntry {
+
+	fs::path path;
+	fs::file_type type;
+	u64 time;
+	u64 size;
+
+};
+
+
+struct FileTree {
+
+	std::map<std::string, FileTreeEntry> entries;
+
+};
+
+
 struct DependencyTracker {
 
-	std::unordered_map<std::string, u64> dependencies;
-	std::unordered_map<std::string, u64> trackers;
-	std::unordered_map<std::string, u64> oldTrackers;
+	constexpr inline static u32 magic = 0x52544646;
+	constexpr inline static u32 version = 4;
+
+	std::vector<std::string> files;
+	std::unordered_map<std::string, FileState> dependencies;
+	std::unordered_map<std::string, std::vector<u32>> graph;
+	std::unordered_map<std::string, u64> fingerprints;
+	std::unordered_map<std::string, u32> durations;
+
+	std::unordered_map<std::string, FileState> trackers;
+	std::unordered_map<std::string, std::vector<std::string>> graphTrackers;
+	std::unordered_map<std::string, u64> fingerprintTrackers;
+	std::unordered_map<std::string, u32> durationTrackers;
+
+	std::unordered_map<std::string, FileState> fileStates;
 	std::unordered_set<std::string> compilationObjects;
+	const FileTree* fileTree = nullptr;
+	bool objectsChanged = false;
 
 	u64 jsonTrackedModifiedTime = -1;
 	u64 jsonLastModifiedTime = 0;
 
+	bool contentHash = false;
+
 };
 
 
 
 typedef std::map<CodeTarget, OverlayEntry> OverlayTable;
 typedef std::unordered_map<CodeTarget, std::set<fs::path>> CodeTargetMap;
-typedef std::unordered_multimap<CodeTarget, SectionData> SectionMap;
+typedef std::unordered_map<CodeTarget, std::vector<SectionData>> SectionMap;
 typedef std::unordered_map<std::string, Hook> HookMap;
 typedef std::unordered_map<CodeTarget, u32> SafeMap;
+typedef std::unordered_map<CodeTarget, u32> VeneerCountMap;
 typedef std::unordered_map<std::string, fs::path> FileIDSymbols;
 typedef std::vector<Patch> PatchList;
 typedef std::variant<Patch, Hook> Fixup;
 
 
+//Shared branch stub in the veneer pool of the target holding the hook function
+struct Veneer {
+
+	CodeTarget codeTarget;
+	u32 address;
+
+};
+
+//Keyed by processor (true for the arm9) and function address, since both processors may use the same addresses
+typedef std::map<std::pair<bool, u32>, Veneer> VeneerMap;
+
+
+struct ObjectHook {
+
+	std::string symbol;
+	Hook hook;
+
+};
+
+
+struct ObjectHooks {
+
+	std::vector<ObjectHook> hooks;
+	u32 safeBytes;
+	u32 veneerBytes;
+	u64 time;
+	u64 size;
+	u64 hash;
+
+};
+
+typedef std::unordered_map<std::string, ObjectHooks> ObjectHookMap;
+
+
+struct ElfImage {
+
+	const u8* data = nullptr;
+	u64 size = 0;
+	u32 sectionHeaders = 0;
+	u16 sectionCount = 0;
+	u32 namesOffset = 0;
+	u32 namesSize = 0;
+
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = nullptr;
+#endif
+
+};
+
+
+struct ElfSection {
+
+	std::string_view name;
+	u32 type;
+	u32 flags;
+	u32 address;
+	u32 offset;
+	u32 size;
+	u32 link;
+	u32 info;
+	u32 align;
+
+};
+
+
+struct ElfSymbol {
+
+	std::string_view name;
+	u32 value;
+	u32 size;
+	u8 type;
+	u8 binding;
+	u16 section;
+
+};
+
+
+struct LinkedImages {
+
+	ElfImage arm7;
+	ElfImage arm9;
+	std::vector<u8> output7;
+	std::vector<u8> output9;
+
+	inline ElfImage& getImage(bool arm9Image) {
+		return arm9Image ? arm9 : arm7;
+	}
+
+	inline std::vector<u8>& getOutput(bool arm9Output) {
+		return arm9Output ? output9 : output7;
+	}
+
+	//Either the mapped ELF file of ld or the section data produced by the internal linker
+	inline std::span<const u8> getLinkedData(bool arm9Image) const {
+
+		const ElfImage& image = arm9Image ? arm9 : arm7;
+		const std::vector<u8>& output = arm9Image ? output9 : output7;
+
+		return image.data ? std::span<const u8>(image.data, image.size) : std::span<const u8>(output);
+
+	}
+
+};
+
+
+struct LinkerObject {
+
+	fs::path path;
+	CodeTarget target;
+	ElfImage image{};
+	ElfSection symtab{};
+	ElfSection strtab{};
+	std::vector<ElfSection> sections{};
+	std::vector<u32> addresses{};
+	std::vector<u32> offsets{};
+
+};
+
+
+struct LinkerSymbol {
+
+	u32 address;
+	bool thumb;
+	bool weak;
+	bool placed;
+	u32 object;
+
+};
+
+typedef std::unordered_map<std::string_view, LinkerSymbol> LinkerSymbolMap;
+
+constexpr u32 unplacedSection = 0xFFFFFFFF;
+constexpr u32 noLinkerObject = 0xFFFFFFFF;
+
+constexpr u32 hookTableMagic = 0x4B484646;
+constexpr u32 hookTableVersion = 4;
+
+
 struct HookSymbols {
 
 	HookMap hooks7;
 	HookMap hooks9;
 	SafeMap safeCounts;
+	VeneerCountMap veneerCounts;
 
 	inline HookMap& getSymbolMap(bool arm9) {
 		return arm9 ? hooks9 : hooks7;
@@ -341,75 +625,327 @@ struct HookSymbols {
 		safeCounts[target] += bytes;
 	}
 
+	inline void incVeneer(CodeTarget target, u32 bytes) {
+		veneerCounts[target] += bytes;
+	}
+
+};
+
+
+struct LinkStage {
+
+	CodeTargetMap codeTargets;
+	ObjectHookMap objectHooks;
+	HookSymbols hookSymbols;
+	std::vector<Fixup> fixups;
+	std::thread thread;
+	u64 inputHash;
+	bool started;
+	bool successful;
+
+};
+
+
+struct ObjectCache {
+
+	fs::path directory;
+	std::vector<std::string> basePaths;
+	std::vector<std::string> flags;
+	u64 maxSize;
+	u64 compilerHash;
+	u32 hits;
+	u32 misses;
+	bool enabled;
+
+};
+
+
+struct PrecompiledHeader {
+
+	fs::path headerPath;
+	u64 stamp;
+
+};
+
+typedef std::unordered_map<std::string, PrecompiledHeader> PrecompiledHeaderMap;
+
+
+struct UnitySource {
+
+	CodeTarget target;
+	std::vector<fs::path> sources;
+	fs::path splitPath;
+
+};
+
+typedef std::unordered_map<std::string, UnitySource> UnitySourceMap;
+
+
+struct Process {
+
+#ifdef _WIN32
+	HANDLE handle;
+	HANDLE job;
+	HANDLE output;
+#else
+	pid_t pid;
+	int output;
+#endif
+
+};
+
+
+struct ProcessJob {
+
+	std::vector<std::string> args;
+	std::string info;
+	std::string output;
+	s32 status;
+	u32 priority;
+	u32 duration;
+	std::function<void()> finished;
+
+};
+
+
+struct JobServer {
+
+#ifdef _WIN32
+	HANDLE semaphore = nullptr;
+#else
+	int readFd = -1;
+	int writeFd = -1;
+#endif
+
+	//Cleared by any job thread that fails to talk to the jobserver
+	std::atomic_bool client = false;
+
+	//MAKEFLAGS of the parent environment, restored once the own jobserver stops
+	std::string makeFlags;
+	bool makeFlagsSet = false;
+
+};
+
+
+struct WatchedDirectory {
+
+	fs::path path;
+	bool recursive;
+
+#ifdef _WIN32
+	HANDLE handle;
+	OVERLAPPED overlapped;
+	alignas(DWORD) u8 buffer[0x8000];
+#endif
+
+};
+
+
+struct FileWatcher {
+
+#ifdef _WIN32
+	std::vector<WatchedDirectory*> directories;
+#else
+	int fd = -1;
+	std::unordered_map<int, WatchedDirectory> directories;
+#endif
+
+};
+
+
+struct BuildContext {
+
+	Document document;
+	BuildSettings buildSettings;
+	PatchSettings patchSettings;
+	FileIDSymbols fidSymbols;
+	CodeTargetMap codeTargets;
+	OverlayTable ovt;
+	DependencyTracker tracker;
+	ObjectCache objectCache;
+	FileTree fileTree;
+	ObjectHookMap objectHooks;
+	u64 linkInputs;
+	bool outputsValid;
+
 };
 
 const std::string& buildTargetFilename = "buildroot.txt";
 fs::path jsonPath;
+std::unordered_map<std::string, std::vector<u8>> backupFileCache;
+JobServer jobServer;
+
+#ifndef _WIN32
+//Process groups of running children, read by the signal handler
+std::atomic<pid_t> processGroups[256];
+#endif
+
+bool configureBuild(BuildContext& context);
+bool runBuild(BuildContext& context, bool incremental);
+bool watchBuild();
 
 bool loadBuildSettings(Document& root);
 
 bool populateBuild(Document& root, BuildSettings& settings);
 bool populatePatch(Document& root, PatchSettings& settings, const OverlayTable& ovt);
 bool populateBinarySettings(const Value& jsonNode, PatchSettings::BinarySettings& settings);
+bool populateOverlaySettings(const Value& jsonNode, CodeTarget target, const OverlayTable& ovt, PatchSettings::OverlaySettings& settings);
 bool populateFileIDs(const BuildSettings& settings, Document& root, FileIDSymbols& fidSymbols);
-bool populateCodeTargets(const BuildSettings& settings, Document& root, CodeTargetMap& codeTargets);
+bool populateCodeTargets(const BuildSettings& settings, Document& root, const FileTree& tree, CodeTargetMap& codeTargets);
 
 bool createDirectory(const fs::path& p, const std::string& name);
-bool createObjectDirectories(const BuildSettings& settings);
-bool createDependencyDirectories(const BuildSettings& settings);
-bool compileSource(const BuildSettings& settings, const CodeTargetMap& targets, DependencyTracker& tracker);
-bool collectHooks(const BuildSettings& settings, CodeTargetMap& codeTargets, HookSymbols& hookSymbols);
-bool generateLinkerScripts(const BuildSettings& buildSettings, const PatchSettings& patchSettings, CodeTargetMap& targets, HookSymbols& hookSymbols);
-bool linkSource(const BuildSettings& settings);
-bool parseElf(const BuildSettings& settings, HookSymbols& hookSymbols, std::vector<Fixup>& fixups);
-bool patchBinaries(const BuildSettings& buildSettings, const PatchSettings& patchSettings, OverlayTable& ovt, const std::vector<Fixup>& fixups);
+bool createBuildDirectories(const BuildSettings& settings, FileTree& tree);
+bool generateUnitySources(const BuildSettings& settings, CodeTargetMap& codeTargets, UnitySourceMap& unitySources);
+bool compileSource(const BuildSettings& settings, CodeTargetMap& codeTargets, const UnitySourceMap& unitySources, DependencyTracker& tracker, ObjectCache& cache, ObjectHookMap& objectHooks, const std::function<void(bool)>& processorCompiled);
+bool splitUnitySources(const BuildSettings& settings, CodeTargetMap& codeTargets, const UnitySourceMap& unitySources, const std::set<std::string>& units, DependencyTracker& tracker, ObjectCache& cache, ObjectHookMap& objectHooks);
+bool precompileHeaders(const BuildSettings& settings, const CodeTargetMap& codeTargets, const std::vector<std::string>& includeFlags, DependencyTracker& tracker, PrecompiledHeaderMap& headers);
+u64 getPreludeStamp(DependencyTracker& tracker, const fs::path& headerPath, u64 fingerprint);
+void getPreludeHeaders(const BuildSettings& settings, bool assembly, std::vector<fs::path>& headers);
+std::string getPreludeVariant(CodeTarget target, const std::string& extension);
+bool collectHooks(const BuildSettings& settings, const CodeTargetMap& codeTargets, ObjectHookMap& objectHooks, HookSymbols& hookSymbols, u64& objectsHash);
+void pruneObjectHooks(const BuildSettings& settings, const CodeTargetMap& codeTargets, ObjectHookMap& objectHooks);
+bool parseObjectHooks(const BuildSettings& settings, const fs::path& objPath, ObjectHooks& hooks);
+void loadHookTable(const BuildSettings& settings, const FileTree* tree, ObjectHookMap& objectHooks);
+void saveHookTable(const BuildSettings& settings, const ObjectHookMap& objectHooks);
+bool linkProcessor(const BuildSettings& settings, const PatchSettings& patchSettings, bool arm9, LinkStage& stage, LinkedImages& images);
+bool checkOverlayTargets(const PatchSettings& patchSettings, const CodeTargetMap& codeTargets);
+void generateLinkerScript(const BuildSettings& buildSettings, const PatchSettings& patchSettings, const CodeTargetMap& codeTargets, bool arm9, HookSymbols& hookSymbols, std::string& linkerScript);
+bool linkSource(const BuildSettings& settings, bool arm9);
+bool linkObjects(const BuildSettings& settings, const PatchSettings& patchSettings, const CodeTargetMap& codeTargets, bool arm9, HookSymbols& hookSymbols, std::vector<Fixup>& fixups, LinkedImages& images);
+bool loadLinkerObject(LinkerObject& object);
+bool loadSymbolFile(const fs::path& p, std::string& content, LinkerSymbolMap& symbols);
+bool layoutLinkerSections(const PatchSettings& patchSettings, bool arm9, std::vector<LinkerObject>& objects, HookSymbols& hookSymbols, std::vector<u8>& output, std::vector<Fixup>& fixups);
+bool resolveLinkerSymbols(const std::vector<LinkerObject>& objects, LinkerSymbolMap& symbols);
+LinkerSymbol getLinkerSymbol(const LinkerObject& object, const ElfSymbol& symbol, u32 objectIndex);
+bool relocateLinkerSections(const std::vector<LinkerObject>& objects, const LinkerSymbolMap& symbols, bool arm9, std::vector<u8>& output);
+bool applyRelocation(u8* location, u32 type, u32 place, u32 address, bool thumb, bool arm9, bool rela, s32 addend, std::string& error);
+void resolveHookAddresses(const std::vector<LinkerObject>& objects, HookMap& hooks);
+bool parseElf(const BuildSettings& settings, bool arm9, HookSymbols& hookSymbols, std::vector<Fixup>& fixups, LinkedImages& images);
+void appendHookFixups(HookSymbols& hookSymbols, std::vector<Fixup>& fixups);
+bool openElfImage(const fs::path& p, ElfImage& image);
+void closeElfImage(ElfImage& image);
+bool getElfSection(const ElfImage& image, u32 index, ElfSection& section);
+bool getElfSymbol(const ElfImage& image, const ElfSection& symtab, const ElfSection& strtab, u32 index, ElfSymbol& symbol);
+std::string_view getElfString(const ElfImage& image, u32 tableOffset, u32 tableSize, u32 offset);
+bool getElfData(const ElfImage& image, u32 offset, u32 size, const u8*& data);
+void closeLinkedImages(LinkedImages& images);
+bool patchBinaries(const BuildSettings& buildSettings, const PatchSettings& patchSettings, OverlayTable& ovt, const std::vector<Fixup>& fixups, const LinkedImages& images, std::vector<fs::path>& changedOutputs);
+bool patchTarget(const BuildSettings& buildSettings, const PatchSettings& patchSettings, OverlayTable& ovt, std::span<const Fixup> fixups, const LinkedImages& images, const VeneerMap& veneers, std::mutex& patchMutex, std::vector<fs::path>& changedOutputs);
+bool patchTargetCopy(const BuildSettings& buildSettings, const PatchSettings& patchSettings, CodeTarget currentTarget, OverlayEntry& entry, std::span<const Fixup> fixups, const LinkedImages& images, const VeneerMap& veneers, std::mutex& patchMutex, std::vector<fs::path>& changedOutputs, std::ostream& log);
+bool assignVeneers(const std::vector<Fixup>& fixups, VeneerMap& veneers);
+bool needsVeneer(HookType hookType, bool hookThumb, bool funcThumb, bool arm9);
+u32 getVeneerSize(bool arm9);
+bool encodeARMBranch(u32 opcode, u32 source, u32 destination, u32& encoded);
+bool encodeThumbBranch(u16 suffix, u32 source, u32 destination, u32& encoded);
 bool generateFileIDs(const BuildSettings& settings, const DependencyTracker& tracker, const OverlayTable& ovt, const FileIDSymbols& fidSymbols);
+bool writeFileIfChanged(const fs::path& p, const std::string& content, const std::string& name);
+bool writeOutputFile(const fs::path& p, std::span<const u8> data, const std::string& name, std::vector<fs::path>& changedOutputs);
 
 bool executePrebuildCommand(const BuildSettings& buildSettings);
 bool executePostbuildCommand(const BuildSettings& buildSettings);
 
+bool executeJobs(std::vector<ProcessJob>& jobs, u32 threadCount, bool pedantic);
+bool spawnProcess(const std::vector<std::string>& args, Process& process);
+std::string readProcessOutput(Process& process);
+s32 waitProcess(Process& process);
+void killProcess(const Process& process);
+#ifndef _WIN32
+void forwardSignal(int signal);
+#endif
+std::vector<std::string> splitArguments(const std::string& s);
+std::string quoteArgument(const std::string& arg);
+
+void initJobServer(JobServer& server);
+bool acquireJobToken(JobServer& server, s32& token, const std::function<bool()>& keepWaiting);
+void releaseJobToken(JobServer& server, s32 token);
+bool startJobServer(JobServer& server, u32 slots);
+void stopJobServer(JobServer& server);
+
+bool openFileWatcher(FileWatcher& watcher);
+bool addWatchDirectory(FileWatcher& watcher, const fs::path& dir, bool recursive);
+bool waitFileChanges(FileWatcher& watcher, std::set<fs::path>& changes);
+void closeFileWatcher(FileWatcher& watcher);
+
+#ifdef _WIN32
+bool readDirectoryChanges(WatchedDirectory& directory);
+#endif
+
 void loadDependencies(const BuildSettings& settings, DependencyTracker& tracker);
-void trackDependencies(const BuildSettings& settings, DependencyTracker& tracker, const fs::path& dep, bool old);
+void trackDependencies(DependencyTracker& tracker, const fs::path& source, const fs::path& dep, bool old);
+bool parseDependencyFile(const fs::path& dep, std::vector<std::string>& paths);
 void saveDependencies(const BuildSettings& settings, DependencyTracker& tracker);
-
-void write(const SectionMap& sections, CodeTarget target, u32 address, const std::vector<u8>& data, std::vector<u8>& binary);
-u32 readWord(const SectionMap& sections, CodeTarget target, u32 address, std::vector<u8>& binary);
-void writeWord(const SectionMap& sections, CodeTarget target, u32 address, u32 value, std::vector<u8>& binary);
-void writeHalfword(const SectionMap& sections, CodeTarget target, u32 address, u16 value, std::vector<u8>& binary);
-bool getSectionAddressOffset(const SectionMap& sections, CodeTarget target, u32 address, u32 size, u32& offset);
-void checkSafeInstruction(u32 opcode);
-
-bool fixBinarySections(SectionMap& sections, CodeTarget target, u32 offset);
-bool addBinarySections(SectionMap& sections, CodeTarget target, const ARMBinaryProperties& properties, const std::vector<u8>& binary);
-
-bool loadBinary(const BuildSettings& settings, CodeTarget target, ARMBinaryProperties& properties, std::vector<u8>& binary);
-bool saveBinary(const BuildSettings& settings, CodeTarget target, const ARMBinaryProperties& properties, std::vector<u8>& binary, bool compress);
-bool loadOverlay(const BuildSettings& settings, CodeTarget target, std::vector<u8>& binary);
-bool saveOverlay(const BuildSettings& settings, CodeTarget target, std::vector<u8>& binary, OverlayTable& ovt);
+void promoteDependencies(DependencyTracker& tracker);
+
+bool initObjectCache(const BuildSettings& settings, ObjectCache& cache);
+bool getCacheKey(const ObjectCache& cache, const fs::path& preprocessedPath, const std::vector<std::string>& args, u64& key);
+void normalizeCachePaths(const ObjectCache& cache, std::string& s);
+fs::path getCachePath(const ObjectCache& cache, u64 key);
+bool fetchCachedObject(const ObjectCache& cache, u64 key, const fs::path& objectPath);
+void storeCachedObject(const ObjectCache& cache, u64 key, const fs::path& objectPath);
+void trimObjectCache(const ObjectCache& cache);
+
+void write(const SectionMap& sections, CodeTarget target, u32 address, std::span<const u8> data, std::vector<u8>& binary, std::ostream& log);
+u32 readWord(const SectionMap& sections, CodeTarget target, u32 address, std::vector<u8>& binary, std::ostream& log);
+void writeWord(const SectionMap& sections, CodeTarget target, u32 address, u32 value, std::vector<u8>& binary, std::ostream& log);
+void writeHalfword(const SectionMap& sections, CodeTarget target, u32 address, u16 value, std::vector<u8>& binary, std::ostream& log);
+void writeSections(const SectionMap& sections, CodeTarget target, std::vector<SectionWrite>& writes, std::vector<u8>& binary, std::ostream& log);
+bool getSectionAddressOffset(const SectionMap& sections, CodeTarget target, u32 address, u32 size, u32& offset, std::ostream& log);
+void reportSectionMiss(const SectionMap& sections, CodeTarget target, u32 address, u32 size, std::ostream& log);
+void addSection(SectionMap& sections, CodeTarget target, const SectionData& section);
+void checkSafeInstruction(u32 opcode, std::ostream& log);
+u32 getSafeThunkSize(const Hook& hook);
+void analyzeSafeHook(const ElfImage& image, const ElfSection& section, const std::vector<ElfSection>& relocationSections, const std::vector<ElfSymbol>& mappingSymbols, u32 sectionIndex, bool thumb, Hook& hook);
+void analyzeARMInstruction(u32 opcode, u32 offset, u32 size, bool relocated, SafeHookUsage& usage);
+void analyzeThumbInstruction(u16 opcode, u32 offset, u32 size, bool relocated, SafeHookUsage& usage);
+
+bool fixBinarySections(SectionMap& sections, CodeTarget target, u32 offset, std::ostream& log);
+bool addBinarySections(SectionMap& sections, CodeTarget target, const ARMBinaryProperties& properties, const std::vector<u8>& binary, std::ostream& log);
+
+bool loadBinary(const BuildSettings& settings, CodeTarget target, ARMBinaryProperties& properties, std::vector<u8>& binary, std::ostream& log);
+bool saveBinary(const BuildSettings& settings, CodeTarget target, const ARMBinaryProperties& properties, std::vector<u8>& binary, bool compress, std::mutex& patchMutex, std::vector<fs::path>& changedOutputs, std::ostream& log);
+bool loadOverlay(const BuildSettings& settings, CodeTarget target, std::vector<u8>& binary, std::ostream& log);
+bool saveOverlay(const BuildSettings& settings, CodeTarget target, std::vector<u8>& binary, OverlayEntry& entry, std::vector<fs::path>& changedOutputs, std::ostream& log);
+bool compressOverlay(std::vector<u8>& binary);
 bool loadOverlayTable(const BuildSettings& settings, OverlayTable& ovt);
-bool saveOverlayTable(const BuildSettings& settings, const OverlayTable& ovt);
+bool saveOverlayTable(const BuildSettings& settings, const OverlayTable& ovt, std::vector<fs::path>& changedOutputs);
 
 bool backupNitroFSFile(const BuildSettings& settings, const std::string& path);
 bool backupFiles(const BuildSettings& settings, OverlayTable& ovt);
+bool loadBackupFile(const fs::path& p, std::vector<u8>& data);
 bool loadROMHeader(const BuildSettings& settings, std::vector<u8>& header);
 
-bool loadPatch(const BuildSettings& settings, const Patch& patch, std::vector<u8>& data);
-void patchBinary(const BuildSettings& settings, const Patch& patchInfo, const std::vector<u8>& patch, const ARMBinaryProperties& properties, std::vector<u8>& binary);
+bool getPatchData(const LinkedImages& images, const Patch& patch, std::span<const u8>& data, std::ostream& log);
+void patchBinary(const BuildSettings& settings, const Patch& patchInfo, std::span<const u8> patch, const ARMBinaryProperties& properties, std::vector<u8>& binary);
+bool injectOverlay(const Patch& patchInfo, std::span<const u8> patch, OverlayEntry& entry, std::vector<u8>& binary, std::ostream& log);
 
 bool loadARMBinaryProperties(const BuildSettings& settings, CodeTarget target, const std::vector<u8>& binary, ARMBinaryProperties& properties);
 bool compileSet(const BuildSettings& settings, CodeTarget target, const std::set<fs::path>& files, const std::string& includeFlags, DependencyTracker& tracker);
-bool needsCompilation(const BuildSettings& settings, const DependencyTracker& tracker, const fs::path& src);
-void deleteUnreferencedObjects(const BuildSettings& settings, const DependencyTracker& tracker);
+bool needsCompilation(DependencyTracker& tracker, const fs::path& source, const fs::path& objectPath, u64 fingerprint);
+bool queryFileState(DependencyTracker& tracker, const std::string& path, FileState& state);
+bool fileChanged(const DependencyTracker& tracker, const std::string& path, const FileState& state);
+void deleteUnreferencedObjects(const BuildSettings& settings, const DependencyTracker& tracker, const FileTree& tree);
 std::string getPathString(const fs::path& p);
 fs::path getObjectPath(const BuildSettings& settings, const fs::path& src);
 fs::path getDependencyPath(const BuildSettings& settings, const fs::path& src);
+fs::path getLinkerInputPath(const BuildSettings& settings, const fs::path& src);
 u64 timeLastModified(const fs::path& p);
+u64 hashData(const u8* data, u64 size, u64 seed = 0);
+bool hashFile(const fs::path& p, u64& hash);
+u64 getCommandFingerprint(const std::vector<std::string>& args);
 bool removeFile(const fs::path& p, const std::string& name);
 bool removeDirectory(const fs::path& p, const std::string& name);
 bool jsonChanged(const DependencyTracker& tracker);
 
-bool getSourceSet(const Value& v, const std::string& key, const fs::path& sourceDir, std::set<fs::path>& paths);
-void scanDefaultTarget(CodeTargetMap& codeTargets, CodeTarget target, const fs::path& sourceDir);
+bool scanFileTree(const fs::path& root, FileTree& tree);
+void addFileTreeEntry(FileTree& tree, const fs::directory_entry& entry);
+const FileTreeEntry* findFileTreeEntry(const FileTree& tree, const fs::path& p);
+void listFileTree(const FileTree& tree, const fs::path& dir, std::vector<const FileTreeEntry*>& entries);
+std::string getFileTreeKey(const fs::path& p);
+bool refreshFileTree(FileTree& tree, const fs::path& p);
+void eraseFileTree(FileTree& tree, const fs::path& p);
+bool isSubpath(const fs::path& p, const fs::path& dir);
+bool getSourceSet(const Value& v, const std::string& key, const fs::path& sourceDir, const FileTree& tree, std::set<fs::path>& paths);
+void scanDefaultTarget(CodeTargetMap& codeTargets, CodeTarget target, const fs::path& sourceDir, const FileTree& tree);
 
 std::string getHexString(u32 hex);
 std::string jsonGetTypename(const Value& v);
@@ -420,53 +956,37 @@ bool jsonReadString(const Value& v, const std::string& key, std::string& s);
 bool jsonReadPath(const Value& v, const std::string& key, fs::path& p, bool forceExist);
 bool jsonReadDir(const Value& v, const std::string& key, fs::path& p, bool forceExist);
 bool jsonReadDirArray(const Value& v, const std::string& key, std::vector<fs::path>& paths, bool forceExist);
+bool jsonReadPathArray(const Value& v, const std::string& key, std::vector<fs::path>& paths, bool forceExist);
 
 
 
 int main(int argc, char** argv) {
 
-	Document d;
-	BuildSettings buildSettings{};
-	PatchSettings patchSettings{};
-	FileIDSymbols fidSyms{};
-	CodeTargetMap codeTargets{};
-	HookSymbols hookSymbols{};
-	std::vector<Fixup> fixups{};
-	OverlayTable ovt;
-	DependencyTracker tracker{};
+	bool watch = false;
 
-	EXIT_ON_ERROR(loadBuildSettings(d))
-	EXIT_ON_ERROR(populateBuild(d, buildSettings))
+	initJobServer(jobServer);
 
-	EXIT_ON_ERROR(createDirectory(buildSettings.backupDir, "backup"))
-	EXIT_ON_ERROR(createDirectory(buildSettings.buildDir, "build"))
-	EXIT_ON_ERROR(createObjectDirectories(buildSettings))
-	EXIT_ON_ERROR(createDependencyDirectories(buildSettings))
-	EXIT_ON_ERROR(backupFiles(buildSettings, ovt))
+	for (int i = 1; i < argc; i++) {
 
-	EXIT_ON_ERROR(populatePatch(d, patchSettings, ovt))
-	EXIT_ON_ERROR(populateFileIDs(buildSettings, d, fidSyms))
-	EXIT_ON_ERROR(populateCodeTargets(buildSettings, d, codeTargets))
-	
-	EXIT_ON_ERROR(executePrebuildCommand(buildSettings))
+		std::string arg = argv[i];
 
-	loadDependencies(buildSettings, tracker);
-	EXIT_ON_ERROR(generateFileIDs(buildSettings, tracker, ovt, fidSyms))
-	EXIT_ON_ERROR(compileSource(buildSettings, codeTargets, tracker))
-	deleteUnreferencedObjects(buildSettings, tracker);
-	saveDependencies(buildSettings, tracker);
+		if (arg == "--watch") {
+			watch = true;
+		} else {
+			std::cout << DWARNING << "Ignoring unknown argument " << arg << std::endl;
+		}
 
-	EXIT_ON_ERROR(collectHooks(buildSettings, codeTargets, hookSymbols))
-	EXIT_ON_ERROR(generateLinkerScripts(buildSettings, patchSettings, codeTargets, hookSymbols))
-	EXIT_ON_ERROR(linkSource(buildSettings))
-	EXIT_ON_ERROR(parseElf(buildSettings, hookSymbols, fixups))
-	EXIT_ON_ERROR(patchBinaries(buildSettings, patchSettings, ovt, fixups))
+	}
 
-	EXIT_ON_ERROR(saveOverlayTable(buildSettings, ovt))
+	if (watch) {
+		EXIT_ON_ERROR(watchBuild())
+		return 0;
+	}
 
-	EXIT_ON_ERROR(executePostbuildCommand(buildSettings))
+	BuildContext context{};
 
-	std::cout << DINFO << "Build successfully finished" << std::endl;
+	EXIT_ON_ERROR(configureBuild(context))
+	EXIT_ON_ERROR(runBuild(context, false))
 	
 	return 0;
 
@@ -476,822 +996,5776 @@ int main(int argc, char** argv) {
 
 
 
-bool loadBuildSettings(Document& root) {
-
-	fs::path buildTargetPath(buildTargetFilename);
+bool configureBuild(BuildContext& context) {
 
-	if (!fs::exists(buildTargetPath) || !fs::is_regular_file(buildTargetPath)) {
-		std::cout << DERROR << "Could not find " << buildTargetFilename << std::endl;
-		return false;
-	}
+	BuildSettings& buildSettings = context.buildSettings;
 
-	std::ifstream buildTargetFile(buildTargetPath);
+	backupFileCache.clear();
 
-	if (!buildTargetFile.is_open()) {
-		std::cout << DERROR << "Failed to open " << buildTargetFilename << std::endl;
-		return false;
-	}
+	RETURN_ON_ERROR(loadBuildSettings(context.document))
+	RETURN_ON_ERROR(populateBuild(context.document, buildSettings))
 
-	std::string buildSettingsFilename;
-	std::getline(buildTargetFile, buildSettingsFilename);
+	RETURN_ON_ERROR(createDirectory(buildSettings.backupDir, "backup"))
+	RETURN_ON_ERROR(createDirectory(buildSettings.buildDir, "build"))
+	RETURN_ON_ERROR(scanFileTree(buildSettings.sourceDir, context.fileTree))
+	RETURN_ON_ERROR(createBuildDirectories(buildSettings, context.fileTree))
+	RETURN_ON_ERROR(backupFiles(buildSettings, context.ovt))
 
-	buildTargetFile.close();
+	RETURN_ON_ERROR(populatePatch(context.document, context.patchSettings, context.ovt))
+	RETURN_ON_ERROR(populateFileIDs(buildSettings, context.document, context.fidSymbols))
+	RETURN_ON_ERROR(populateCodeTargets(buildSettings, context.document, context.fileTree, context.codeTargets))
 
-	jsonPath = fs::absolute(buildSettingsFilename.c_str());
+	loadDependencies(buildSettings, context.tracker);
 
-	if (!fs::exists(jsonPath) || !fs::is_regular_file(jsonPath)) {
-		std::cout << DERROR << "Could not find JSON file " << buildSettingsFilename << std::endl;
-		return false;
+	//A pre-build step may regenerate sources, which invalidates the metadata gathered by the initial scan
+	if (buildSettings.prebuildCmd.empty()) {
+		context.tracker.fileTree = &context.fileTree;
 	}
 
-	std::ifstream buildSettingsFile(jsonPath);
+	loadHookTable(buildSettings, context.tracker.fileTree, context.objectHooks);
 
-	if (!buildSettingsFile.is_open()) {
-		std::cout << DERROR << "Failed to open " << buildSettingsFilename << std::endl;
-		return false;
-	}
+	RETURN_ON_ERROR(initObjectCache(buildSettings, context.objectCache))
 
-	IStreamWrapper isw(buildSettingsFile);
-	root.ParseStream(isw);
+	return true;
 
-	buildSettingsFile.close();
+}
 
-	if (root.HasParseError()) {
-		std::cout << DERROR << "Failed to parse " << buildSettingsFilename << ": Invalid JSON" << std::endl;
-		return false;
-	}
 
-	fs::current_path(jsonPath.parent_path());
 
-	return true;
+bool runBuild(BuildContext& context, bool incremental) {
 
-}
+	const BuildSettings& buildSettings = context.buildSettings;
+	DependencyTracker& tracker = context.tracker;
+	ObjectCache& objectCache = context.objectCache;
+	HookSymbols hookSymbols{};
+	std::vector<Fixup> fixups{};
 
+	//The linked images stay mapped until patching is done so that patch data never has to be read again
+	LinkedImages linkedImages{};
+	LinkStage linkStages[2]{};
 
+	//Patching updates the overlay table, so every build starts from the backed up one
+	OverlayTable ovt = context.ovt;
 
-bool populateBuild(Document& root, BuildSettings& settings) {
+	//Unity sources rewrite the target sets
+	CodeTargetMap codeTargets = context.codeTargets;
+	UnitySourceMap unitySources;
 
-	std::cout << DINFO << "Parsing build configuration" << std::endl;
+	if (incremental) {
+
+		//Drop file states memoized by the previous build and anything a failed build left behind
+		tracker.fileStates.clear();
+		tracker.trackers.clear();
+		tracker.graphTrackers.clear();
+		tracker.fingerprintTrackers.clear();
+		tracker.durationTrackers.clear();
+		tracker.compilationObjects.clear();
 
-	if (!root["build"].IsObject()) {
-		std::cout << DERROR << "Missing JSON object 'build'" << std::endl;
-		return false;
 	}
 
-	const Value& buildNode = root["build"].GetObject();
+	objectCache.hits = 0;
+	objectCache.misses = 0;
+	tracker.objectsChanged = false;
 
-	RETURN_ON_ERROR(jsonReadDirArray(buildNode, "include-directories", settings.includeDirs, true))
-	RETURN_ON_ERROR(jsonReadDir(buildNode, "source", settings.sourceDir, true))
-	RETURN_ON_ERROR(jsonReadDir(buildNode, "filesystem", settings.nitroFSDir, true))
-	RETURN_ON_ERROR(jsonReadDir(buildNode, "toolchain", settings.toolchainDir, true))
-	RETURN_ON_ERROR(jsonReadPath(buildNode, "backup", settings.backupDir, false))
-	RETURN_ON_ERROR(jsonReadPath(buildNode, "build", settings.buildDir, false))
-	RETURN_ON_ERROR(jsonReadPath(buildNode, "output", settings.outputFile, false))
+	RETURN_ON_ERROR(executePrebuildCommand(buildSettings))
 
-	settings.objectDir = settings.buildDir / "object";
-	settings.depsDir = settings.buildDir / "deps";
+	RETURN_ON_ERROR(generateFileIDs(buildSettings, tracker, ovt, context.fidSymbols))
+	RETURN_ON_ERROR(generateUnitySources(buildSettings, codeTargets, unitySources))
 
-	if (buildNode["symbols7"].IsString()) {
-		RETURN_ON_ERROR(jsonReadPath(buildNode, "symbols7", settings.symbol7File, true))
-	}
+	//Invoked as soon as all objects of a processor are compiled so that it links while the other processor still compiles
+	auto startLinkStage = [&](bool arm9) {
 
-	if (buildNode["symbols9"].IsString()) {
-		RETURN_ON_ERROR(jsonReadPath(buildNode, "symbols9", settings.symbol9File, true))
-	}
+		LinkStage& stage = linkStages[arm9];
+		stage.started = true;
 
-	if (buildNode["pre-build"].IsString()) {
-		RETURN_ON_ERROR(jsonReadString(buildNode, "pre-build", settings.prebuildCmd))
-	}
+		for (const auto& e : codeTargets) {
 
-	if (buildNode["post-build"].IsString()) {
-		RETURN_ON_ERROR(jsonReadString(buildNode, "post-build", settings.postbuildCmd))
-	}
+			if (isARM9Target(e.first) == arm9) {
+				stage.codeTargets.insert(e);
+			}
 
-	if (!buildNode["executables"].IsObject()) {
-		std::cout << DERROR << "Missing JSON object 'build/executables'" << std::endl;
-		return false;
-	}
+		}
 
-	RETURN_ON_ERROR(jsonReadString(buildNode["executables"], "gcc", settings.executables.gcc))
-	RETURN_ON_ERROR(jsonReadString(buildNode["executables"], "ld", settings.executables.ld))
+		//The stage takes over the hooks of its objects, so that it collects them while the other processor still adds its own
+		for (const auto& e : stage.codeTargets) {
 
-	settings.executables.gcc = fs::path(settings.toolchainDir / "ff-gcc" / "bin" / settings.executables.gcc).string();
-	settings.executables.ld = fs::path(settings.toolchainDir / "ff-gcc" / "bin" / settings.executables.ld).string();
+			for (const fs::path& source : e.second) {
 
-	if (!fs::exists(settings.executables.gcc) || !fs::is_regular_file(settings.executables.gcc)) {
-		std::cout << DERROR << "Could not find gcc executable as " << settings.executables.gcc << std::endl;
-		return false;
-	}
+				auto node = context.objectHooks.extract(getPathString(getObjectPath(buildSettings, source)));
 
-	if (!fs::exists(settings.executables.ld) || !fs::is_regular_file(settings.executables.ld)) {
-		std::cout << DERROR << "Could not find ld executable as " << settings.executables.ld << std::endl;
-		return false;
-	}
-
-	if (buildNode["flags"]["c++"].IsString()) {
-		settings.flags.cpp = buildNode["flags"]["c++"].GetString();
-	}
+				if (!node.empty()) {
+					stage.objectHooks.insert(std::move(node));
+				}
 
-	if (buildNode["flags"]["c"].IsString()) {
-		settings.flags.c = buildNode["flags"]["c"].GetString();
-	}
+			}
 
-	if (buildNode["flags"]["asm"].IsString()) {
-		settings.flags.assembly = buildNode["flags"]["asm"].GetString();
-	}
+		}
 
-	if (buildNode["flags"]["arm9"].IsString()) {
-		settings.flags.arm9 = buildNode["flags"]["arm9"].GetString();
-	}
+		stage.thread = std::thread([&, arm9]() {
+			LinkStage& stage = linkStages[arm9];
+			stage.successful = collectHooks(buildSettings, stage.codeTargets, stage.objectHooks, stage.hookSymbols, stage.inputHash) && linkProcessor(buildSettings, context.patchSettings, arm9, stage, linkedImages);
+		});
 
-	if (buildNode["flags"]["arm7"].IsString()) {
-		settings.flags.arm7 = buildNode["flags"]["arm7"].GetString();
-	}
+	};
 
-	if (buildNode["pedantic"].IsBool()) {
-		settings.pedantic = buildNode["pedantic"].GetBool();
-	} else {
-		settings.pedantic = true;
-	}
+	auto joinLinkStages = [&]() {
 
-	if (buildNode["allow-eabi-extensions"].IsBool()) {
-		settings.useAEABI = buildNode["allow-eabi-extensions"].GetBool();
-	} else {
-		settings.useAEABI = false;
-	}
+		for (LinkStage& stage : linkStages) {
 
-	if (settings.useAEABI) {
+			if (stage.thread.joinable()) {
+				stage.thread.join();
+			}
 
-		bool result = jsonReadDir(buildNode, "library", settings.libraryDir, true);
+			context.objectHooks.merge(stage.objectHooks);
 
-		if (result) {
-			std::cout << DINFO << "Building with aeabi extensions" << std::endl;
-		} else {
-			std::cout << DWARNING << "Failed to find libgcc.a. Supply a valid path or disable aeabi extensions." << std::endl;
-			settings.useAEABI = false;
 		}
 
-	}
-
-	if (buildNode["threads"].IsInt()) {
+	};
 
-		settings.threadCount = buildNode["threads"].GetInt();
+	//Builds that skip linking or patching end with the same report
+	auto finishBuild = [&]() {
 
-		if (settings.threadCount <= 0) {
-			std::cout << DWARNING << "Invalid thread count of " << settings.threadCount << ", reverting to 1" << std::endl;
-			settings.threadCount = 1;
+		if (objectCache.enabled) {
+			std::cout << DINFO << "Object cache: " << objectCache.hits << " hits, " << objectCache.misses << " misses" << std::endl;
 		}
 
-	} else {
-		settings.threadCount = 1;
-	}
-
-	return true;
+		std::cout << DINFO << "Build successfully finished" << std::endl;
 
-}
+		return true;
 
+	};
 
+	if (!compileSource(buildSettings, codeTargets, unitySources, tracker, objectCache, context.objectHooks, startLinkStage)) {
+		joinLinkStages();
+		closeLinkedImages(linkedImages);
+		return false;
+	}
 
+	deleteUnreferencedObjects(buildSettings, tracker, context.fileTree);
+	saveDependencies(buildSettings, tracker);
+	promoteDependencies(tracker);
 
-bool populatePatch(Document& root, PatchSettings& settings, const OverlayTable& ovt) {
+	if (incremental && context.outputsValid && !tracker.objectsChanged) {
+		std::cout << DINFO << "No objects changed, skipping link and patch" << std::endl;
+		return finishBuild();
+	}
 
-	std::cout << DINFO << "Parsing patch configuration" << std::endl;
+	//Outputs of the previous build stay valid as long as the link inputs turn out to be unchanged
+	bool outputsValid = incremental && context.outputsValid;
+	context.outputsValid = false;
 
-	if (!root["patch"].IsObject()) {
-		std::cout << DERROR << "Missing JSON object 'patch'" << std::endl;
+	if (codeTargets.empty()) {
+		std::cout << DERROR << "No input files, cancelling" << std::endl;
 		return false;
 	}
 
-	const Value& patchNode = root["patch"].GetObject();
-
-	settings.arm9.enabled = false;
-	settings.arm7.enabled = false;
+	//Processors without freshly compiled objects or with retried unity units start linking only now
+	for (u32 a = 0; a < 2; a++) {
 
-	for (auto& v : patchNode.GetObject()) {
+		if (!linkStages[a].started) {
+			startLinkStage(a);
+		}
 
-		const std::string& key = v.name.GetString();
-		const Value& targetNode = v.value;
+	}
 
-		if (key == "arm9") {
+	joinLinkStages();
+	pruneObjectHooks(buildSettings, codeTargets, context.objectHooks);
 
-			RETURN_ON_ERROR(populateBinarySettings(targetNode, settings.arm9))
+	bool linked = linkStages[0].successful && linkStages[1].successful;
+	u64 linkInputs = hashData(reinterpret_cast<const u8*>(&linkStages[0].inputHash), sizeof(u64), linkStages[1].inputHash);
 
-		} else if (key == "arm7") {
+	if (linked && outputsValid && linkInputs == context.linkInputs) {
 
-			RETURN_ON_ERROR(populateBinarySettings(targetNode, settings.arm7))
+		std::cout << DINFO << "Link inputs unchanged, skipping patch" << std::endl;
 
-		} else {
+		closeLinkedImages(linkedImages);
+		context.outputsValid = true;
 
-			std::cout << DERROR << "Unknown patch node '" << key << "'" << std::endl;
-			return false;
+		return finishBuild();
 
-		}
-	
 	}
 
-	return true;
+	//Unchanged ELF files were not relinked but their symbols are still needed for patching
+	for (u32 a = 0; a < 2 && !buildSettings.internalLinker; a++) {
+		linked = linked && parseElf(buildSettings, a, linkStages[a].hookSymbols, linkStages[a].fixups, linkedImages);
+	}
 
-}
+	if (linked) {
 
+		//Every stage only knows the hooks of its own processor
+		hookSymbols.hooks7 = std::move(linkStages[0].hookSymbols.hooks7);
+		hookSymbols.hooks9 = std::move(linkStages[1].hookSymbols.hooks9);
 
+		for (const LinkStage& stage : linkStages) {
+			fixups.insert(fixups.end(), stage.fixups.begin(), stage.fixups.end());
+		}
 
+		appendHookFixups(hookSymbols, fixups);
 
-bool populateBinarySettings(const Value& jsonNode, PatchSettings::BinarySettings& settings) {
+	}
 
-	settings.enabled = true;
+	std::vector<fs::path> changedOutputs;
+	bool patched = linked && patchBinaries(buildSettings, context.patchSettings, ovt, fixups, linkedImages, changedOutputs);
+	closeLinkedImages(linkedImages);
 
-	RETURN_ON_ERROR(jsonReadHex(jsonNode, "reloc", settings.reloc))
-	RETURN_ON_ERROR(jsonReadHex(jsonNode, "start", settings.start))
-	RETURN_ON_ERROR(jsonReadHex(jsonNode, "end", settings.end))
+	RETURN_ON_ERROR(patched)
 
-	if (jsonNode["compress"].IsBool()) {
-		settings.compress = jsonNode["compress"].GetBool();
-	}
+	RETURN_ON_ERROR(saveOverlayTable(buildSettings, ovt, changedOutputs))
 
-	return true;
+	if (changedOutputs.empty()) {
 
-}
+		std::cout << DINFO << "Patched files unchanged" << std::endl;
 
+	} else {
 
+		//Both binaries update the ROM header
+		std::sort(changedOutputs.begin(), changedOutputs.end());
+		changedOutputs.erase(std::unique(changedOutputs.begin(), changedOutputs.end()), changedOutputs.end());
 
-bool populateFileIDs(const BuildSettings& settings, Document& root, FileIDSymbols& fidSymbols) {
+		std::cout << DINFO << "Patched files changed:" << std::endl;
 
-	std::cout << DINFO << "Parsing file ID configuration" << std::endl;
+		for (const fs::path& p : changedOutputs) {
+			std::cout << "\t" << p.lexically_relative(buildSettings.nitroFSDir).string() << std::endl;
+		}
 
-	if (!root["file-id"].IsObject()) {
-		return true;
 	}
 
-	const Value& fidNode = root["file-id"].GetObject();
+	RETURN_ON_ERROR(executePostbuildCommand(buildSettings))
 
-	for (auto& v : fidNode.GetObject()) {
+	context.linkInputs = linkInputs;
+	context.outputsValid = true;
 
-		std::string symbol = v.name.GetString();
+	return finishBuild();
 
-		if (symbol.empty() || std::find_if(symbol.begin(), symbol.end(), [](char c) { return !(isalnum(c) || c == '_'); }) != symbol.end() || isdigit(symbol[0])) {
-			std::cout << DWARNING << "Invalid symbol " << symbol << std::endl;
-			continue;
-		}
+}
 
-		if (!v.value.IsString()) {
-			std::cout << DWARNING << "File path for symbol " << symbol << " is not a string" << std::endl;
-			continue;
-		}
 
-		fs::path p = settings.nitroFSDir / "root" / v.value.GetString();
 
-		if (!fs::exists(p) || !fs::is_regular_file(p)) {
-			std::cout << DWARNING << "File " << p.string() << " for symbol " << symbol << " does not exist" << std::endl;
-			continue;
-		}
+bool watchBuild() {
 
-		if (fidSymbols.contains(symbol)) {
-			std::cout << DWARNING << "Multiple file ID symbol references to '" << symbol << "'" << std::endl;
-			continue;
-		}
+	while (true) {
 
-		fidSymbols[symbol] = fs::absolute(p);
+		BuildContext context{};
+		FileWatcher watcher{};
 
-	}
+		bool configured = configureBuild(context);
 
-	return true;
+		//Without a resolved JSON file there is nothing to watch
+		if (jsonPath.empty()) {
+			return false;
+		}
 
-}
+		RETURN_ON_ERROR(openFileWatcher(watcher))
 
+		const BuildSettings& buildSettings = context.buildSettings;
+		const fs::path& dataDir = buildSettings.nitroFSDir / "root";
+		std::set<fs::path> watchedDirs = { jsonPath.parent_path() };
+		std::set<fs::path> symbolFiles;
+		bool watching = addWatchDirectory(watcher, jsonPath.parent_path(), false);
 
+		if (configured) {
 
-bool createDirectory(const fs::path& p, const std::string& name) {
+			watching = watching && addWatchDirectory(watcher, buildSettings.sourceDir, true);
 
-	if (!fs::exists(p) || !fs::is_directory(p)) {
+			for (const fs::path& include : buildSettings.includeDirs) {
+				watching = watching && addWatchDirectory(watcher, include, true);
+			}
 
-		bool dirCreated = false;
+			//Symbol files and the filesystem data only feed linking and patching
+			for (const fs::path& symbolFile : { buildSettings.symbol9File, buildSettings.symbol7File }) {
 
-		try {
+				if (symbolFile.empty()) {
+					continue;
+				}
 
-			dirCreated = fs::create_directory(p);
+				fs::path symbolPath = fs::absolute(symbolFile).lexically_normal();
+				symbolFiles.insert(symbolPath);
 
-		} catch (fs::filesystem_error& e) {
+				if (watchedDirs.insert(symbolPath.parent_path()).second) {
+					watching = watching && addWatchDirectory(watcher, symbolPath.parent_path(), false);
+				}
 
-			std::cout << DERROR << "Failed to create " << name << " directory " << p.string() << ": " << e.what() << std::endl;
-			return false;
+			}
+
+			if (fs::is_directory(dataDir)) {
+				watching = watching && addWatchDirectory(watcher, dataDir, true);
+			}
 
 		}
 
-		if (!dirCreated) {
-			std::cout << DERROR << "Failed to create " << name << " directory " << p.string() << std::endl;
+		if (!watching) {
+			closeFileWatcher(watcher);
 			return false;
 		}
 
-	}
+		if (configured && !runBuild(context, false)) {
+			std::cout << DWARNING << "Build failed" << std::endl;
+		}
 
-	return true;
+		bool reconfigure = false;
 
-}
+		while (!reconfigure) {
 
+			std::cout << DINFO << "Watching for changes" << std::endl;
 
+			bool rebuild = false;
+			bool retarget = false;
 
+			while (!rebuild && !reconfigure) {
 
-bool compileSource(const BuildSettings& settings, const CodeTargetMap& codeTargets, DependencyTracker& tracker) {
+				std::set<fs::path> changes;
 
-	std::cout << DINFO << "Scanning for compilation units" << std::endl;
+				if (!waitFileChanges(watcher, changes)) {
+					closeFileWatcher(watcher);
+					return false;
+				}
 
-	const fs::path& sourcePath = settings.sourceDir;
-	std::string includeFlags;
+				for (const fs::path& p : changes) {
 
-	for (const fs::path& include : settings.includeDirs) {
-		includeFlags += " -I" + include.string();
-	}
+					if (p == jsonPath) {
 
-	fs::path ffcPath(settings.toolchainDir / "internal" / "ffc.h");
-	fs::path fidPath(settings.toolchainDir / "internal" / "fid.h");
+						reconfigure = true;
 
-	if (fs::exists(fidPath) && fs::is_regular_file(fidPath)) {
-		includeFlags += " -include " + fidPath.string();
-	}
+					} else if (configured && (symbolFiles.contains(fs::absolute(p).lexically_normal()) || isSubpath(p, dataDir))) {
 
-	includeFlags += " -include " + ffcPath.string();
+						//Object changes are what normally invalidates the previous outputs
+						context.outputsValid = false;
+						rebuild = true;
 
-	std::vector<std::string> debugOutput;
-	std::vector<std::string> commands;
-	std::vector<fs::path> newDeps;
+					} else if (configured && isSubpath(p, buildSettings.sourceDir)) {
 
-	const std::string* flags = nullptr;
-	const std::string* arch = nullptr;
+						retarget = refreshFileTree(context.fileTree, p) || retarget;
+						rebuild = true;
 
-	for (const auto& e : codeTargets) {
-		
-		CodeTarget target = e.first;
-		const auto& sourceFiles = e.second;
+					} else if (configured) {
 
-		for (const fs::path& source : sourceFiles) {
+						for (const fs::path& include : buildSettings.includeDirs) {
+							rebuild = rebuild || isSubpath(p, include);
+						}
 
-			const std::string& extension = source.extension().string();
-			fs::path objectPath = getObjectPath(settings, source);
-			fs::path depPath = getDependencyPath(settings, source);
-			std::string defines;
+					}
 
-			if (!isCompilableFile(source)) {
-				continue;
-			}
+				}
 
-			std::string objectPathString = getPathString(objectPath);
+			}
 
-			if (tracker.compilationObjects.contains(objectPathString)) {
-				std::cout << DERROR << "Fatal error: Multiple references to object file " << objectPathString << std::endl;
-				return false;
+			if (reconfigure) {
+				break;
 			}
 
-			tracker.compilationObjects.insert(objectPathString);
+			//Added or removed sources change the code targets and the layout of the build directories
+			if (retarget) {
+
+				context.codeTargets.clear();
+				context.outputsValid = false;
+
+				eraseFileTree(context.fileTree, buildSettings.objectDir);
+				eraseFileTree(context.fileTree, buildSettings.depsDir);
+
+				if (!createBuildDirectories(buildSettings, context.fileTree) || !populateCodeTargets(buildSettings, context.document, context.fileTree, context.codeTargets)) {
+					std::cout << DWARNING << "Build failed" << std::endl;
+					continue;
+				}
 
-			if (!needsCompilation(settings, tracker, source)) {
-				trackDependencies(settings, tracker, depPath, true);
-				continue;
 			}
 
-			if (extension == ".cpp") {
+			if (!runBuild(context, true)) {
+				std::cout << DWARNING << "Build failed" << std::endl;
+			}
 
-				debugOutput.push_back(DINFO + std::string("Compiling C++ source ") + source.string());
-				flags = &settings.flags.cpp;
-				defines += " -D__FFC_LANG_CPP";
+		}
 
-			} else if (extension == ".c") {
+		closeFileWatcher(watcher);
 
-				debugOutput.push_back(DINFO + std::string("Compiling C source ") + source.string());
-				flags = &settings.flags.c;
-				defines += " -D__FFC_LANG_C";
+		std::cout << DINFO << "Build configuration changed, reloading" << std::endl;
 
-			} else {
+	}
 
-				debugOutput.push_back(DINFO + std::string("Compiling S source ") + source.string());
-				flags = &settings.flags.assembly;
-				defines += " -D__FFC_LANG_ASM";
+}
 
-			}
 
-			if (isARM9Target(target)) {
 
-				arch = &settings.flags.arm9;
-				defines += " -D__FFC_ARCH_NUM=9";
+void promoteDependencies(DependencyTracker& tracker) {
 
-			} else {
+	//Turns the state recorded by this build into the baseline of the next one, as if tracker.bin had been reloaded
+	std::unordered_map<std::string, u32> fileIDs;
+
+	tracker.files.clear();
+	tracker.graph.clear();
+
+	for (const auto& e : tracker.trackers) {
+		fileIDs[e.first] = tracker.files.size();
+		tracker.files.push_back(e.first);
+	}
+
+	for (const auto& e : tracker.graphTrackers) {
 
-				arch = &settings.flags.arm7;
-				defines += " -D__FFC_ARCH_NUM=7";
+		std::vector<u32> depIDs;
 
+		for (const std::string& path : e.second) {
+
+			if (!fileIDs.contains(path)) {
+				break;
 			}
 
-			commands.push_back(settings.executables.gcc + " " + *flags + " " + *arch + " -c " + source.string() + " -o " + objectPathString + " -MMD -MF " + depPath.string() + includeFlags + defines);
-			newDeps.push_back(depPath);
+			depIDs.push_back(fileIDs.at(path));
 
 		}
 
+		if (depIDs.size() == e.second.size()) {
+			tracker.graph[e.first] = std::move(depIDs);
+		}
+
 	}
 
-	std::atomic_bool threadsRunning = true;
-	std::atomic_bool successful = true;
-	std::atomic_uint compilationIndex = 0;
-	std::atomic_bool pedantic = settings.pedantic;
+	tracker.dependencies.swap(tracker.trackers);
+	tracker.fingerprints.swap(tracker.fingerprintTrackers);
+	tracker.durations.swap(tracker.durationTrackers);
+	tracker.jsonTrackedModifiedTime = tracker.jsonLastModifiedTime;
 
-	auto compileFunction = [&]() {
+	tracker.trackers.clear();
+	tracker.graphTrackers.clear();
+	tracker.fingerprintTrackers.clear();
+	tracker.durationTrackers.clear();
 
-		while (threadsRunning) {
+}
 
-			u32 i = compilationIndex.fetch_add(1);
 
-			if (i >= commands.size()) {
-				threadsRunning = false;
-				return;
-			}
 
-			std::cout << debugOutput.at(i) << std::endl;
-			
-			if (std::system(commands.at(i).c_str())) {
-					
-				successful = false;
 
-				if (pedantic) {
-					threadsRunning = false;
-					return;
-				}
 
-			}
+bool loadBuildSettings(Document& root) {
+
+	//Reconfiguring in watch mode happens after the working directory moved to the JSON file, so the resolved path is kept
+	if (jsonPath.empty()) {
 
+		fs::path buildTargetPath(buildTargetFilename);
+
+		if (!fs::exists(buildTargetPath) || !fs::is_regular_file(buildTargetPath)) {
+			std::cout << DERROR << "Could not find " << buildTargetFilename << std::endl;
+			return false;
 		}
 
-	};
+		std::ifstream buildTargetFile(buildTargetPath);
 
+		if (!buildTargetFile.is_open()) {
+			std::cout << DERROR << "Failed to open " << buildTargetFilename << std::endl;
+			return false;
+		}
 
-	std::cout << DINFO << "Compiling..." << std::endl;
+		std::string buildSettingsFilename;
+		std::getline(buildTargetFile, buildSettingsFilename);
 
+		buildTargetFile.close();
 
-	std::thread* threads = new std::thread[settings.threadCount];
+		jsonPath = fs::absolute(buildSettingsFilename.c_str()).lexically_normal();
 
-	for (u32 i = 0; i < settings.threadCount; i++) {
-		threads[i] = std::move(std::thread(compileFunction));
 	}
 
-	for (u32 i = 0; i < settings.threadCount; i++) {
-		threads[i].join();
-	}
+	const std::string& buildSettingsFilename = jsonPath.filename().string();
 
-	delete[] threads;
+	if (!fs::exists(jsonPath) || !fs::is_regular_file(jsonPath)) {
+		std::cout << DERROR << "Could not find JSON file " << buildSettingsFilename << std::endl;
+		return false;
+	}
 
-	if (!successful) {
+	std::ifstream buildSettingsFile(jsonPath);
 
-		std::cout << DERROR << "Compilation failed" << std::endl;
+	if (!buildSettingsFile.is_open()) {
+		std::cout << DERROR << "Failed to open " << buildSettingsFilename << std::endl;
 		return false;
-
 	}
 
-	for (const auto& depPath : newDeps) {
-		trackDependencies(settings, tracker, depPath, false);
+	IStreamWrapper isw(buildSettingsFile);
+	root.ParseStream(isw);
+
+	buildSettingsFile.close();
+
+	if (root.HasParseError()) {
+		std::cout << DERROR << "Failed to parse " << buildSettingsFilename << ": Invalid JSON" << std::endl;
+		return false;
 	}
 
-	std::cout << DINFO << "Compilation successful" << std::endl;
+	fs::current_path(jsonPath.parent_path());
 
 	return true;
 
 }
 
 
-/*
-bool compileSet(const BuildSettings& settings, CodeTarget target, const std::set<fs::path>& files, const std::string& includeFlags, DependencyTracker& tracker) {
 
-	const std::string* flags = nullptr;
-	const std::string* arch = nullptr;
+bool populateBuild(Document& root, BuildSettings& settings) {
 
-	for (const fs::path& source : files) {
+	std::cout << DINFO << "Parsing build configuration" << std::endl;
+
+	if (!root["build"].IsObject()) {
+		std::cout << DERROR << "Missing JSON object 'build'" << std::endl;
+		return false;
+	}
+
+	const Value& buildNode = root["build"].GetObject();
+
+	RETURN_ON_ERROR(jsonReadDirArray(buildNode, "include-directories", settings.includeDirs, true))
+	RETURN_ON_ERROR(jsonReadDir(buildNode, "source", settings.sourceDir, true))
+	RETURN_ON_ERROR(jsonReadDir(buildNode, "filesystem", settings.nitroFSDir, true))
+	RETURN_ON_ERROR(jsonReadDir(buildNode, "toolchain", settings.toolchainDir, true))
+	RETURN_ON_ERROR(jsonReadPath(buildNode, "backup", settings.backupDir, false))
+	RETURN_ON_ERROR(jsonReadPath(buildNode, "build", settings.buildDir, false))
+	RETURN_ON_ERROR(jsonReadPath(buildNode, "output", settings.outputFile, false))
+
+	settings.objectDir = settings.buildDir / "object";
+	settings.depsDir = settings.buildDir / "deps";
+	settings.unityDir = settings.buildDir / "unity";
+
+	if (buildNode["symbols7"].IsString()) {
+		RETURN_ON_ERROR(jsonReadPath(buildNode, "symbols7", settings.symbol7File, true))
+	}
+
+	if (buildNode["symbols9"].IsString()) {
+		RETURN_ON_ERROR(jsonReadPath(buildNode, "symbols9", settings.symbol9File, true))
+	}
+
+	if (buildNode["pre-build"].IsString()) {
+		RETURN_ON_ERROR(jsonReadString(buildNode, "pre-build", settings.prebuildCmd))
+	}
+
+	if (buildNode["post-build"].IsString()) {
+		RETURN_ON_ERROR(jsonReadString(buildNode, "post-build", settings.postbuildCmd))
+	}
+
+	if (!buildNode["executables"].IsObject()) {
+		std::cout << DERROR << "Missing JSON object 'build/executables'" << std::endl;
+		return false;
+	}
+
+	RETURN_ON_ERROR(jsonReadString(buildNode["executables"], "gcc", settings.executables.gcc))
+	RETURN_ON_ERROR(jsonReadString(buildNode["executables"], "ld", settings.executables.ld))
+
+	settings.executables.gcc = fs::path(settings.toolchainDir / "ff-gcc" / "bin" / settings.executables.gcc).string();
+	settings.executables.ld = fs::path(settings.toolchainDir / "ff-gcc" / "bin" / settings.executables.ld).string();
+
+	if (!fs::exists(settings.executables.gcc) || !fs::is_regular_file(settings.executables.gcc)) {
+		std::cout << DERROR << "Could not find gcc executable as " << settings.executables.gcc << std::endl;
+		return false;
+	}
+
+	if (!fs::exists(settings.executables.ld) || !fs::is_regular_file(settings.executables.ld)) {
+		std::cout << DERROR << "Could not find ld executable as " << settings.executables.ld << std::endl;
+		return false;
+	}
+
+	if (buildNode["flags"]["c++"].IsString()) {
+		settings.flags.cpp = buildNode["flags"]["c++"].GetString();
+	}
+
+	if (buildNode["flags"]["c"].IsString()) {
+		settings.flags.c = buildNode["flags"]["c"].GetString();
+	}
+
+	if (buildNode["flags"]["asm"].IsString()) {
+		settings.flags.assembly = buildNode["flags"]["asm"].GetString();
+	}
+
+	if (buildNode["flags"]["arm9"].IsString()) {
+		settings.flags.arm9 = buildNode["flags"]["arm9"].GetString();
+	}
+
+	if (buildNode["flags"]["arm7"].IsString()) {
+		settings.flags.arm7 = buildNode["flags"]["arm7"].GetString();
+	}
+
+	if (buildNode["pedantic"].IsBool()) {
+		settings.pedantic = buildNode["pedantic"].GetBool();
+	} else {
+		settings.pedantic = true;
+	}
+
+	if (buildNode["allow-eabi-extensions"].IsBool()) {
+		settings.useAEABI = buildNode["allow-eabi-extensions"].GetBool();
+	} else {
+		settings.useAEABI = false;
+	}
+
+	if (buildNode["cache"].IsObject()) {
+
+		const Value& cacheNode = buildNode["cache"];
+
+		//An empty directory leaves the cache disabled
+		if (!cacheNode["directory"].IsString() || *cacheNode["directory"].GetString()) {
+			RETURN_ON_ERROR(jsonReadPath(cacheNode, "directory", settings.cacheDir, false))
+		}
+
+		if (cacheNode["max-size"].IsUint()) {
+			settings.cacheMaxSize = static_cast<u64>(cacheNode["max-size"].GetUint()) << 20;
+		} else {
+			settings.cacheMaxSize = 1024ull << 20;
+		}
+
+	}
+
+	if (buildNode["prelude"].IsArray()) {
+		RETURN_ON_ERROR(jsonReadPathArray(buildNode, "prelude", settings.preludeHeaders, true))
+	}
+
+	if (buildNode["precompile-prelude"].IsBool()) {
+		settings.precompilePrelude = buildNode["precompile-prelude"].GetBool();
+	} else {
+		settings.precompilePrelude = false;
+	}
+
+	if (buildNode["unity-size"].IsUint()) {
+		settings.unitySize = buildNode["unity-size"].GetUint();
+	} else {
+		settings.unitySize = 0;
+	}
+
+	if (buildNode["internal-linker"].IsBool()) {
+		settings.internalLinker = buildNode["internal-linker"].GetBool();
+	} else {
+		settings.internalLinker = false;
+	}
+
+	if (buildNode["analyze-safe-hooks"].IsBool()) {
+		settings.analyzeSafeHooks = buildNode["analyze-safe-hooks"].GetBool();
+	} else {
+		settings.analyzeSafeHooks = false;
+	}
+
+	if (buildNode["content-hash"].IsBool()) {
+		settings.contentHash = buildNode["content-hash"].GetBool();
+	} else {
+		settings.contentHash = false;
+	}
+
+	if (settings.useAEABI) {
+
+		bool result = jsonReadDir(buildNode, "library", settings.libraryDir, true);
+
+		if (result) {
+			std::cout << DINFO << "Building with aeabi extensions" << std::endl;
+		} else {
+			std::cout << DWARNING << "Failed to find libgcc.a. Supply a valid path or disable aeabi extensions." << std::endl;
+			settings.useAEABI = false;
+		}
+
+	}
+
+	if (settings.useAEABI && settings.internalLinker) {
+		std::cout << DWARNING << "The internal linker cannot link against libgcc.a, falling back to ld" << std::endl;
+		settings.internalLinker = false;
+	}
+
+	if (buildNode["threads"].IsInt()) {
+
+		settings.threadCount = buildNode["threads"].GetInt();
+
+		if (settings.threadCount <= 0) {
+			std::cout << DWARNING << "Invalid thread count of " << settings.threadCount << ", reverting to 1" << std::endl;
+			settings.threadCount = 1;
+		}
+
+	} else {
+		settings.threadCount = 1;
+	}
+
+	return true;
+
+}
+
+
+
+
+bool populatePatch(Document& root, PatchSettings& settings, const OverlayTable& ovt) {
+
+	std::cout << DINFO << "Parsing patch configuration" << std::endl;
+
+	if (!root["patch"].IsObject()) {
+		std::cout << DERROR << "Missing JSON object 'patch'" << std::endl;
+		return false;
+	}
+
+	const Value& patchNode = root["patch"].GetObject();
+
+	settings.arm9.enabled = false;
+	settings.arm7.enabled = false;
+	settings.overlays.clear();
+
+	//Code injected into an overlay is appended behind its BSS and may by default grow up to the next overlay load address
+	for (const auto& e : ovt) {
+
+		const OverlayEntry& entry = e.second;
+		u32 start = (entry.start + entry.size + entry.bss + 3) & ~3;
+		u32 end = 0;
+
+		for (const auto& f : ovt) {
+
+			if (isARM9Target(f.first) == isARM9Target(e.first) && f.second.start >= start && (!end || f.second.start < end)) {
+				end = f.second.start;
+			}
+
+		}
+
+		settings.overlays[e.first] = PatchSettings::OverlaySettings{ start, end, entry.initEnd - entry.initStart };
+
+	}
+
+	for (auto& v : patchNode.GetObject()) {
+
+		const std::string& key = v.name.GetString();
+		const Value& targetNode = v.value;
+
+		if (key == "arm9") {
+
+			RETURN_ON_ERROR(populateBinarySettings(targetNode, settings.arm9))
+
+		} else if (key == "arm7") {
+
+			RETURN_ON_ERROR(populateBinarySettings(targetNode, settings.arm7))
+
+		} else if (settings.overlays.contains(getCodeTarget(key))) {
+
+			CodeTarget target = getCodeTarget(key);
+			RETURN_ON_ERROR(populateOverlaySettings(targetNode, target, ovt, settings.overlays[target]))
+
+		} else {
+
+			std::cout << DERROR << "Unknown patch node '" << key << "'" << std::endl;
+			return false;
+
+		}
+	
+	}
+
+	return true;
+
+}
+
+
+
+
+bool populateBinarySettings(const Value& jsonNode, PatchSettings::BinarySettings& settings) {
+
+	settings.enabled = true;
+
+	RETURN_ON_ERROR(jsonReadHex(jsonNode, "reloc", settings.reloc))
+	RETURN_ON_ERROR(jsonReadHex(jsonNode, "start", settings.start))
+	RETURN_ON_ERROR(jsonReadHex(jsonNode, "end", settings.end))
+
+	if (jsonNode["compress"].IsBool()) {
+		settings.compress = jsonNode["compress"].GetBool();
+	}
+
+	return true;
+
+}
+
+
+
+bool populateOverlaySettings(const Value& jsonNode, CodeTarget target, const OverlayTable& ovt, PatchSettings::OverlaySettings& settings) {
+
+	u32 budget = 0;
+
+	RETURN_ON_ERROR(jsonReadHex(jsonNode, "budget", budget))
+
+	u64 end = static_cast<u64>(settings.start) + budget;
+
+	if (settings.end && end > settings.end) {
+
+		auto next = std::find_if(ovt.begin(), ovt.end(), [&](const auto& e) {
+			return isARM9Target(e.first) == isARM9Target(target) && e.second.start == settings.end;
+		});
+
+		std::cout << DERROR << "Budget of " << getCodeTargetName(target) << " exceeds the load address 0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << settings.end << " of " << getCodeTargetName(next->first) << " by 0x" << (end - settings.end) << " bytes" << std::endl;
+		return false;
+
+	}
+
+	settings.end = static_cast<u32>(end);
+
+	return true;
+
+}
+
+
+
+bool populateFileIDs(const BuildSettings& settings, Document& root, FileIDSymbols& fidSymbols) {
+
+	std::cout << DINFO << "Parsing file ID configuration" << std::endl;
+
+	if (!root["file-id"].IsObject()) {
+		return true;
+	}
+
+	const Value& fidNode = root["file-id"].GetObject();
+
+	for (auto& v : fidNode.GetObject()) {
+
+		std::string symbol = v.name.GetString();
+
+		if (symbol.empty() || std::find_if(symbol.begin(), symbol.end(), [](char c) { return !(isalnum(c) || c == '_'); }) != symbol.end() || isdigit(symbol[0])) {
+			std::cout << DWARNING << "Invalid symbol " << symbol << std::endl;
+			continue;
+		}
+
+		if (!v.value.IsString()) {
+			std::cout << DWARNING << "File path for symbol " << symbol << " is not a string" << std::endl;
+			continue;
+		}
+
+		fs::path p = settings.nitroFSDir / "root" / v.value.GetString();
+
+		if (!fs::exists(p) || !fs::is_regular_file(p)) {
+			std::cout << DWARNING << "File " << p.string() << " for symbol " << symbol << " does not exist" << std::endl;
+			continue;
+		}
+
+		if (fidSymbols.contains(symbol)) {
+			std::cout << DWARNING << "Multiple file ID symbol references to '" << symbol << "'" << std::endl;
+			continue;
+		}
+
+		fidSymbols[symbol] = fs::absolute(p);
+
+	}
+
+	return true;
+
+}
+
+
+
+bool createDirectory(const fs::path& p, const std::string& name) {
+
+	if (!fs::exists(p) || !fs::is_directory(p)) {
+
+		bool dirCreated = false;
+
+		try {
+
+			dirCreated = fs::create_directory(p);
+
+		} catch (fs::filesystem_error& e) {
+
+			std::cout << DERROR << "Failed to create " << name << " directory " << p.string() << ": " << e.what() << std::endl;
+			return false;
+
+		}
+
+		if (!dirCreated) {
+			std::cout << DERROR << "Failed to create " << name << " directory " << p.string() << std::endl;
+			return false;
+		}
+
+	}
+
+	return true;
+
+}
+
+
+
+
+bool generateUnitySources(const BuildSettings& settings, CodeTargetMap& codeTargets, UnitySourceMap& unitySources) {
+
+	if (settings.unitySize < 2) {
+
+		if (fs::exists(settings.unityDir)) {
+			removeDirectory(settings.unityDir, "unity");
+		}
+
+		return true;
+
+	}
+
+	std::set<fs::path> unityStems;
+
+	for (auto& e : codeTargets) {
+
+		CodeTarget target = e.first;
+		std::set<fs::path>& sourceFiles = e.second;
+
+		//Units are formed per directory so that adding a file only regroups its own directory
+		std::map<std::pair<fs::path, std::string>, std::vector<fs::path>> groups;
+
+		for (const fs::path& source : sourceFiles) {
+
+			const std::string& extension = source.extension().string();
+
+			if (extension == ".cpp" || extension == ".c") {
+				groups[{ source.parent_path(), extension }].push_back(source);
+			}
+
+		}
+
+		for (const auto& g : groups) {
+
+			const fs::path& dir = g.first.first;
+			const std::string& extension = g.first.second;
+			const std::vector<fs::path>& sources = g.second;
+			const fs::path& unityDir = (settings.unityDir / getCodeTargetName(target) / dir.lexically_relative(settings.sourceDir)).lexically_normal();
+
+			for (u32 i = 0; i < sources.size(); i += settings.unitySize) {
+
+				u32 count = std::min(settings.unitySize, static_cast<u32>(sources.size() - i));
+
+				if (count < 2) {
+					continue;
+				}
+
+				fs::path unityPath = unityDir / ("unity_" + extension.substr(1) + std::to_string(i / settings.unitySize) + extension);
+				fs::path splitPath = fs::path(unityPath).replace_extension(".split");
+				std::string content = "/* Auto-generated unity source */\n";
+
+				for (u32 j = i; j < i + count; j++) {
+					content += "#include \"" + sources[j].generic_string() + "\"\n";
+				}
+
+				unityStems.insert(fs::path(unityPath).replace_extension(""));
+
+				//Units that failed as a whole stay split until their members change
+				if (fs::exists(splitPath) && fs::is_regular_file(splitPath)) {
+
+					std::ifstream splitFile(splitPath, std::ios::in);
+					std::stringstream splitStream;
+					splitStream << splitFile.rdbuf();
+					splitFile.close();
+
+					if (splitStream.str() == content) {
+						continue;
+					}
+
+					removeFile(splitPath, "unity split");
+
+				}
+
+				std::error_code ec;
+				fs::create_directories(unityDir, ec);
+
+				if (ec) {
+					std::cout << DERROR << "Failed to create unity directory " << unityDir.string() << ": " << ec.message() << std::endl;
+					return false;
+				}
+
+				RETURN_ON_ERROR(writeFileIfChanged(unityPath, content, "unity"))
+
+				UnitySource& unitySource = unitySources[getPathString(unityPath)];
+				unitySource.target = target;
+				unitySource.sources.assign(sources.begin() + i, sources.begin() + i + count);
+				unitySource.splitPath = splitPath;
+
+				for (const fs::path& source : unitySource.sources) {
+					sourceFiles.erase(source);
+				}
+
+				sourceFiles.insert(unityPath);
+
+			}
+
+		}
+
+	}
+
+	//Drops units, objects and split markers of groups that no longer exist
+	std::vector<fs::path> stalePaths;
+	std::error_code ec;
+
+	for (const fs::directory_entry& entry : fs::recursive_directory_iterator(settings.unityDir, ec)) {
+
+		if (entry.is_regular_file(ec) && !unityStems.contains(fs::path(entry.path()).replace_extension(""))) {
+			stalePaths.push_back(entry.path());
+		}
+
+	}
+
+	for (const fs::path& p : stalePaths) {
+		removeFile(p, "stale unity");
+	}
+
+	V_PRINT("Generated " << unitySources.size() << " unity units")
+
+	return true;
+
+}
+
+
+
+bool compileSource(const BuildSettings& settings, CodeTargetMap& codeTargets, const UnitySourceMap& unitySources, DependencyTracker& tracker, ObjectCache& cache, ObjectHookMap& objectHooks, const std::function<void(bool)>& processorCompiled) {
+
+	std::cout << DINFO << "Scanning for compilation units" << std::endl;
+
+	const fs::path& sourcePath = settings.sourceDir;
+	std::vector<std::string> includeFlags;
+
+	for (const fs::path& include : settings.includeDirs) {
+		includeFlags.push_back("-I" + include.string());
+	}
+
+	std::vector<fs::path> asmPrelude;
+	std::vector<fs::path> prelude;
+	std::vector<std::string> asmPreludeFlags;
+	std::vector<std::string> preludeFlags;
+
+	getPreludeHeaders(settings, true, asmPrelude);
+	getPreludeHeaders(settings, false, prelude);
+
+	for (const fs::path& header : asmPrelude) {
+		asmPreludeFlags.insert(asmPreludeFlags.end(), { "-include", header.string() });
+	}
+
+	for (const fs::path& header : prelude) {
+		preludeFlags.insert(preludeFlags.end(), { "-include", header.string() });
+	}
+
+	PrecompiledHeaderMap precompiledHeaders;
+	const fs::path& pchDir = settings.buildDir / "pch";
+
+	if (settings.precompilePrelude) {
+		RETURN_ON_ERROR(precompileHeaders(settings, codeTargets, includeFlags, tracker, precompiledHeaders))
+	} else if (fs::exists(pchDir)) {
+		removeDirectory(pchDir, "precompiled header");
+	}
+
+	const std::vector<std::string>& cppFlags = splitArguments(settings.flags.cpp);
+	const std::vector<std::string>& cFlags = splitArguments(settings.flags.c);
+	const std::vector<std::string>& asmFlags = splitArguments(settings.flags.assembly);
+	const std::vector<std::string>& arm9Flags = splitArguments(settings.flags.arm9);
+	const std::vector<std::string>& arm7Flags = splitArguments(settings.flags.arm7);
+
+	std::vector<ProcessJob> jobs;
+	std::vector<ProcessJob> preprocessJobs;
+	std::vector<fs::path> newSources;
+	std::vector<fs::path> newObjects;
+	std::vector<fs::path> preprocessedFiles;
+	std::vector<std::vector<std::string>> preprocessedArgs;
+	std::vector<std::string> jobSources;
+	std::vector<std::string> hookObjects;
+	std::vector<ObjectHooks> parsedHooks;
+	std::vector<u8> hooksParsed;
+	std::vector<u8> hookProcessors;
+	std::atomic_uint pendingJobs[2] = { 0, 0 };
+	std::mutex processorMutex;
+
+	//Runs on the worker that finished the last job of a processor, handing the processor over to linking
+	auto finishProcessor = [&](bool arm9) {
+
+		if (!processorCompiled) {
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(processorMutex);
+
+		for (u32 i = 0; i < hookObjects.size(); i++) {
+
+			if (hookProcessors[i] == arm9 && hooksParsed[i]) {
+				objectHooks[hookObjects[i]] = std::move(parsedHooks[i]);
+				hooksParsed[i] = false;
+			}
+
+		}
+
+		processorCompiled(arm9);
+
+	};
+
+	const std::vector<std::string>* flags = nullptr;
+	const std::vector<std::string>* arch = nullptr;
+	const PrecompiledHeader* precompiledHeader = nullptr;
+
+	for (const auto& e : codeTargets) {
+		
+		CodeTarget target = e.first;
+		const auto& sourceFiles = e.second;
+
+		for (const fs::path& source : sourceFiles) {
+
+			const std::string& extension = source.extension().string();
+			fs::path objectPath = getObjectPath(settings, source);
+			fs::path depPath = getDependencyPath(settings, source);
+			std::vector<std::string> defines;
+
+			if (!isCompilableFile(source)) {
+				continue;
+			}
+
+			std::string objectPathString = getPathString(objectPath);
+
+			if (tracker.compilationObjects.contains(objectPathString)) {
+				std::cout << DERROR << "Fatal error: Multiple references to object file " << objectPathString << std::endl;
+				return false;
+			}
+
+			tracker.compilationObjects.insert(objectPathString);
+
+			ProcessJob job{};
+
+			if (extension == ".cpp") {
+
+				job.info = DINFO + std::string("Compiling C++ source ") + source.string();
+				flags = &cppFlags;
+				defines.push_back("-D__FFC_LANG_CPP");
+
+			} else if (extension == ".c") {
+
+				job.info = DINFO + std::string("Compiling C source ") + source.string();
+				flags = &cFlags;
+				defines.push_back("-D__FFC_LANG_C");
+
+			} else {
+
+				job.info = DINFO + std::string("Compiling S source ") + source.string();
+				flags = &asmFlags;
+				defines.push_back("-D__FFC_LANG_ASM");
+
+			}
+
+			if (isARM9Target(target)) {
+
+				arch = &arm9Flags;
+				defines.push_back("-D__FFC_ARCH_NUM=9");
+
+			} else {
+
+				arch = &arm7Flags;
+				defines.push_back("-D__FFC_ARCH_NUM=7");
+
+			}
+
+			job.args.push_back(settings.executables.gcc);
+			job.args.insert(job.args.end(), flags->begin(), flags->end());
+			job.args.insert(job.args.end(), arch->begin(), arch->end());
+			job.args.insert(job.args.end(), { "-c", source.string(), "-o", objectPathString, "-MMD", "-MF", depPath.string() });
+			job.args.insert(job.args.end(), includeFlags.begin(), includeFlags.end());
+			job.args.insert(job.args.end(), defines.begin(), defines.end());
+
+			if (cache.enabled) {
+				job.args.insert(job.args.end(), cache.flags.begin(), cache.flags.end());
+			}
+
+			std::vector<std::string> unitPreludeFlags;
+			precompiledHeader = nullptr;
+
+			if (extension == ".cpp" || extension == ".c") {
+
+				const std::string& variant = getPreludeVariant(target, extension);
+
+				if (precompiledHeaders.contains(variant)) {
+					precompiledHeader = &precompiledHeaders.at(variant);
+					unitPreludeFlags = { "-Winvalid-pch", "-include", precompiledHeader->headerPath.string() };
+				} else {
+					unitPreludeFlags = preludeFlags;
+				}
+
+			} else {
+				unitPreludeFlags = asmPreludeFlags;
+			}
+
+			job.args.insert(job.args.end(), unitPreludeFlags.begin(), unitPreludeFlags.end());
+
+			std::string srcString = getPathString(source);
+			u64 fingerprint = getCommandFingerprint(job.args);
+
+			if (unitySources.contains(srcString)) {
+				job.info += " (" + std::to_string(unitySources.at(srcString).sources.size()) + " sources)";
+			}
+
+			//Units are rebuilt whenever their precompiled header was
+			if (precompiledHeader) {
+				fingerprint = hashData(reinterpret_cast<const u8*>(&precompiledHeader->stamp), sizeof(u64), fingerprint);
+			}
+
+			tracker.fingerprintTrackers[srcString] = fingerprint;
+
+			if (tracker.durations.contains(srcString)) {
+				tracker.durationTrackers[srcString] = tracker.durations.at(srcString);
+			}
+
+			if (!needsCompilation(tracker, source, objectPath, fingerprint)) {
+				trackDependencies(tracker, source, depPath, true);
+				continue;
+			}
+
+			//Units whose own source was edited go first so their errors show up early, the rest longest first
+			FileState state{};
+
+			if (!tracker.dependencies.contains(srcString) || !queryFileState(tracker, srcString, state) || fileChanged(tracker, srcString, state)) {
+				job.priority = -1;
+			} else if (tracker.durations.contains(srcString)) {
+				job.priority = tracker.durations.at(srcString);
+			}
+
+			if (cache.enabled) {
+
+				//The preprocessor run also emits the dependency file so cache hits need no compiler invocation
+				fs::path preprocessedPath = fs::path(objectPath).replace_extension(".i");
+				ProcessJob preprocessJob{};
+
+				preprocessJob.args.push_back(settings.executables.gcc);
+				preprocessJob.args.insert(preprocessJob.args.end(), flags->begin(), flags->end());
+				preprocessJob.args.insert(preprocessJob.args.end(), arch->begin(), arch->end());
+
+				//gcc -E leaves lowercase .s files alone unless the assembler flags ask for the preprocessor
+				if (flags == &asmFlags) {
+					preprocessJob.args.insert(preprocessJob.args.end(), { "-x", "assembler-with-cpp" });
+				}
+
+				preprocessJob.args.insert(preprocessJob.args.end(), { "-E", source.string(), "-o", preprocessedPath.string(), "-MMD", "-MF", depPath.string(), "-MT", objectPathString });
+				preprocessJob.args.insert(preprocessJob.args.end(), includeFlags.begin(), includeFlags.end());
+				preprocessJob.args.insert(preprocessJob.args.end(), defines.begin(), defines.end());
+				preprocessJob.args.insert(preprocessJob.args.end(), cache.flags.begin(), cache.flags.end());
+				preprocessJob.args.insert(preprocessJob.args.end(), unitPreludeFlags.begin(), unitPreludeFlags.end());
+				preprocessJob.priority = job.priority;
+
+				//A miss compiles the preprocessed output, except for units that would lose their precompiled header that way
+				std::vector<std::string> compileArgs;
+
+				if (!precompiledHeader) {
+
+					const std::string& language = extension == ".cpp" ? "c++-cpp-output" : (extension == ".c" ? "cpp-output" : "assembler");
+
+					compileArgs.push_back(settings.executables.gcc);
+					compileArgs.insert(compileArgs.end(), flags->begin(), flags->end());
+					compileArgs.insert(compileArgs.end(), arch->begin(), arch->end());
+					compileArgs.insert(compileArgs.end(), cache.flags.begin(), cache.flags.end());
+					compileArgs.insert(compileArgs.end(), { "-x", language, "-c", preprocessedPath.string(), "-o", objectPathString });
+
+				}
+
+				preprocessJobs.push_back(std::move(preprocessJob));
+				preprocessedFiles.push_back(preprocessedPath);
+				preprocessedArgs.push_back(std::move(compileArgs));
+
+			}
+
+			//Hooks are extracted as soon as the object is written instead of in a separate pass
+			job.finished = [&settings, &parsedHooks, &hooksParsed, &pendingJobs, &finishProcessor, i = hookObjects.size(), objectPath, arm9 = isARM9Target(target)]() {
+
+				hooksParsed[i] = parseObjectHooks(settings, objectPath, parsedHooks[i]);
+
+				if (pendingJobs[arm9].fetch_sub(1) == 1) {
+					finishProcessor(arm9);
+				}
+
+			};
+
+			objectHooks.erase(objectPathString);
+			hookObjects.push_back(objectPathString);
+			hookProcessors.push_back(isARM9Target(target));
+			pendingJobs[isARM9Target(target)]++;
+
+			jobs.push_back(std::move(job));
+			newSources.push_back(source);
+			newObjects.push_back(objectPath);
+			jobSources.push_back(srcString);
+
+		}
+
+	}
+
+	std::vector<u64> cacheKeys;
+	std::vector<fs::path> missedPreprocessed;
+	parsedHooks.resize(hookObjects.size());
+	hooksParsed.resize(hookObjects.size());
+
+	if (cache.enabled && !jobs.empty()) {
+
+		std::cout << DINFO << "Preprocessing..." << std::endl;
+
+		if (!executeJobs(preprocessJobs, settings.threadCount, settings.pedantic)) {
+
+			std::cout << DERROR << "Compilation failed" << std::endl;
+			return false;
+
+		}
+
+		std::vector<ProcessJob> missedJobs;
+		std::vector<fs::path> missedObjects;
+		std::vector<std::string> missedSources;
+
+		for (u32 i = 0; i < jobs.size(); i++) {
+
+			u64 key = 0;
+
+			if (!getCacheKey(cache, preprocessedFiles[i], jobs[i].args, key)) {
+				key = 0;
+			}
+
+			if (key && fetchCachedObject(cache, key, newObjects[i])) {
+
+				removeFile(preprocessedFiles[i], "preprocessed");
+
+				std::cout << jobs[i].info << " (cached)" << std::endl;
+				cache.hits++;
+				pendingJobs[hookProcessors[i]]--;
+				continue;
+
+			}
+
+			//The compiler picks up where the preprocessor left off instead of starting over
+			if (key && !preprocessedArgs[i].empty()) {
+				jobs[i].args = std::move(preprocessedArgs[i]);
+				missedPreprocessed.push_back(preprocessedFiles[i]);
+			} else {
+				removeFile(preprocessedFiles[i], "preprocessed");
+			}
+
+			cache.misses++;
+			cacheKeys.push_back(key);
+			missedJobs.push_back(std::move(jobs[i]));
+			missedObjects.push_back(newObjects[i]);
+			missedSources.push_back(jobSources[i]);
+
+		}
+
+		jobs.swap(missedJobs);
+		newObjects.swap(missedObjects);
+		jobSources.swap(missedSources);
+
+	}
+
+	std::cout << DINFO << "Compiling..." << std::endl;
+
+	std::set<std::string> failedUnits;
+
+	//Failed unity units are retried source by source, so they must not cancel the remaining jobs
+	bool compiled = executeJobs(jobs, settings.threadCount, settings.pedantic && unitySources.empty());
+
+	for (const fs::path& preprocessedPath : missedPreprocessed) {
+		removeFile(preprocessedPath, "preprocessed");
+	}
+
+	if (!compiled) {
+
+		for (u32 i = 0; i < jobs.size(); i++) {
+
+			if (jobs[i].status && unitySources.contains(jobSources[i])) {
+				failedUnits.insert(jobSources[i]);
+			} else if (jobs[i].status) {
+				failedUnits.clear();
+				break;
+			}
+
+		}
+
+		if (failedUnits.empty()) {
+			std::cout << DERROR << "Compilation failed" << std::endl;
+			return false;
+		}
+
+		RETURN_ON_ERROR(splitUnitySources(settings, codeTargets, unitySources, failedUnits, tracker, cache, objectHooks))
+
+	}
+
+	for (u32 i = 0; i < jobs.size(); i++) {
+
+		if (!jobs[i].status) {
+			tracker.durationTrackers[jobSources[i]] = jobs[i].duration;
+		}
+
+	}
+
+	if (cache.enabled) {
+
+		for (u32 i = 0; i < cacheKeys.size(); i++) {
+
+			if (cacheKeys[i] && !jobs[i].status) {
+				storeCachedObject(cache, cacheKeys[i], newObjects[i]);
+			}
+
+		}
+
+		if (!cacheKeys.empty()) {
+			trimObjectCache(cache);
+		}
+
+	}
+
+	for (const auto& source : newSources) {
+
+		if (!failedUnits.contains(getPathString(source))) {
+			trackDependencies(tracker, source, getDependencyPath(settings, source), false);
+		}
+
+	}
+
+	for (u32 i = 0; i < hookObjects.size(); i++) {
+
+		if (hooksParsed[i]) {
+			objectHooks[hookObjects[i]] = std::move(parsedHooks[i]);
+		}
+
+	}
+
+	tracker.objectsChanged = tracker.objectsChanged || !newSources.empty();
+
+	std::cout << DINFO << "Compilation successful" << std::endl;
+
+	return true;
+
+}
+
+
+
+bool splitUnitySources(const BuildSettings& settings, CodeTargetMap& codeTargets, const UnitySourceMap& unitySources, const std::set<std::string>& units, DependencyTracker& tracker, ObjectCache& cache, ObjectHookMap& objectHooks) {
+
+	CodeTargetMap splitTargets;
+
+	for (const std::string& unit : units) {
+
+		const UnitySource& unitySource = unitySources.at(unit);
+		splitTargets[unitySource.target].insert(unitySource.sources.begin(), unitySource.sources.end());
+
+		std::cout << DWARNING << "Unity unit " << unit << " failed to compile, compiling its sources separately" << std::endl;
+
+	}
+
+	RETURN_ON_ERROR(compileSource(settings, splitTargets, UnitySourceMap(), tracker, cache, objectHooks, nullptr))
+
+	for (const std::string& unit : units) {
+
+		const UnitySource& unitySource = unitySources.at(unit);
+		std::set<fs::path>& sourceFiles = codeTargets[unitySource.target];
+
+		//The sources only fail when merged, which almost always means they define the same internal symbol
+		std::cout << DWARNING << "Sources of unity unit " << unit << " collide when merged, most likely through static symbols or macros of the same name:" << std::endl;
+
+		for (const fs::path& source : unitySource.sources) {
+			std::cout << "\t" << source.string() << std::endl;
+		}
+
+		std::error_code ec;
+		fs::copy_file(unit, unitySource.splitPath, fs::copy_options::overwrite_existing, ec);
+
+		sourceFiles.erase(unit);
+		sourceFiles.insert(unitySource.sources.begin(), unitySource.sources.end());
+
+		tracker.compilationObjects.erase(getPathString(getObjectPath(settings, unit)));
+		tracker.fingerprintTrackers.erase(unit);
+		tracker.durationTrackers.erase(unit);
+
+	}
+
+	return true;
+
+}
+
+
+
+bool precompileHeaders(const BuildSettings& settings, const CodeTargetMap& codeTargets, const std::vector<std::string>& includeFlags, DependencyTracker& tracker, PrecompiledHeaderMap& headers) {
+
+	const std::vector<std::string>& cppFlags = splitArguments(settings.flags.cpp);
+	const std::vector<std::string>& cFlags = splitArguments(settings.flags.c);
+	const std::vector<std::string>& arm9Flags = splitArguments(settings.flags.arm9);
+	const std::vector<std::string>& arm7Flags = splitArguments(settings.flags.arm7);
+
+	std::set<std::string> variants;
+
+	for (const auto& e : codeTargets) {
+
+		for (const fs::path& source : e.second) {
+
+			const std::string& extension = source.extension().string();
+
+			if (extension == ".cpp" || extension == ".c") {
+				variants.insert(getPreludeVariant(e.first, extension));
+			}
+
+		}
+
+	}
+
+	std::vector<fs::path> preludeHeaders;
+	getPreludeHeaders(settings, false, preludeHeaders);
+
+	std::string preludeContent = "/* Auto-generated prelude */\n";
+
+	for (const fs::path& header : preludeHeaders) {
+		preludeContent += "#include \"" + header.generic_string() + "\"\n";
+	}
+
+	std::vector<ProcessJob> jobs;
+	std::vector<std::string> jobVariants;
+
+	for (const std::string& variant : variants) {
+
+		bool cpp = variant.ends_with("_cpp");
+		bool arm9 = variant.starts_with("arm9");
+
+		const fs::path& pchDir = settings.buildDir / "pch" / variant;
+		fs::path headerPath = pchDir / "prelude.h";
+		fs::path pchPath = pchDir / "prelude.h.gch";
+		fs::path depPath = pchDir / "prelude.d";
+		std::error_code ec;
+
+		fs::create_directories(pchDir, ec);
+
+		if (ec) {
+			std::cout << DERROR << "Failed to create precompiled header directory " << pchDir.string() << ": " << ec.message() << std::endl;
+			return false;
+		}
+
+		RETURN_ON_ERROR(writeFileIfChanged(headerPath, preludeContent, "prelude"))
+
+		const std::vector<std::string>& flags = cpp ? cppFlags : cFlags;
+		const std::vector<std::string>& arch = arm9 ? arm9Flags : arm7Flags;
+
+		//Must match the unit command lines exactly, otherwise gcc silently ignores the precompiled header
+		ProcessJob job{};
+		job.info = DINFO + std::string("Precompiling prelude ") + variant;
+		job.args.push_back(settings.executables.gcc);
+		job.args.insert(job.args.end(), flags.begin(), flags.end());
+		job.args.insert(job.args.end(), arch.begin(), arch.end());
+		job.args.insert(job.args.end(), { "-x", cpp ? "c++-header" : "c-header", headerPath.string(), "-o", pchPath.string(), "-MMD", "-MF", depPath.string() });
+		job.args.insert(job.args.end(), includeFlags.begin(), includeFlags.end());
+		job.args.push_back(cpp ? "-D__FFC_LANG_CPP" : "-D__FFC_LANG_C");
+		job.args.push_back(arm9 ? "-D__FFC_ARCH_NUM=9" : "-D__FFC_ARCH_NUM=7");
+
+		std::string headerString = getPathString(headerPath);
+		u64 fingerprint = getCommandFingerprint(job.args);
+		tracker.fingerprintTrackers[headerString] = fingerprint;
+
+		if (!needsCompilation(tracker, headerPath, pchPath, fingerprint)) {
+
+			trackDependencies(tracker, headerPath, depPath, true);
+			headers[variant] = PrecompiledHeader{ headerPath, getPreludeStamp(tracker, headerPath, fingerprint) };
+			continue;
+
+		}
+
+		jobs.push_back(std::move(job));
+		jobVariants.push_back(variant);
+
+	}
+
+	if (jobs.empty()) {
+		return true;
+	}
+
+	std::cout << DINFO << "Precompiling headers..." << std::endl;
+
+	//A broken prelude only costs the speedup, units still see the headers textually
+	executeJobs(jobs, settings.threadCount, false);
+
+	for (u32 i = 0; i < jobs.size(); i++) {
+
+		const std::string& variant = jobVariants[i];
+		const fs::path& pchDir = settings.buildDir / "pch" / variant;
+		fs::path headerPath = pchDir / "prelude.h";
+		fs::path pchPath = pchDir / "prelude.h.gch";
+
+		if (jobs[i].status) {
+
+			std::cout << DWARNING << "Failed to precompile prelude " << variant << ", falling back to textual inclusion" << std::endl;
+			tracker.fingerprintTrackers.erase(getPathString(headerPath));
+
+			std::error_code ec;
+			fs::remove(pchPath, ec);
+
+			continue;
+
+		}
+
+		trackDependencies(tracker, headerPath, pchDir / "prelude.d", false);
+		headers[variant] = PrecompiledHeader{ headerPath, getPreludeStamp(tracker, headerPath, tracker.fingerprintTrackers.at(getPathString(headerPath))) };
+
+	}
+
+	return true;
+
+}
+
+
+
+u64 getPreludeStamp(DependencyTracker& tracker, const fs::path& headerPath, u64 fingerprint) {
+
+	const std::string& headerString = getPathString(headerPath);
+	u64 stamp = fingerprint;
+
+	//Units depend on what went into the precompiled header, so regenerating it from unchanged headers keeps them up to date
+	std::vector<std::string> paths = { headerString };
+
+	if (tracker.graphTrackers.contains(headerString)) {
+		paths = tracker.graphTrackers.at(headerString);
+	}
+
+	for (const std::string& path : paths) {
+
+		FileState state{};
+		u64 hash = 0;
+
+		if (queryFileState(tracker, path, state)) {
+			hash = state.hash;
+		}
+
+		//Hashes are kept with the tracked state so that only edited headers are read again
+		if (!hash && hashFile(path, hash)) {
+
+			tracker.fileStates[path].hash = hash;
+
+			if (tracker.trackers.contains(path)) {
+				tracker.trackers.at(path).hash = hash;
+			}
+
+		}
+
+		stamp = hashData(reinterpret_cast<const u8*>(&hash), sizeof(u64), stamp);
+
+	}
+
+	return stamp;
+
+}
+
+
+
+void getPreludeHeaders(const BuildSettings& settings, bool assembly, std::vector<fs::path>& headers) {
+
+	fs::path ffcPath(settings.toolchainDir / "internal" / "ffc.h");
+	fs::path fidPath(settings.toolchainDir / "internal" / "fid.h");
+
+	if (fs::exists(fidPath) && fs::is_regular_file(fidPath)) {
+		headers.push_back(fidPath);
+	}
+
+	headers.push_back(ffcPath);
+
+	//User preludes are C/C++ headers and never reach the assembler
+	if (!assembly) {
+		headers.insert(headers.end(), settings.preludeHeaders.begin(), settings.preludeHeaders.end());
+	}
+
+}
+
+
+
+std::string getPreludeVariant(CodeTarget target, const std::string& extension) {
+	return std::string(isARM9Target(target) ? "arm9" : "arm7") + (extension == ".cpp" ? "_cpp" : "_c");
+}
+
+
+/*
+bool compileSet(const BuildSettings& settings, CodeTarget target, const std::set<fs::path>& files, const std::string& includeFlags, DependencyTracker& tracker) {
+
+	const std::string* flags = nullptr;
+	const std::string* arch = nullptr;
+
+	for (const fs::path& source : files) {
+
+		const std::string& extension = source.extension().string();
+		fs::path objectPath = getObjectPath(settings, source);
+		fs::path depPath = getDependencyPath(settings, source);
+		s32 status = 0;
+		std::string cmd;
+		std::string defines;
+
+		if (!isCompilableFile(source)) {
+			continue;
+		}
+
+		std::string objectPathString = getPathString(objectPath);
+
+		if (tracker.compilationObjects.contains(objectPathString)) {
+			std::cout << DERROR << "Fatal error: Multiple references to object file " << objectPathString << std::endl;
+			return false;
+		}
+
+		tracker.compilationObjects.insert(objectPathString);
+
+		if (!needsCompilation(settings, tracker, source)) {
+			trackDependencies(settings, tracker, depPath, true);
+			continue;
+		}
+
+		if (extension == ".cpp") {
+			std::cout << DINFO << "Compiling C++ source " << source.string() << std::endl;
+			flags = &settings.flags.cpp;
+			defines += " -D__FFC_LANG_CPP";
+		} else if (extension == ".c") {
+			std::cout << DINFO << "Compiling C source " << source.string() << std::endl;
+			flags = &settings.flags.c;
+			defines += " -D__FFC_LANG_C";
+		} else {
+			std::cout << DINFO << "Compiling ASM source " << source.string() << std::endl;
+			flags = &settings.flags.assembly;
+			defines += " -D__FFC_LANG_ASM";
+		}
+
+		if (isARM9Target(target)) {
+
+			arch = &settings.flags.arm9;
+			defines += " -D__FFC_ARCH_NUM=9";
+
+		} else {
+
+			arch = &settings.flags.arm7;
+			defines += " -D__FFC_ARCH_NUM=7";
+
+		}
+
+		cmd = settings.executables.gcc + " " + *flags + " " + *arch + " -c " + source.string() + " -o " + objectPathString + " -MMD -MF " + depPath.string() + includeFlags + defines;
+		status = std::system(cmd.c_str());
+
+		if (status) {
+
+			std::cout << DWARNING << "Failed with status " << status << std::endl;
+			status = 0;
+			state = false;
+
+			if (settings.pedantic) {
+				return state;
+			}
+
+		} else {
+
+			trackDependencies(settings, tracker, depPath, false);
+
+		}
+
+	}
+
+	return state;
+
+}
+*/
+
+
+
+bool populateCodeTargets(const BuildSettings& settings, Document& root, const FileTree& tree, CodeTargetMap& codeTargets) {
+
+	std::cout << DINFO << "Parsing code target configuration" << std::endl;
+
+	if (!root["main"].IsObject()) {
+		std::cout << DERROR << "Missing JSON object 'main'" << std::endl;
+		return false;
+	}
+
+	const Value& codeNode = root["main"].GetObject();
+
+	for (auto& v : codeNode.GetObject()) {
+
+		std::string target = v.name.GetString();
+
+		if (target == "default-target") {
+			continue;
+		}
+
+		CodeTarget codeTarget = getCodeTarget(target);
+
+		if (codeTarget != invalidTarget) {
+			RETURN_ON_ERROR(getSourceSet(codeNode, target, settings.sourceDir, tree, codeTargets[codeTarget]))
+		} else {
+			std::cout << DERROR << "Invalid code target " << target << std::endl;
+			return false;
+		}
+
+	}
+
+	if (codeNode["default-target"].IsString()) {
+
+		std::string defaultTarget = codeNode["default-target"].GetString();
+		CodeTarget codeTarget = getCodeTarget(defaultTarget);
+
+		if (codeTarget != invalidTarget) {
+			scanDefaultTarget(codeTargets, codeTarget, settings.sourceDir, tree);
+		} else {
+			std::cout << DERROR << "Invalid default target " << defaultTarget << std::endl;
+			return false;
+		}
+
+	}
+
+	return true;
+
+}
+
+
+
+
+bool linkProcessor(const BuildSettings& settings, const PatchSettings& patchSettings, bool arm9, LinkStage& stage, LinkedImages& images) {
+
+	const std::string& procName = arm9 ? "arm9" : "arm7";
+	const fs::path& scriptPath = settings.buildDir / (procName + ".x");
+	const fs::path& elfPath = settings.buildDir / (procName + ".elf");
+	const fs::path& symbolPath = arm9 ? settings.symbol9File : settings.symbol7File;
+
+	//Outputs of ld must not be mistaken for the ones of this build
+	if (stage.codeTargets.empty() || settings.internalLinker) {
+
+		for (const fs::path& stalePath : { scriptPath, elfPath }) {
+
+			if (fs::exists(stalePath) && fs::is_regular_file(stalePath)) {
+				removeFile(stalePath, "old linker output");
+			}
+
+		}
+
+	}
+
+	if (stage.codeTargets.empty()) {
+		return true;
+	}
+
+	RETURN_ON_ERROR(checkOverlayTargets(patchSettings, stage.codeTargets))
+
+	//The input hash already covers the object contents, the symbols file is read by both linkers
+	u64 symbolHash = 0;
+
+	if (!symbolPath.empty()) {
+		RETURN_ON_ERROR(hashFile(symbolPath, symbolHash))
+	}
+
+	stage.inputHash = hashData(reinterpret_cast<const u8*>(&symbolHash), sizeof(u64), stage.inputHash);
+
+	if (settings.internalLinker) {
+		return linkObjects(settings, patchSettings, stage.codeTargets, arm9, stage.hookSymbols, stage.fixups, images);
+	}
+
+	std::string linkerScript;
+	generateLinkerScript(settings, patchSettings, stage.codeTargets, arm9, stage.hookSymbols, linkerScript);
+
+	const std::string& libraryPath = settings.useAEABI ? settings.libraryDir.string() : "";
+	stage.inputHash = hashData(reinterpret_cast<const u8*>(linkerScript.data()), linkerScript.size(), stage.inputHash);
+	stage.inputHash = hashData(reinterpret_cast<const u8*>(libraryPath.data()), libraryPath.size(), stage.inputHash);
+
+	std::stringstream stamp;
+	stamp << "/* Link inputs " << std::setw(16) << std::setfill('0') << std::uppercase << std::hex << stage.inputHash << " */\n";
+
+	std::string stampedScript = linkerScript;
+	stampedScript.insert(stampedScript.find('\n') + 1, stamp.str());
+
+	if (fs::exists(elfPath) && fs::is_regular_file(elfPath) && fs::exists(scriptPath) && fs::is_regular_file(scriptPath)) {
+
+		std::ifstream scriptFile(scriptPath, std::ios::in);
+		std::stringstream scriptStream;
+		scriptStream << scriptFile.rdbuf();
+		scriptFile.close();
+
+		if (scriptStream.str() == stampedScript) {
+			std::cout << DINFO << "Link inputs of " << procName << " unchanged, reusing " << elfPath.filename().string() << std::endl;
+			return true;
+		}
+
+	}
+
+	RETURN_ON_ERROR(writeFileIfChanged(scriptPath, linkerScript, procName + " linker script"))
+
+	std::cout << DINFO << "Generated linker script " << scriptPath.filename().string() << std::endl;
+
+	RETURN_ON_ERROR(linkSource(settings, arm9))
+
+	//The stamp is only added once ld succeeded so that an interrupted link is never reused
+	return writeFileIfChanged(scriptPath, stampedScript, procName + " linker script");
+
+}
+
+
+
+bool checkOverlayTargets(const PatchSettings& patchSettings, const CodeTargetMap& codeTargets) {
+
+	for (const auto& e : codeTargets) {
+
+		if (!isOverlay(e.first) || e.second.empty()) {
+			continue;
+		}
+
+		auto it = patchSettings.overlays.find(e.first);
+
+		if (it == patchSettings.overlays.end()) {
+			std::cout << DERROR << "Cannot inject code into " << getCodeTargetName(e.first) << ": Overlay does not exist" << std::endl;
+			return false;
+		}
+
+		if (!it->second.end) {
+			std::cout << DERROR << "Cannot inject code into " << getCodeTargetName(e.first) << ": No overlay is loaded behind it, set patch/" << getCodeTargetName(e.first) << "/budget" << std::endl;
+			return false;
+		}
+
+	}
+
+	return true;
+
+}
+
+
+
+void generateLinkerScript(const BuildSettings& buildSettings, const PatchSettings& patchSettings, const CodeTargetMap& codeTargets, bool arm9, HookSymbols& hookSymbols, std::string& linkerScript) {
+
+	const std::string& procName = arm9 ? "arm9" : "arm7";
+	u32 armStart = arm9 ? patchSettings.arm9.start : patchSettings.arm7.start;
+	u32 armEnd = arm9 ? patchSettings.arm9.end : patchSettings.arm7.end;
+
+	CodeTargetMap inputTargets;
+
+	for (const auto& e : codeTargets) {
+
+		for (const fs::path& sourceFile : e.second) {
+			inputTargets[e.first].insert(getLinkerInputPath(buildSettings, sourceFile));
+		}
+
+	}
+
+	linkerScript = "/* Auto-generated linker script */\n\n";
+
+	if (arm9 && !buildSettings.symbol9File.empty()) {
+		linkerScript += "INCLUDE " + buildSettings.symbol9File.string() + "\n";
+	} else if (!arm9 && !buildSettings.symbol7File.empty()) {
+		linkerScript += "INCLUDE " + buildSettings.symbol7File.string() + "\n";
+	}
+
+	linkerScript += "SEARCH_DIR(" + buildSettings.objectDir.string() + ")\n\n";
+	linkerScript += "INPUT(\n";
+
+	u32 inputFiles = 0;
+
+	for (const auto& e : inputTargets) {
+
+		u32 i = 0;
+		u32 targetInputFiles = e.second.size();
+		const std::string& target = getCodeTargetName(e.first);
+		linkerScript += "/* " + target + " */\t";
+
+		if (target.size() < 6) {
+			linkerScript += "\t";
+		}
+
+		for (const fs::path& sourceFile : e.second) {
+
+			linkerScript += sourceFile.string();
+
+			if (i && (i % 4 == 3) && i != targetInputFiles - 1) {
+				linkerScript += "\n\t\t\t\t";
+			} else if (i != targetInputFiles - 1) {
+				linkerScript += " ";
+			}
+
+			i++;
+
+		}
+
+		linkerScript += "\n";
+		inputFiles += i;
+
+	}
+
+	if (!inputFiles) {
+		return;
+	}
+
+
+	linkerScript += ")\n\n";
+	linkerScript += "MEMORY\n{\n";
+	linkerScript += "\tldpatch (rwx): ORIGIN = 0x00000000, LENGTH = 1000000\n";
+	linkerScript += "\t" + procName + " (rwx): ORIGIN = " + getHexString(armStart) + ", LENGTH = " + std::to_string(armEnd - armStart) + '\n';
+
+	for (const auto& e : inputTargets) {
+
+		if (isOverlay(e.first)) {
+			const PatchSettings::OverlaySettings& overlay = patchSettings.overlays.at(e.first);
+			linkerScript += "\t" + getCodeTargetName(e.first) + " (rwx): ORIGIN = " + getHexString(overlay.start) + ", LENGTH = " + std::to_string(overlay.end - overlay.start) + '\n';
+		}
+
+	}
+	
+	linkerScript += "}\n\n";
+	linkerScript += "SECTIONS\n{\n";
+
+	static const std::string sections[] = {
+		"(.safe.*)", "(.hook.*)", "(.rlnk.*)", "(.text)", "(.text.*)", "(.rodata)", "(.rodata.*)", "(.init_array)", "(.data)", "(.bss)", "(.bss.*)"
+	};
+
+	static constexpr u32 sectionCount = 9;
+	
+	for (const auto& e : inputTargets) {
+
+		const std::string& indent = isBinary(e.first) ? "\t" : "\t\t";
+
+		const std::string& target = getCodeTargetName(e.first);
+		linkerScript += "\t.text." + target + " : ALIGN(4) {\n";
+		linkerScript += "\t\t. += " + std::to_string(hookSymbols.safeCounts[e.first]) + ";\n";
+
+		//Pool of veneers for interworking hooks to functions of this target
+		if (hookSymbols.veneerCounts[e.first]) {
+			linkerScript += "\t\t__ffc_veneer_start_" + target + " = .;\n";
+			linkerScript += "\t\t. += " + std::to_string(hookSymbols.veneerCounts[e.first]) + ";\n";
+			linkerScript += "\t\t__ffc_veneer_end_" + target + " = .;\n";
+		}
+
+		for (u32 i = 0; i < sectionCount; i++) {
+
+			//Overlays get a new static initializer table holding the original entries followed by the injected ones
+			if (i == 7 && isOverlay(e.first)) {
+				linkerScript += "\t\t. = ALIGN(4);\n\t\t__ffc_init_start_" + target + " = .;\n";
+				linkerScript += "\t\t. += " + std::to_string(patchSettings.overlays.at(e.first).initSize) + ";\n";
+			}
+
+			for (const fs::path& sourceFile : e.second) {
+				linkerScript += "\t\t" + sourceFile.string() + sections[i] + "\n";
+			}
+
+			if (i == 7 && isOverlay(e.first)) {
+				linkerScript += "\t\t__ffc_init_end_" + target + " = .;\n";
+			}
+
+		}
+
+		linkerScript += "\t\t. = ALIGN(4);\n\t} >" + target + " AT>ldpatch\n\n";
+		linkerScript += "\t.bss." + target + " : ALIGN(4) {\n";
+
+		for (const fs::path& sourceFile : e.second) {
+			linkerScript += "\t\t" + sourceFile.string() + sections[9] + "\n";
+			linkerScript += "\t\t" + sourceFile.string() + sections[10] + "\n";
+		}
+
+		linkerScript += "\t\t. = ALIGN(4); \n\t} >" + target + " AT>ldpatch\n\n";
+
+	}
+
+	HookMap& hooks = hookSymbols.getSymbolMap(arm9);
+
+	for (auto it = hooks.begin(); it != hooks.end();) {
+
+		if (it->second.hookType != HookType::Replace) {
+			it++;
+			continue;
+		}
+
+		std::stringstream hookAddressStream;
+		hookAddressStream << "0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << it->second.hookAddress;
+		const std::string& hookAddress = hookAddressStream.str();
+		const std::string& section = ".over." + getCodeTargetName(it->second.codeTarget) + "." + hookAddress;
+
+		linkerScript += "\t" + section + " " + hookAddress + " : SUBALIGN(1) {\n\t\t*(" + section + ")\n\t} AT>ldpatch\n\n";
+
+		it = hooks.erase(it);
+
+	}
+
+	linkerScript += "\t/DISCARD/ : {*(.*)}\n";
+	linkerScript += "}\n";
+
+}
+
+
+
+
+bool linkSource(const BuildSettings& settings, bool arm9) {
+
+	const std::string& archName = arm9 ? "arm9" : "arm7";
+	const fs::path& armLinkerFilename = settings.buildDir / (archName + ".x");
+	const fs::path& elfOutputFilename = settings.buildDir / (archName + ".elf");
+
+	if (!fs::exists(armLinkerFilename) || !fs::is_regular_file(armLinkerFilename)) {
+		return true;
+	}
+
+	std::cout << DINFO << "Linking " << armLinkerFilename.string() << std::endl;
+
+	std::vector<ProcessJob> jobs(1);
+	ProcessJob& job = jobs.front();
+
+	job.args = { settings.executables.ld, "-T", armLinkerFilename.string(), "--nmagic" };
+
+	if (settings.useAEABI) {
+		job.args.insert(job.args.end(), { "-lgcc", "-L" + settings.libraryDir.string() });
+	}
+
+	job.args.insert(job.args.end(), { "-o", elfOutputFilename.string() });
+
+	//The implicit token belongs to the compilation still running for the other processor, so the linker takes a token of its own
+	s32 token = -1;
+	RETURN_ON_ERROR(acquireJobToken(jobServer, token, []() { return true; }))
+
+	bool linked = executeJobs(jobs, 1, true);
+	releaseJobToken(jobServer, token);
+
+	if (!linked) {
+		std::cout << DERROR << "Failed to link " << archName << " objects: Linker returned " << job.status << std::endl;
+		return false;
+	}
+
+	std::cout << DINFO << "Linking " << archName << " successful" << std::endl;
+
+	return true;
+
+}
+
+
+
+bool linkObjects(const BuildSettings& settings, const PatchSettings& patchSettings, const CodeTargetMap& codeTargets, bool arm9, HookSymbols& hookSymbols, std::vector<Fixup>& fixups, LinkedImages& images) {
+
+	const std::string& procName = arm9 ? "arm9" : "arm7";
+	std::vector<LinkerObject> objects;
+
+	for (const auto& e : codeTargets) {
+
+		for (const fs::path& sourceFile : e.second) {
+			objects.push_back(LinkerObject{ getObjectPath(settings, sourceFile), e.first });
+		}
+
+	}
+
+	if (objects.empty()) {
+		return true;
+	}
+
+	//Same input order as the generated linker scripts so that both backends produce identical binaries
+	auto getInputName = [&](const LinkerObject& object) {
+		return isSubpath(object.path, settings.objectDir) ? object.path.lexically_relative(settings.objectDir) : object.path;
+	};
+
+	std::sort(objects.begin(), objects.end(), [&](const LinkerObject& x, const LinkerObject& y) {
+		return x.target != y.target ? x.target < y.target : getInputName(x) < getInputName(y);
+	});
+
+	std::cout << DINFO << "Linking " << objects.size() << " " << procName << " objects" << std::endl;
+
+	std::vector<u8>& output = images.getOutput(arm9);
+	std::string symbolFile;
+	LinkerSymbolMap symbols;
+	bool linked = true;
+
+	output.clear();
+
+	for (LinkerObject& object : objects) {
+		linked = linked && loadLinkerObject(object);
+	}
+
+	linked = linked && loadSymbolFile(arm9 ? settings.symbol9File : settings.symbol7File, symbolFile, symbols);
+	linked = linked && layoutLinkerSections(patchSettings, arm9, objects, hookSymbols, output, fixups);
+	linked = linked && resolveLinkerSymbols(objects, symbols);
+	linked = linked && relocateLinkerSections(objects, symbols, arm9, output);
+
+	if (linked) {
+		resolveHookAddresses(objects, hookSymbols.getSymbolMap(arm9));
+	}
+
+	for (LinkerObject& object : objects) {
+		closeElfImage(object.image);
+	}
+
+	RETURN_ON_ERROR(linked)
+
+	std::cout << DINFO << "Linking " << procName << " successful" << std::endl;
+
+	return true;
+
+}
+
+
+
+bool loadLinkerObject(LinkerObject& object) {
+
+	RETURN_ON_ERROR(openElfImage(object.path, object.image))
+
+	const ElfImage& image = object.image;
+	u16 type = *reinterpret_cast<const u16*>(&image.data[0x10]);
+	u16 machine = *reinterpret_cast<const u16*>(&image.data[0x12]);
+
+	if (type != 1 || machine != 40) {
+		std::cout << DERROR << "Cannot link " << object.path.string() << ": Not a relocatable ARM object file" << std::endl;
+		return false;
+	}
+
+	object.sections.resize(image.sectionCount);
+	object.addresses.assign(image.sectionCount, unplacedSection);
+	object.offsets.assign(image.sectionCount, unplacedSection);
+
+	for (u32 i = 0; i < image.sectionCount; i++) {
+
+		getElfSection(image, i, object.sections[i]);
+
+		if (object.sections[i].type == 2) {
+			object.symtab = object.sections[i];
+		}
+
+	}
+
+	if (!object.symtab.offset || !getElfSection(image, object.symtab.link, object.strtab)) {
+		std::cout << DERROR << "Error while parsing object file " << object.path.string() << ": Missing symbol table" << std::endl;
+		return false;
+	}
+
+	return true;
+
+}
+
+
+
+bool loadSymbolFile(const fs::path& p, std::string& content, LinkerSymbolMap& symbols) {
+
+	if (p.empty()) {
+		return true;
+	}
+
+	std::ifstream symbolFile(p, std::ios::in | std::ios::binary);
+
+	if (!symbolFile.is_open()) {
+		std::cout << DERROR << "Failed to open symbol file " << p.string() << std::endl;
+		return false;
+	}
+
+	content.assign(std::istreambuf_iterator<char>(symbolFile), std::istreambuf_iterator<char>());
+	symbolFile.close();
+
+	//Comments are blanked out in place since the symbol names below are views into the file contents
+	for (u64 i = content.find("/*"); i != std::string::npos; i = content.find("/*", i)) {
+
+		u64 end = content.find("*/", i + 2);
+		end = end == std::string::npos ? content.size() : end + 2;
+		std::fill(content.begin() + i, content.begin() + end, ' ');
+
+	}
+
+	for (u64 i = content.find("//"); i != std::string::npos; i = content.find("//", i)) {
+
+		u64 end = content.find('\n', i);
+		end = end == std::string::npos ? content.size() : end;
+		std::fill(content.begin() + i, content.begin() + end, ' ');
+
+	}
+
+	auto trim = [](std::string_view s) {
+
+		u64 first = s.find_first_not_of(" \t\r\n");
+		u64 last = s.find_last_not_of(" \t\r\n");
+
+		return first == std::string::npos ? std::string_view() : s.substr(first, last - first + 1);
+
+	};
+
+	std::string_view statements = content;
+
+	while (!statements.empty()) {
+
+		u64 end = statements.find(';');
+		std::string_view statement = trim(statements.substr(0, end));
+
+		statements = end == std::string::npos ? std::string_view() : statements.substr(end + 1);
+
+		if (statement.empty()) {
+			continue;
+		}
+
+		u64 assignment = statement.find('=');
+		std::string_view name = trim(statement.substr(0, assignment));
+		std::string value(assignment == std::string::npos ? std::string_view() : trim(statement.substr(assignment + 1)));
+
+		if (name.size() >= 2 && name.front() == '"' && name.back() == '"') {
+			name = name.substr(1, name.size() - 2);
+		}
+
+		u32 address = 0;
+		u64 parsed = 0;
+
+		try {
+			address = std::stoul(value, &parsed, 0);
+		} catch (std::exception&) {
+			parsed = 0;
+		}
+
+		if (name.empty() || value.empty() || parsed != value.size()) {
+			std::cout << DERROR << "Unsupported statement '" << statement << "' in " << p.string() << ": Only 'symbol = address;' is understood by the internal linker" << std::endl;
+			return false;
+		}
+
+		symbols[name] = LinkerSymbol{ address & ~1, (address & 1) != 0, false, true, noLinkerObject };
+
+	}
+
+	return true;
+
+}
+
+
+
+bool layoutLinkerSections(const PatchSettings& patchSettings, bool arm9, std::vector<LinkerObject>& objects, HookSymbols& hookSymbols, std::vector<u8>& output, std::vector<Fixup>& fixups) {
+
+	struct SectionPattern {
+		std::string_view name;
+		bool wildcard;
+	};
+
+	static constexpr SectionPattern textPatterns[] = {
+		{ ".safe.", true }, { ".hook.", true }, { ".rlnk.", true }, { ".text", false }, { ".text.", true }, { ".rodata", false }, { ".rodata.", true }, { ".init_array", false }, { ".data", false }
+	};
+
+	static constexpr SectionPattern bssPatterns[] = {
+		{ ".bss", false }, { ".bss.", true }
+	};
+
+	auto matches = [](const ElfSection& section, const SectionPattern& pattern) {
+		return (section.flags & 2) && (pattern.wildcard ? section.name.starts_with(pattern.name) : section.name == pattern.name);
+	};
+
+	//Input sections are aligned by their own requirement and copied to the end of the output, NOBITS sections only reserve address space
+	auto place = [&](LinkerObject& object, u32 index, u32& address, u32 alignment, bool copy) {
+
+		const ElfSection& section = object.sections[index];
+		u32 padding = (alignment - address % alignment) % alignment;
+		const u8* data = nullptr;
+
+		address += padding;
+		object.addresses[index] = address;
+		address += section.size;
+
+		if (!copy) {
+			return true;
+		}
+
+		output.resize(output.size() + padding);
+		object.offsets[index] = output.size();
+
+		if (section.type == 8) {
+			output.resize(output.size() + section.size);
+		} else if (getElfData(object.image, section.offset, section.size, data)) {
+			output.insert(output.end(), data, data + section.size);
+		} else {
+			std::cout << DERROR << "Section " << section.name << " out of bounds in " << object.path.string() << std::endl;
+			return false;
+		}
+
+		return true;
+
+	};
+
+	u32 armStart = arm9 ? patchSettings.arm9.start : patchSettings.arm7.start;
+	u32 armEnd = arm9 ? patchSettings.arm9.end : patchSettings.arm7.end;
+	u32 first = 0;
+
+	while (first < objects.size()) {
+
+		CodeTarget target = objects[first].target;
+		u32 last = first;
+
+		while (last < objects.size() && objects[last].target == target) {
+			last++;
+		}
+
+		u32 address = (armStart + 3) & ~3;
+		u32 regionEnd = armEnd;
+
+		if (isOverlay(target)) {
+			address = patchSettings.overlays.at(target).start;
+			regionEnd = patchSettings.overlays.at(target).end;
+		}
+
+		Patch patch{ target, address, static_cast<u32>(output.size()), 0, 0, 4 };
+		u32 safeBytes = hookSymbols.safeCounts[target];
+
+		address += safeBytes;
+		output.resize(output.size() + safeBytes);
+
+		if (hookSymbols.veneerCounts[target]) {
+
+			u32 veneerBytes = hookSymbols.veneerCounts[target];
+
+			patch.veneerStart = address;
+			patch.veneerEnd = address + veneerBytes;
+			address += veneerBytes;
+			output.resize(output.size() + veneerBytes);
+
+		}
+
+		for (const SectionPattern& pattern : textPatterns) {
+
+			bool initTable = pattern.name == ".init_array" && isOverlay(target);
+
+			if (initTable) {
+
+				u32 initSize = patchSettings.overlays.at(target).initSize;
+				u32 padding = (4 - address % 4) % 4;
+
+				patch.initStart = address + padding;
+				address += padding + initSize;
+				output.resize(output.size() + padding + initSize);
+
+			}
+
+			for (u32 i = first; i < last; i++) {
+
+				for (u32 j = 0; j < objects[i].sections.size(); j++) {
+
+					if (objects[i].addresses[j] == unplacedSection && matches(objects[i].sections[j], pattern)) {
+						RETURN_ON_ERROR(place(objects[i], j, address, std::max(objects[i].sections[j].align, 1u), true))
+					}
+
+				}
+
+			}
+
+			if (initTable) {
+				patch.initEnd = address;
+			}
+
+		}
+
+		address = (address + 3) & ~3;
+		patch.binSize = address - patch.ramAddress;
+		output.resize(patch.binOffset + patch.binSize);
+
+		u32 bssStart = address;
+
+		for (u32 i = first; i < last; i++) {
+
+			for (const SectionPattern& pattern : bssPatterns) {
+
+				for (u32 j = 0; j < objects[i].sections.size(); j++) {
+
+					if (objects[i].addresses[j] == unplacedSection && matches(objects[i].sections[j], pattern)) {
+						patch.bssAlign = std::max(patch.bssAlign, objects[i].sections[j].align);
+						place(objects[i], j, address, std::max(objects[i].sections[j].align, 1u), false);
+					}
+
+				}
+
+			}
+
+		}
+
+		address = (address + 3) & ~3;
+		patch.bssSize = address - bssStart;
+
+		if (address > regionEnd) {
+			std::cout << DERROR << "Code target " << getCodeTargetName(target) << " overflows its memory region by 0x" << std::uppercase << std::hex << (address - regionEnd) << " bytes" << std::endl;
+			return false;
+		}
+
+		fixups.push_back(patch);
+		first = last;
+
+	}
+
+	HookMap& hooks = hookSymbols.getSymbolMap(arm9);
+
+	for (auto it = hooks.begin(); it != hooks.end();) {
+
+		if (it->second.hookType != HookType::Replace) {
+			it++;
+			continue;
+		}
+
+		const std::string& section = ".over." + getCodeTargetName(it->second.codeTarget) + "." + getHexString(it->second.hookAddress);
+		u32 overAddress = it->second.hookAddress;
+		Patch patch{ it->second.codeTarget, overAddress, static_cast<u32>(output.size()), 0, noBSS, noBSS };
+
+		for (LinkerObject& object : objects) {
+
+			for (u32 j = 0; j < object.sections.size(); j++) {
+
+				//Replacements are packed byte by byte like SUBALIGN(1) in the generated scripts
+				if (object.addresses[j] == unplacedSection && object.sections[j].name == section) {
+					RETURN_ON_ERROR(place(object, j, overAddress, 1, true))
+				}
+
+			}
+
+		}
+
+		patch.binSize = overAddress - patch.ramAddress;
+
+		if (patch.binSize) {
+			fixups.push_back(patch);
+		}
+
+		it = hooks.erase(it);
+
+	}
+
+	return true;
+
+}
+
+
+
+bool resolveLinkerSymbols(const std::vector<LinkerObject>& objects, LinkerSymbolMap& symbols) {
+
+	bool resolved = true;
+
+	for (u32 i = 0; i < objects.size(); i++) {
+
+		const LinkerObject& object = objects[i];
+		ElfSymbol symbol;
+
+		for (u32 j = 1; getElfSymbol(object.image, object.symtab, object.strtab, j, symbol); j++) {
+
+			//Local symbols are resolved per object during relocation
+			if (symbol.binding == 0 || symbol.section == 0) {
+				continue;
+			}
+
+			if (symbol.section == 0xFFF2) {
+				std::cout << DERROR << "Common symbol " << symbol.name << " in " << object.path.string() << " is not supported, compile with -fno-common" << std::endl;
+				resolved = false;
+				continue;
+			}
+
+			LinkerSymbol definition = getLinkerSymbol(object, symbol, i);
+			auto result = symbols.try_emplace(symbol.name, definition);
+			LinkerSymbol& existing = result.first->second;
+
+			//Symbol file assignments take precedence like script assignments do in ld
+			if (result.second || existing.object == noLinkerObject || definition.weak) {
+				continue;
+			}
+
+			if (!existing.weak) {
+				std::cout << DERROR << "Multiple definition of " << symbol.name << " in " << object.path.string() << " and " << objects[existing.object].path.string() << std::endl;
+				resolved = false;
+				continue;
+			}
+
+			existing = definition;
+
+		}
+
+	}
+
+	return resolved;
+
+}
+
+
+
+LinkerSymbol getLinkerSymbol(const LinkerObject& object, const ElfSymbol& symbol, u32 objectIndex) {
+
+	//Thumb functions carry the mode in bit 0 of their value
+	bool thumb = symbol.type == 2 && (symbol.value & 1);
+	u32 value = thumb ? symbol.value & ~1 : symbol.value;
+
+	LinkerSymbol definition{ value, thumb, symbol.binding == 2, true, objectIndex };
+
+	if (symbol.section == 0xFFF1) {
+		return definition;
+	}
+
+	if (symbol.section >= object.addresses.size() || object.addresses[symbol.section] == unplacedSection) {
+		definition.placed = false;
+		return definition;
+	}
+
+	definition.address += object.addresses[symbol.section];
+
+	return definition;
+
+}
+
+
+
+bool relocateLinkerSections(const std::vector<LinkerObject>& objects, const LinkerSymbolMap& symbols, bool arm9, std::vector<u8>& output) {
+
+	bool relocated = true;
+
+	for (const LinkerObject& object : objects) {
+
+		for (const ElfSection& relocations : object.sections) {
+
+			bool rela = relocations.type == 4;
+
+			//Relocations of discarded or uninitialized sections (e.g. debug info) are dropped along with them
+			if ((relocations.type != 9 && !rela) || relocations.info >= object.sections.size() || object.offsets[relocations.info] == unplacedSection) {
+				continue;
+			}
+
+			const ElfSection& section = object.sections[relocations.info];
+			u32 entrySize = rela ? 12 : 8;
+			const u8* entries = nullptr;
+
+			if (!getElfData(object.image, relocations.offset, relocations.size, entries)) {
+				std::cout << DERROR << "Section " << relocations.name << " out of bounds in " << object.path.string() << std::endl;
+				return false;
+			}
+
+			for (u32 i = 0; i < relocations.size / entrySize; i++) {
+
+				const u8* entry = &entries[i * entrySize];
+				u32 offset = *reinterpret_cast<const u32*>(&entry[0]);
+				u32 info = *reinterpret_cast<const u32*>(&entry[4]);
+				s32 addend = rela ? *reinterpret_cast<const s32*>(&entry[8]) : 0;
+				u32 type = info & 0xFF;
+				u32 width = type == R_ARM_ABS8 ? 1 : (type == R_ARM_ABS16 || type == R_ARM_THM_JUMP11 || type == R_ARM_THM_JUMP8) ? 2 : 4;
+
+				ElfSymbol symbol;
+				LinkerSymbol definition{ 0, false, false, true, noLinkerObject };
+
+				if (!getElfSymbol(object.image, object.symtab, object.strtab, info >> 8, symbol) || static_cast<u64>(offset) + width > section.size) {
+					std::cout << DERROR << "Corrupted relocation in " << object.path.string() << " (" << section.name << "+0x" << std::uppercase << std::hex << offset << ")" << std::endl;
+					return false;
+				}
+
+				auto it = symbols.find(symbol.name);
+				std::string_view name = symbol.name.empty() && symbol.section < object.sections.size() ? object.sections[symbol.section].name : symbol.name;
+
+				if (symbol.binding == 0) {
+
+					definition = getLinkerSymbol(object, symbol, noLinkerObject);
+
+				} else if (it != symbols.end()) {
+
+					definition = it->second;
+
+				} else if (symbol.binding != 2) {
+
+					std::cout << DERROR << "Undefined reference to " << symbol.name << " in " << object.path.string() << " (" << section.name << "+0x" << std::uppercase << std::hex << offset << ")" << std::endl;
+					relocated = false;
+					continue;
+
+				}
+
+				if (!definition.placed) {
+					std::cout << DERROR << "Reference to " << name << " in " << object.path.string() << " (" << section.name << "+0x" << std::uppercase << std::hex << offset << ") points into a discarded section" << std::endl;
+					relocated = false;
+					continue;
+				}
+
+				std::string error;
+				u8* location = &output[object.offsets[relocations.info] + offset];
+				u32 place = object.addresses[relocations.info] + offset;
+
+				if (!applyRelocation(location, type, place, definition.address, definition.thumb, arm9, rela, addend, error)) {
+					std::cout << DERROR << "Failed to relocate " << name << " in " << object.path.string() << " (" << section.name << "+0x" << std::uppercase << std::hex << offset << "): " << error << std::endl;
+					relocated = false;
+				}
+
+			}
+
+		}
+
+	}
+
+	return relocated;
+
+}
+
+
+
+bool applyRelocation(u8* location, u32 type, u32 place, u32 address, bool thumb, bool arm9, bool rela, s32 addend, std::string& error) {
+
+	u32& word = *reinterpret_cast<u32*>(location);
+	u16& half = *reinterpret_cast<u16*>(location);
+
+	switch (type) {
+
+		case R_ARM_NONE:
+		case R_ARM_V4BX:
+
+			//bx exists on every DS processor, so there is nothing to rewrite
+			return true;
+
+		case R_ARM_ABS32:
+		case R_ARM_TARGET1:
+
+			word = (address + (rela ? addend : word)) | thumb;
+			return true;
+
+		case R_ARM_REL32:
+		case R_ARM_TARGET2:
+
+			word = ((address + (rela ? addend : word)) | thumb) - place;
+			return true;
+
+		case R_ARM_PREL31: {
+
+			s32 value = ((address + (rela ? addend : signExtend(word, 31))) | thumb) - place;
+
+			if (signExtend(value, 31) != value) {
+				error = "Offset out of range";
+				return false;
+			}
+
+			word = (word & 0x80000000) | (value & 0x7FFFFFFF);
+			return true;
+
+		}
+
+		case R_ARM_ABS16: {
+
+			s32 value = address + (rela ? addend : signExtend(half, 16));
+
+			if (value < -0x8000 || value > 0xFFFF) {
+				error = "Value out of range";
+				return false;
+			}
+
+			half = value;
+			return true;
+
+		}
+
+		case R_ARM_ABS8: {
+
+			s32 value = address + (rela ? addend : signExtend(*location, 8));
+
+			if (value < -0x80 || value > 0xFF) {
+				error = "Value out of range";
+				return false;
+			}
+
+			*location = value;
+			return true;
+
+		}
+
+		case R_ARM_PC24:
+		case R_ARM_CALL:
+		case R_ARM_JUMP24: {
+
+			bool blx = (word & 0xF0000000) == 0xF0000000;
+			bool link = blx || (word & 0x01000000);
+			s32 value = address + (rela ? addend : signExtend(word & 0xFFFFFF, 24) * 4) - place;
+
+			if (value < -0x2000000 || value > 0x1FFFFFF) {
+				error = "Branch target out of range";
+				return false;
+			}
+
+			if (!thumb) {
+				word = (blx ? COND_AL | ARM_BL : word & 0xFF000000) | ((value >> 2) & 0xFFFFFF);
+				return true;
+			}
+
+			if (!arm9) {
+				error = "Cannot create thumb-interworking veneer: blx not supported on armv4";
+				return false;
+			}
+
+			if (!link || (!blx && (word & 0xF0000000) != COND_AL)) {
+				error = "Cannot branch from ARM to Thumb without linking unconditionally";
+				return false;
+			}
+
+			word = ARM_BLX | ((value & 2) << 23) | ((value >> 2) & 0xFFFFFF);
+			return true;
+
+		}
+
+		case R_ARM_THM_CALL: {
+
+			u16& suffix = *reinterpret_cast<u16*>(location + 2);
+			s32 value = address + (rela ? addend : signExtend((half & 0x7FF) << 12 | (suffix & 0x7FF) << 1, 23)) - place;
+
+			if (!thumb && !arm9) {
+				error = "Cannot create thumb-interworking veneer: blx not supported on armv4";
+				return false;
+			}
+
+			//blx takes bit 1 of the target from the aligned instruction address
+			if (!thumb) {
+				value = (value + 2) & ~3;
+			}
+
+			if (value < -0x400000 || value > 0x3FFFFF) {
+				error = "Branch target out of range";
+				return false;
+			}
+
+			half = THUMB_BL0 | ((value >> 12) & 0x7FF);
+			suffix = (thumb ? THUMB_BL1 : THUMB_BLX1) | ((value >> 1) & 0x7FF);
+			return true;
+
+		}
+
+		case R_ARM_THM_JUMP11: {
+
+			s32 value = address + (rela ? addend : signExtend((half & 0x7FF) << 1, 12)) - place;
+
+			if (value < -0x800 || value > 0x7FF) {
+				error = "Branch target out of range";
+				return false;
+			}
+
+			half = (half & 0xF800) | ((value >> 1) & 0x7FF);
+			return true;
+
+		}
+
+		case R_ARM_THM_JUMP8: {
+
+			s32 value = address + (rela ? addend : signExtend((half & 0xFF) << 1, 9)) - place;
+
+			if (value < -0x100 || value > 0xFF) {
+				error = "Branch target out of range";
+				return false;
+			}
+
+			half = (half & 0xFF00) | ((value >> 1) & 0xFF);
+			return true;
+
+		}
+
+		default:
+
+			error = "Unsupported relocation type " + std::to_string(type);
+			return false;
+
+	}
+
+}
+
+
+
+void resolveHookAddresses(const std::vector<LinkerObject>& objects, HookMap& hooks) {
+
+	std::unordered_map<std::string_view, Hook*> hookSyms;
+	hookSyms.reserve(hooks.size());
+
+	for (auto& e : hooks) {
+		hookSyms[e.first] = &e.second;
+	}
+
+	for (const LinkerObject& object : objects) {
+
+		ElfSymbol symbol;
+
+		for (u32 i = 1; getElfSymbol(object.image, object.symtab, object.strtab, i, symbol); i++) {
+
+			auto it = hookSyms.find(symbol.name);
+
+			if (it == hookSyms.end() || symbol.section == 0) {
+				continue;
+			}
+
+			LinkerSymbol definition = getLinkerSymbol(object, symbol, noLinkerObject);
+
+			if (definition.placed) {
+				it->second->funcAddress = definition.address | definition.thumb;
+			}
+
+		}
+
+	}
+
+}
+
+
+
+
+bool patchBinaries(const BuildSettings& buildSettings, const PatchSettings& patchSettings, OverlayTable& ovt, const std::vector<Fixup>& fixups, const LinkedImages& images, std::vector<fs::path>& changedOutputs) {
+
+	std::cout << DINFO << "Patching arm9.bin" << std::endl;
+
+	for (auto& e : fixups) {
+
+		if (std::holds_alternative<Patch>(e)) {
+			std::cout << DINFO << "Found patch: " << getCodeTargetName(std::get<Patch>(e).codeTarget) << ", start=0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << std::get<Patch>(e).ramAddress << ", size=0x" << std::get<Patch>(e).binSize << ", bss=0x" << std::get<Patch>(e).bssSize << std::endl;
+		} else {
+			std::cout << DINFO << "Found hook: " << getCodeTargetName(std::get<Hook>(e).codeTarget) << ", hook=0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << std::get<Hook>(e).hookAddress << std::endl;
+		}
+
+	}
+
+	auto getFixupTarget = [](const Fixup& fix) {
+		return std::holds_alternative<Patch>(fix) ? std::get<Patch>(fix).codeTarget : std::get<Hook>(fix).codeTarget;
+	};
+
+	//Fixups are sorted by target and targets share nothing but their overlay table entries
+	std::vector<std::span<const Fixup>> targetFixups;
+
+	for (u32 i = 0; i < fixups.size();) {
+
+		u32 j = i + 1;
+
+		while (j < fixups.size() && getFixupTarget(fixups[j]) == getFixupTarget(fixups[i])) {
+			j++;
+		}
+
+		targetFixups.emplace_back(fixups.data() + i, j - i);
+		i = j;
+
+	}
+
+	//Veneers live next to the hook functions and may be written by a different target than the hooks using them
+	VeneerMap veneers;
+	RETURN_ON_ERROR(assignVeneers(fixups, veneers))
+
+	//Guards the console output, the overlay table, the ROM header and the list of changed outputs
+	std::mutex patchMutex;
+	std::atomic_uint targetIndex = 0;
+	std::atomic_bool successful = true;
+
+	auto patchFunction = [&]() {
+
+		while (successful) {
+
+			u32 i = targetIndex.fetch_add(1);
+
+			if (i >= targetFixups.size()) {
+				return;
+			}
+
+			if (!patchTarget(buildSettings, patchSettings, ovt, targetFixups[i], images, veneers, patchMutex, changedOutputs)) {
+				successful = false;
+			}
+
+		}
+
+	};
+
+	u32 threadCount = std::max(std::min(buildSettings.threadCount, static_cast<u32>(targetFixups.size())), 1u);
+	std::vector<std::thread> threads;
+
+	for (u32 i = 1; i < threadCount; i++) {
+		threads.emplace_back(patchFunction);
+	}
+
+	patchFunction();
+
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+
+	return successful;
+
+}
+
+
+
+bool patchTarget(const BuildSettings& buildSettings, const PatchSettings& patchSettings, OverlayTable& ovt, std::span<const Fixup> fixups, const LinkedImages& images, const VeneerMap& veneers, std::mutex& patchMutex, std::vector<fs::path>& changedOutputs) {
+
+	const Fixup& firstFix = fixups.front();
+	CodeTarget currentTarget = std::holds_alternative<Patch>(firstFix) ? std::get<Patch>(firstFix).codeTarget : std::get<Hook>(firstFix).codeTarget;
+
+	OverlayEntry entry{};
+	std::vector<fs::path> targetOutputs;
+	std::stringstream log;
+
+	if (isOverlay(currentTarget)) {
+		std::lock_guard<std::mutex> patchLock(patchMutex);
+		entry = ovt[currentTarget];
+	}
+
+	//Targets are patched concurrently on their own copies, so their diagnostics are printed in one piece once done
+	bool patched = patchTargetCopy(buildSettings, patchSettings, currentTarget, entry, fixups, images, veneers, patchMutex, targetOutputs, log);
+
+	std::lock_guard<std::mutex> patchLock(patchMutex);
+
+	std::cout << log.str() << std::flush;
+
+	RETURN_ON_ERROR(patched)
+
+	if (isOverlay(currentTarget)) {
+		ovt[currentTarget] = entry;
+	}
+
+	changedOutputs.insert(changedOutputs.end(), targetOutputs.begin(), targetOutputs.end());
+
+	return true;
+
+}
+
+
+
+bool patchTargetCopy(const BuildSettings& buildSettings, const PatchSettings& patchSettings, CodeTarget currentTarget, OverlayEntry& entry, std::span<const Fixup> fixups, const LinkedImages& images, const VeneerMap& veneers, std::mutex& patchMutex, std::vector<fs::path>& changedOutputs, std::ostream& log) {
+
+	const Fixup& firstFix = fixups.front();
+	bool firstIsPatch = std::holds_alternative<Patch>(firstFix);
+
+	SectionMap sections;
+	std::vector<u8> binary;
+	ARMBinaryProperties armBinaryProperties{};
+	std::vector<u8> safePatch;
+	std::vector<SectionWrite> hookWrites;
+	u32 patchStart = 0;
+	u32 patchOffset = 0;
+
+	log << DINFO << "Patching target " << getCodeTargetName(currentTarget) << std::endl;
+
+	if (!isBinary(currentTarget) && !isOverlay(currentTarget)) {
+
+		log << DERROR << "Invalid target detected for " << (firstIsPatch ? "patch" : "hook") << " at address 0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << (firstIsPatch ? std::get<Patch>(firstFix).ramAddress : std::get<Hook>(firstFix).hookAddress) << std::endl;
+		return false;
+
+	}
+
+	if (isBinary(currentTarget)) {
+
+		RETURN_ON_ERROR(loadBinary(buildSettings, currentTarget, armBinaryProperties, binary, log))
+		RETURN_ON_ERROR(addBinarySections(sections, currentTarget, armBinaryProperties, binary, log))
+
+	} else {
+
+		RETURN_ON_ERROR(loadOverlay(buildSettings, currentTarget, binary, log))
+		addSection(sections, currentTarget, SectionData{ entry.start, entry.start + entry.size, 0 });
+
+	}
+
+	for (const Fixup& fix : fixups) {
+
+		if (std::holds_alternative<Patch>(fix) && std::get<Patch>(fix).bssSize != noBSS) {
+			patchStart = std::get<Patch>(fix).ramAddress;
+			break;
+		}
+
+	}
+
+	for (const Fixup& fix : fixups) {
+
+		bool isPatch = std::holds_alternative<Patch>(fix);
+
+		if (isPatch) {
+
+			//Hooks are sorted in front of the patches, so flushing them here keeps `over` replacements winning over hooks at the same address
+			writeSections(sections, currentTarget, hookWrites, binary, log);
+
+			const Patch& patch = std::get<Patch>(fix);
+
+			std::span<const u8> data;
+			RETURN_ON_ERROR(getPatchData(images, patch, data, log))
+
+			if (patch.bssSize == noBSS) {
+
+				write(sections, currentTarget, patch.ramAddress, data, binary, log);
+
+			} else {
+
+				if (isBinary(currentTarget)) {
+
+					bool arm9 = currentTarget == arm9Target;
+					u32 heapRelocation = (arm9 ? patchSettings.arm9.start : patchSettings.arm7.start) + patch.binSize + (patch.bssAlign - patch.binSize % patch.bssAlign) + patch.bssSize;
+					u32 totalPatchSize = patch.binSize + patch.bssSize;
+					u32 kbs = totalPatchSize / 1024;
+					u32 bytes = (totalPatchSize % 1024) * 10 / 1024;
+
+					log << DINFO << "Relocating " << getCodeTargetName(currentTarget) << " heap to 0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << heapRelocation << std::dec << ", shrinking by " << kbs << "." << bytes << "KB" << std::endl;
+
+					writeWord(sections, currentTarget, arm9 ? patchSettings.arm9.reloc : patchSettings.arm7.reloc, heapRelocation, binary, log);
+					patchBinary(buildSettings, patch, data, armBinaryProperties, binary);
+
+					//The autoload data moved behind the inserted code
+					RETURN_ON_ERROR(fixBinarySections(sections, currentTarget, data.size(), log))
+
+					patchOffset = armBinaryProperties.autoloadRead;
+
+				} else {
+
+					RETURN_ON_ERROR(injectOverlay(patch, data, entry, binary, log))
+
+					//Later writes may target the injected code as well
+					sections[currentTarget] = { SectionData{ entry.start, entry.start + entry.size, 0 } };
+
+					patchOffset = patch.ramAddress - entry.start;
+
+				}
+
+			}
+
+		} else {
+
+			const Hook& hook = std::get<Hook>(fix);
+
+			u32 hookAddress = hook.hookAddress;
+			u32 funcAddress = hook.funcAddress;
+
+			bool hookThumb = hookAddress & 1;
+			bool funcThumb = funcAddress & 1;
+			hookAddress &= ~1;
+			funcAddress &= ~1;
+
+			if (!hookThumb && (hookAddress % 4) == 2) {
+				log << DWARNING << "Address 0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << " is not a valid ARM address: Did you forget to set the thumb bit?" << std::endl;
+				continue;
+			}
+
+			log << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << hookAddress << ", " << funcAddress << std::endl;
+
+			switch (hook.hookType) {
+
+				case HookType::Hook:
+				case HookType::Link: {
+
+					bool link = hook.hookType == HookType::Link;
+					bool veneer = needsVeneer(hook.hookType, hookThumb, funcThumb, isARM9Target(currentTarget));
+					u32 opcode = 0;
+					bool inRange = false;
+
+					//ARM -> Thumb hooks and interworking links on the arm7 go through a veneer, Thumb hooks are emitted as bl/blx
+					if (veneer) {
+
+						u32 veneerAddress = veneers.at({ isARM9Target(currentTarget), hook.funcAddress }).address;
+
+						if (hookThumb) {
+							inRange = encodeThumbBranch(THUMB_BL1, hookAddress, veneerAddress, opcode);
+						} else {
+							inRange = encodeARMBranch(link ? ARM_BL : ARM_B, hookAddress, veneerAddress + 4, opcode);
+						}
+
+					} else if (!hookThumb) {
+						inRange = encodeARMBranch(funcThumb ? ARM_BLX : (link ? ARM_BL : ARM_B), hookAddress, funcAddress, opcode);
+					} else {
+						inRange = encodeThumbBranch(funcThumb ? THUMB_BL1 : THUMB_BLX1, hookAddress, funcAddress, opcode);
+					}
+
+					if (!inRange) {
+						log << DERROR << "Error in hook from 0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << hook.hookAddress << " to 0x" << hook.funcAddress << ": Branch offset out of range" << std::endl;
+						return false;
+					}
+
+					hookWrites.push_back(SectionWrite{ hookAddress, opcode, 4 });
+
+					break;
+
+				}
+
+				case HookType::Safe:
+
+					if (!hookThumb) {
+
+						u32 safeOffset = safePatch.size();
+						u32 thunkSize = getSafeThunkSize(hook);
+						u32 thunkAddress = patchStart + safeOffset;
+						u32 callAddress = thunkAddress + (hook.safeFlags ? 12 : 8);
+
+						u32 hookOpcode = 0;
+						u32 callOpcode = 0;
+						u32 returnOpcode = 0;
+						bool inRange = encodeARMBranch(ARM_B, hookAddress, thunkAddress, hookOpcode) && encodeARMBranch(ARM_B, thunkAddress + thunkSize - 4, hookAddress + 4, returnOpcode);
+
+						if (needsVeneer(hook.hookType, hookThumb, funcThumb, isARM9Target(currentTarget))) {
+							inRange = inRange && encodeARMBranch(ARM_BL, callAddress, veneers.at({ isARM9Target(currentTarget), hook.funcAddress }).address + 4, callOpcode);
+						} else {
+							inRange = inRange && encodeARMBranch(funcThumb ? ARM_BLX : ARM_BL, callAddress, funcAddress, callOpcode);
+						}
+
+						if (!inRange) {
+							log << DERROR << "Error in safe hook from 0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << hook.hookAddress << " to 0x" << hook.funcAddress << ": Branch offset out of range" << std::endl;
+							return false;
+						}
+
+						u32 replaceOpcode = readWord(sections, currentTarget, hookAddress, binary, log);
+						checkSafeInstruction(replaceOpcode, log);
+
+						std::vector<u32> thunk;
+						thunk.push_back(replaceOpcode);
+						thunk.push_back(COND_AL | ARM_PUSH | 0xD0000 | hook.safeRegisters);
+
+						//Flags clobbered by the callee are kept in r4, which it has to preserve
+						if (hook.safeFlags) {
+							thunk.push_back(COND_AL | ARM_MRS | 0x4000);
+						}
+
+						thunk.push_back(callOpcode);
+
+						if (hook.safeFlags) {
+							thunk.push_back(COND_AL | ARM_MSR_F | 0x4);
+						}
+
+						thunk.push_back(COND_AL | ARM_POP | 0xD0000 | hook.safeRegisters);
+						thunk.push_back(returnOpcode);
+
+						hookWrites.push_back(SectionWrite{ hookAddress, hookOpcode, 4 });
+
+						safePatch.resize(safeOffset + thunkSize);
+						std::copy(thunk.begin(), thunk.end(), reinterpret_cast<u32*>(&safePatch[safeOffset]));
+
+					} else {
+						log << DERROR << "Fatal error: Safe hook hooked in Thumb mode" << std::endl;
+					}
+
+					break;
+
+				default:
+					break;
+
+			}
+
+		}
+
+	}
+
+	//Veneers of functions placed in this target
+	for (const auto& [key, veneer] : veneers) {
+
+		if (veneer.codeTarget != currentTarget) {
+			continue;
+		}
+
+		u32 funcAddress = key.second;
+
+		bool arm9 = isARM9Target(currentTarget);
+		u32 veneerSize = getVeneerSize(arm9);
+		u32 veneerOffset = patchOffset + (veneer.address - patchStart);
+
+		if (!patchOffset || veneerOffset + veneerSize > binary.size()) {
+			log << DERROR << "Failed to place veneer of function 0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << funcAddress << " in target " << getCodeTargetName(currentTarget) << std::endl;
+			return false;
+		}
+
+		//Thumb callers enter at bx pc, ARM callers behind it
+		u32* code = reinterpret_cast<u32*>(&binary[veneerOffset]);
+		code[0] = THUMB_NOP << 16 | THUMB_BX_R | 0x78;
+
+		if (arm9) {
+			code[1] = COND_AL | ARM_LDR_PC;
+			code[2] = funcAddress;
+		} else {
+			code[1] = COND_AL | ARM_LDR_R12;
+			code[2] = COND_AL | ARM_BX_R | 12;
+			code[3] = funcAddress;
+		}
+
+	}
+
+	//Safe thunks are placed over the start of the patch once it has been copied out of the ELF image
+	if (!safePatch.empty()) {
+
+		if (!patchOffset || patchOffset + safePatch.size() > binary.size()) {
+			log << DERROR << "Failed to place safe hook thunks of target " << getCodeTargetName(currentTarget) << std::endl;
+			return false;
+		}
+
+		std::copy(safePatch.begin(), safePatch.end(), binary.begin() + patchOffset);
+
+	}
+
+	writeSections(sections, currentTarget, hookWrites, binary, log);
+
+	if (isBinary(currentTarget)) {
+		return saveBinary(buildSettings, currentTarget, armBinaryProperties, binary, false, patchMutex, changedOutputs, log);
+	}
+
+	log << DINFO << "Saving overlay " << getCodeTargetName(currentTarget) << " to filesystem" << std::endl;
+
+	bool compress = entry.flags & OverlayEntry::compressFlag;
+
+	//The loader only decompresses overlays carrying the flag, so incompressible ones are simply stored as they are
+	if (compress && !compressOverlay(binary)) {
+		log << DINFO << "Compression of overlay " << getCodeTargetName(currentTarget) << " non-effective, storing it uncompressed" << std::endl;
+		entry.flags &= ~OverlayEntry::compressFlag;
+	}
+
+	return saveOverlay(buildSettings, currentTarget, binary, entry, changedOutputs, log);
+
+}
+
+
+
+
+bool assignVeneers(const std::vector<Fixup>& fixups, VeneerMap& veneers) {
+
+	std::unordered_map<CodeTarget, u32> poolUsage;
+
+	for (const Fixup& fix : fixups) {
+
+		if (!std::holds_alternative<Hook>(fix)) {
+			continue;
+		}
+
+		const Hook& hook = std::get<Hook>(fix);
+		bool arm9 = isARM9Target(hook.codeTarget);
+
+		if (!needsVeneer(hook.hookType, hook.hookAddress & 1, hook.funcAddress & 1, arm9) || veneers.contains({ arm9, hook.funcAddress })) {
+			continue;
+		}
+
+		//The veneer goes into the pool of the patch holding the function
+		auto it = std::find_if(fixups.begin(), fixups.end(), [&hook, arm9](const Fixup& f) {
+
+			if (!std::holds_alternative<Patch>(f)) {
+				return false;
+			}
+
+			const Patch& patch = std::get<Patch>(f);
+			u32 funcAddress = hook.funcAddress & ~1;
+
+			return patch.bssSize != noBSS && isARM9Target(patch.codeTarget) == arm9 && funcAddress >= patch.ramAddress && funcAddress < patch.ramAddress + patch.binSize;
+
+		});
+
+		if (it == fixups.end()) {
+			std::cout << DERROR << "Failed to find code of hook function 0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << hook.funcAddress << std::endl;
+			return false;
+		}
+
+		const Patch& patch = std::get<Patch>(*it);
+		u32 veneerAddress = patch.veneerStart + poolUsage[patch.codeTarget];
+
+		if (!patch.veneerStart || veneerAddress + getVeneerSize(arm9) > patch.veneerEnd) {
+			std::cout << DERROR << "Veneer pool of target " << getCodeTargetName(patch.codeTarget) << " exhausted by hook at 0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << hook.hookAddress << std::endl;
+			return false;
+		}
+
+		poolUsage[patch.codeTarget] += getVeneerSize(arm9);
+		veneers[{ arm9, hook.funcAddress }] = Veneer{ patch.codeTarget, veneerAddress };
+
+	}
+
+	return true;
+
+}
+
+
+
+bool needsVeneer(HookType hookType, bool hookThumb, bool funcThumb, bool arm9) {
+
+	switch (hookType) {
+
+		//b cannot switch the instruction set, Thumb -> ARM is done with blx on the arm9
+		case HookType::Hook:
+			return (!hookThumb && funcThumb) || (hookThumb && !funcThumb && !arm9);
+
+		//armv4 has no blx (immediate)
+		case HookType::Link:
+		case HookType::Safe:
+			return hookThumb != funcThumb && !arm9;
+
+		default:
+			return false;
+
+	}
+
+}
+
+
+
+u32 getVeneerSize(bool arm9) {
+	return arm9 ? 12 : 16;
+}
+
+
+
+bool encodeARMBranch(u32 opcode, u32 source, u32 destination, u32& encoded) {
+
+	s64 offset = static_cast<s64>(destination) - source - 8;
+
+	if (offset < -0x2000000 || offset > 0x1FFFFFC) {
+		return false;
+	}
+
+	encoded = COND_AL | opcode | ((offset >> 2) & 0xFFFFFF);
+
+	//blx encodes halfword aligned Thumb destinations in H
+	if (opcode == ARM_BLX) {
+		encoded |= (offset & 2) << 23;
+	}
+
+	return true;
+
+}
+
+
+
+bool encodeThumbBranch(u16 suffix, u32 source, u32 destination, u32& encoded) {
+
+	//blx is relative to the word aligned pc
+	u32 base = suffix == THUMB_BLX1 ? (source + 4) & ~3 : source + 4;
+	s64 offset = static_cast<s64>(destination) - base;
+
+	if (offset < -0x400000 || offset > 0x3FFFFE) {
+		return false;
+	}
+
+	u16 opcode0 = THUMB_BL0 | ((offset >> 12) & 0x7FF);
+	u16 opcode1 = suffix | ((offset >> 1) & 0x7FF);
+	encoded = static_cast<u32>(opcode1 << 16 | opcode0);
+
+	return true;
+
+}
+
+
+
+bool generateFileIDs(const BuildSettings& settings, const DependencyTracker& tracker, const OverlayTable& ovt, const FileIDSymbols& fidSymbols) {
+
+	const fs::path& fidPath = settings.toolchainDir / "internal" / "fid.h";
+
+	if (!jsonChanged(tracker)) {
+		return true;
+	}
+
+	std::cout << DINFO << "Generating file ID symbols" << std::endl;
+
+	const std::string& fntFilename = "fnt.bin";
+
+	const fs::path& fntPath = settings.nitroFSDir / fntFilename;
+	u32 fntSize = fs::file_size(fntPath);
+	std::vector<u8> fnt;
+
+	std::ifstream fntFile(fntPath, std::ios::in | std::ios::binary);
+
+	if (!fntFile.is_open()) {
+		std::cout << DERROR << "Failed to open filename table " << fntPath.string() << std::endl;
+		return false;
+	}
+
+	fnt.resize(fntSize);
+	fntFile.read(reinterpret_cast<char*>(fnt.data()), fntSize);
+	fntFile.close();
+
+	u16 freeOverlayFileID = 0;
+
+	for (const auto& e : ovt) {
+		freeOverlayFileID = std::max(static_cast<u32>(freeOverlayFileID), e.second.fileID + 1);
+	}
+
+	NDSDirectory rootDir = NFSFSH::readFntTree(fnt);
+	u16 freeFileID = std::max(freeOverlayFileID, NFSFSH::findNextFreeFileID(rootDir));
+	u16 freeDirID = NFSFSH::findNextFreeDirID(rootDir);
+
+	NFSFSH::addNewFiles(rootDir, settings.nitroFSDir / "root", freeFileID, freeDirID);
+
+	std::map<std::string, u16> fids;
+
+	for (const auto& e : fidSymbols) {
+
+		const std::string& symbol = e.first;
+		const fs::path& filePath = e.second;
+
+		fids[symbol] = NFSFSH::getFileID(rootDir, fs::relative(filePath, settings.nitroFSDir / "root"));
+
+	}
+
+	std::stringstream fidStream;
+
+	fidStream << "#ifndef FID_H\n#define FID_H\n\n";
+	fidStream << "/* Auto-generated File ID symbols */\n";
+	fidStream << "#ifndef __FFC_LANG_ASM\n\n";
+	fidStream << "\tnamespace FID {\n\n";
+
+	for (const auto& e : fids) {
+		fidStream << "\t\tconstexpr unsigned short " << e.first << " = " << e.second << ";\n";
+	}
+
+	fidStream << "\n\t};\n";
+	fidStream << "\n#endif\n";
+	fidStream << "\n#endif  // FID_H";
+
+	//fid.h is force-included by every unit, so rewriting identical contents would trigger a full rebuild
+	return writeFileIfChanged(fidPath, fidStream.str(), "FID");
+
+}
+
+
+
+bool writeFileIfChanged(const fs::path& p, const std::string& content, const std::string& name) {
+
+	if (fs::exists(p) && fs::is_regular_file(p)) {
+
+		std::ifstream oldFile(p, std::ios::in);
+		std::stringstream oldStream;
+		oldStream << oldFile.rdbuf();
+		oldFile.close();
+
+		if (oldStream.str() == content) {
+			return true;
+		}
+
+	}
+
+	std::ofstream file(p, std::ios::out | std::ios::trunc);
+
+	if (!file.is_open()) {
+		std::cout << DERROR << "Failed to open " << name << " file " << p.string() << std::endl;
+		return false;
+	}
+
+	file << content;
+	file.close();
+
+	return true;
+
+}
+
+
+
+bool writeOutputFile(const fs::path& p, std::span<const u8> data, const std::string& name, std::vector<fs::path>& changedOutputs) {
+
+	std::error_code ec;
+
+	//Identical outputs keep their modification time so that nds-build and other tools do not pick them up
+	if (fs::is_regular_file(p, ec) && fs::file_size(p, ec) == data.size()) {
+
+		std::ifstream oldFile(p, std::ios::in | std::ios::binary);
+		std::vector<u8> oldData(data.size());
+
+		if (oldFile.read(reinterpret_cast<char*>(oldData.data()), oldData.size()) && std::equal(oldData.begin(), oldData.end(), data.begin())) {
+			return true;
+		}
+
+	}
+
+	fs::path tempPath = p;
+	tempPath += "." + std::to_string(std::random_device()()) + ".tmp";
+
+	std::ofstream file(tempPath, std::ios::out | std::ios::binary | std::ios::trunc);
+
+	if (!file.is_open()) {
+		std::cout << DERROR << "Failed to open " << name << " file " << tempPath.string() << std::endl;
+		return false;
+	}
+
+	file.write(reinterpret_cast<const char*>(data.data()), data.size());
+	file.close();
+
+	//Renaming never leaves a partially written output behind
+	if (file) {
+		fs::rename(tempPath, p, ec);
+	}
+
+	if (!file || ec) {
+		std::cout << DERROR << "Failed to write " << name << " file " << p.string() << (ec ? ": " + ec.message() : "") << std::endl;
+		fs::remove(tempPath, ec);
+		return false;
+	}
+
+	changedOutputs.push_back(p);
+
+	return true;
+
+}
+
+
+
+
+void write(const SectionMap& sections, CodeTarget target, u32 address, std::span<const u8> data, std::vector<u8>& binary, std::ostream& log) {
+
+	u32 offset = 0;
+
+	if (!getSectionAddressOffset(sections, target, address, data.size(), offset, log)) {
+		reportSectionMiss(sections, target, address, data.size(), log);
+		return;
+	}
+
+	std::copy(data.begin(), data.end(), binary.begin() + offset);
+
+}
+
+
+
+void writeHalfword(const SectionMap& sections, CodeTarget target, u32 address, u16 value, std::vector<u8>& binary, std::ostream& log) {
+
+	u32 offset = 0;
+
+	if (!getSectionAddressOffset(sections, target, address, 2, offset, log)) {
+		reportSectionMiss(sections, target, address, 2, log);
+		return;
+	}
+
+	*reinterpret_cast<u16*>(&binary[offset]) = value;
+
+}
+
+
+
+void writeWord(const SectionMap& sections, CodeTarget target, u32 address, u32 value, std::vector<u8>& binary, std::ostream& log) {
+
+	u32 offset = 0;
+
+	if (!getSectionAddressOffset(sections, target, address, 4, offset, log)) {
+		reportSectionMiss(sections, target, address, 4, log);
+		return;
+	}
+
+	*reinterpret_cast<u32*>(&binary[offset]) = value;
+
+}
+
+
+
+u32 readWord(const SectionMap& sections, CodeTarget target, u32 address, std::vector<u8>& binary, std::ostream& log) {
+
+	u32 offset = 0;
+
+	if (!getSectionAddressOffset(sections, target, address, 4, offset, log)) {
+		reportSectionMiss(sections, target, address, 4, log);
+		return 0;
+	}
+
+	return *reinterpret_cast<u32*>(&binary[offset]);
+
+}
+
+
+
+void writeSections(const SectionMap& sections, CodeTarget target, std::vector<SectionWrite>& writes, std::vector<u8>& binary, std::ostream& log) {
+
+	if (writes.empty()) {
+		return;
+	}
+
+	auto targetIt = sections.find(target);
+
+	if (targetIt == sections.end()) {
+		log << DWARNING << "Section " << getCodeTargetName(target) << " neither represents a valid binary nor an overlay" << std::endl;
+		writes.clear();
+		return;
+	}
+
+	const std::vector<SectionData>& targetSections = targetIt->second;
+
+	//Later writes to the same address still win since the order of equal addresses is kept
+	std::stable_sort(writes.begin(), writes.end(), [](const SectionWrite& a, const SectionWrite& b) {
+		return a.address < b.address;
+	});
+
+	//Sections of a target never overlap, so walking both sorted lists resolves every address in one pass
+	u32 i = 0;
+
+	for (const SectionWrite& sectionWrite : writes) {
+
+		while (i < targetSections.size() && targetSections[i].end <= sectionWrite.address) {
+			i++;
+		}
+
+		if (i == targetSections.size() || sectionWrite.address < targetSections[i].start || sectionWrite.address + sectionWrite.size > targetSections[i].end) {
+			reportSectionMiss(sections, target, sectionWrite.address, sectionWrite.size, log);
+			continue;
+		}
+
+		u32 offset = sectionWrite.address - targetSections[i].start + targetSections[i].destination;
+
+		if (sectionWrite.size == 2) {
+			*reinterpret_cast<u16*>(&binary[offset]) = sectionWrite.value;
+		} else {
+			*reinterpret_cast<u32*>(&binary[offset]) = sectionWrite.value;
+		}
+
+	}
+
+	writes.clear();
+
+}
+
+
+
+bool fixBinarySections(SectionMap& sections, CodeTarget target, u32 offset, std::ostream& log) {
+
+	if (!isBinary(target)) {
+		log << DERROR << "Target " << getCodeTargetName(target) << " does not represent a valid ARM binary target" << std::endl;
+		return false;
+	}
+
+	for (SectionData& section : sections[target]) {
+
+		if (section.destination) {
+			section.destination += offset;
+		}
+
+	}
+
+	return true;
+
+}
+
+
+
+
+bool addBinarySections(SectionMap& sections, CodeTarget target, const ARMBinaryProperties& properties, const std::vector<u8>& binary, std::ostream& log) {
+
+	if (!isBinary(target)) {
+		log << DERROR << "Target " << getCodeTargetName(target) << " does not represent a valid ARM binary target" << std::endl;
+		return false;
+	}
+
+	addSection(sections, target, SectionData{ properties.offset, properties.offset + properties.autoloadRead, 0 });
+	u32 readPtr = properties.autoloadRead;
+
+	for (u32 i = 0; i < (properties.autoloadEnd - properties.autoloadStart) / 12; i++) {
+
+		u32 start = *reinterpret_cast<const u32*>(&binary[properties.autoloadStart + i * 12]);
+		u32 size = *reinterpret_cast<const u32*>(&binary[properties.autoloadStart + i * 12 + 4]);
+
+		addSection(sections, target, SectionData{ start, start + size, readPtr });
+		readPtr += size;
+
+	}
+
+	return true;
+
+}
+
+
+
+
+bool loadBinary(const BuildSettings& settings, CodeTarget target, ARMBinaryProperties& properties, std::vector<u8>& binary, std::ostream& log) {
+
+	if (!isBinary(target)) {
+		log << DERROR << "Target " << getCodeTargetName(target) << " does not represent a valid ARM binary target" << std::endl;
+		return false;
+	}
+
+	fs::path armPath = settings.backupDir / (getCodeTargetName(target) + ".bin");
+
+	RETURN_ON_ERROR(loadBackupFile(armPath, binary))
+	RETURN_ON_ERROR(loadARMBinaryProperties(settings, target, binary, properties))
+
+	return true;
+
+}
+
+
+
+
+void patchBinary(const BuildSettings& settings, const Patch& patchInfo, std::span<const u8> patch, const ARMBinaryProperties& properties, std::vector<u8>& binary) {
+
+	u32 patchSize = patch.size();
+	binary.resize(binary.size() + patchInfo.binSize + 12);
+
+	std::copy(binary.begin() + properties.autoloadStart, binary.begin() + properties.autoloadEnd, binary.begin() + properties.autoloadStart + patchSize + 12);
+	std::copy(binary.begin() + properties.autoloadRead, binary.begin() + properties.autoloadStart, binary.begin() + properties.autoloadRead + patch.size());
+	std::copy(patch.begin(), patch.end(), binary.begin() + properties.autoloadRead);
+
+	*reinterpret_cast<u32*>(&binary[properties.autoloadStart + patchSize]) = patchInfo.ramAddress;
+	*reinterpret_cast<u32*>(&binary[properties.autoloadStart + patchSize + 4]) = patchInfo.binSize;
+	*reinterpret_cast<u32*>(&binary[properties.autoloadStart + patchSize + 8]) = patchInfo.bssSize;
+
+	*reinterpret_cast<u32*>(&binary[properties.moduleParams]) = properties.offset + properties.autoloadStart + patchSize;
+	*reinterpret_cast<u32*>(&binary[properties.moduleParams + 4]) = properties.offset + properties.autoloadEnd + patchSize + 12;
+
+}
+
+
+
+
+bool injectOverlay(const Patch& patchInfo, std::span<const u8> patch, OverlayEntry& entry, std::vector<u8>& binary, std::ostream& log) {
+
+	u32 codeOffset = patchInfo.ramAddress - entry.start;
+	u32 bssAlign = std::max(patchInfo.bssAlign, 1u);
+	u32 bssOffset = (codeOffset + patchInfo.binSize + bssAlign - 1) / bssAlign * bssAlign;
+
+	if (binary.size() > codeOffset) {
+		log << DERROR << "Cannot inject code into " << getCodeTargetName(patchInfo.codeTarget) << ": Overlay file is larger than its table entry" << std::endl;
+		return false;
+	}
+
+	log << DINFO << "Injecting 0x" << std::uppercase << std::hex << patchInfo.binSize << " bytes of code and 0x" << patchInfo.bssSize << " bytes of BSS into " << getCodeTargetName(patchInfo.codeTarget) << std::endl;
+
+	//The original BSS turns into zero-initialized data in front of the injected code
+	binary.resize(codeOffset);
+	binary.insert(binary.end(), patch.begin(), patch.end());
+	binary.resize(bssOffset);
+
+	//The linker reserved room for the original static initializers in front of the injected ones
+	if (patchInfo.initEnd != patchInfo.initStart) {
+
+		if (entry.initEnd != entry.initStart) {
+			std::copy(binary.begin() + (entry.initStart - entry.start), binary.begin() + (entry.initEnd - entry.start), binary.begin() + (patchInfo.initStart - entry.start));
+		}
+
+		entry.initStart = patchInfo.initStart;
+		entry.initEnd = patchInfo.initEnd;
+
+	}
+
+	entry.size = bssOffset;
+	entry.bss = patchInfo.bssSize;
+
+	return true;
+
+}
+
+
+
+
+bool saveBinary(const BuildSettings& settings, CodeTarget target, const ARMBinaryProperties& properties, std::vector<u8>& binary, bool compress, std::mutex& patchMutex, std::vector<fs::path>& changedOutputs, std::ostream& log) {
+
+	if (!isBinary(target)) {
+		log << DERROR << "Target " << getCodeTargetName(target) << " does not represent a valid ARM binary target" << std::endl;
+		return false;
+	}
+
+	fs::path armPath = settings.nitroFSDir / (getCodeTargetName(target) + ".bin");
+	u32 finalSize = binary.size();
+	u32 compressStart = binary.size();
+
+	if (compress) {
+
+		log << DINFO << "Recompressing ARM binary file " << armPath.string() << std::endl;
+
+		u32 blockSize = target == arm9Target ? 0x4000 : 0x400;
+		u32 nextCompressableBlock = ((properties.offset + blockSize - 1) / blockSize) * blockSize;
+
+		if (nextCompressableBlock - properties.offset < (blockSize / 4)) {
+			nextCompressableBlock += blockSize;
+		}
+
+		nextCompressableBlock -= properties.offset;
+
+		if (nextCompressableBlock > binary.size()) {
+			log << DERROR << "Cannot compress " << getCodeTargetName(target) << ".bin: Requested offset exceeds " << getCodeTargetName(target) << ".bin size" << std::endl;
+			return false;
+		}
+
+		compressStart = nextCompressableBlock;
+
+	}
+
+	if (compress) {
+
+		std::vector<u8> armc(binary.begin() + compressStart, binary.end());
+		BLZ::compress(armc);
+
+		finalSize = compressStart + armc.size();
+
+		if (finalSize <= binary.size()) {
+			std::copy(armc.begin(), armc.end(), binary.begin() + compressStart);
+			*reinterpret_cast<u32*>(&binary[properties.moduleParams + 0x14]) = finalSize + properties.offset;
+		}
+
+	}
+
+	if (finalSize > binary.size()) {
+		log << DERROR << "Cannot BLZ compress " << getCodeTargetName(target) << ".bin: Compression non-effective" << std::endl;
+		return false;
+	}
+
+	RETURN_ON_ERROR(writeOutputFile(armPath, std::span<const u8>(binary.data(), finalSize), getCodeTargetName(target), changedOutputs))
+
+	//The header is shared by both binaries, which are saved concurrently
+	std::lock_guard<std::mutex> headerLock(patchMutex);
+
+	fs::path headerPath = settings.nitroFSDir / "header.bin";
+
+	if (!fs::exists(headerPath) || !fs::is_regular_file(headerPath)) {
+		log << DERROR << "Fatal error: header.bin not found" << std::endl;
+		return false;
+	}
+
+	std::ifstream headerFile(headerPath, std::ios::in | std::ios::binary);
+
+	if (!headerFile.is_open()) {
+		log << DERROR << "Failed to open header.bin" << std::endl;
+		return false;
+	}
+
+	std::vector<u8> header(fs::file_size(headerPath));
+	headerFile.read(reinterpret_cast<char*>(header.data()), header.size());
+	headerFile.close();
+
+	if (header.size() < 0x40) {
+		log << DERROR << "Invalid ROM header file " << headerPath.string() << std::endl;
+		return false;
+	}
+
+	*reinterpret_cast<u32*>(&header[0x2C + (target != arm9Target) * 0x10]) = finalSize;
+
+	return writeOutputFile(headerPath, header, "ROM header", changedOutputs);
+
+}
+
+
+
+bool loadOverlay(const BuildSettings& settings, CodeTarget target, std::vector<u8>& binary, std::ostream& log) {
+
+	if (!isOverlay(target)) {
+		log << DERROR << "Target " << getCodeTargetName(target) << " does not represent a valid overlay target" << std::endl;
+		return false;
+	}
+
+	u32 ovID = getOverlayID(target);
+
+	const std::string& ovPrefix = "overlay" + getProcessorID(target);
+	const fs::path& overlayDir = settings.backupDir / ovPrefix;
+	const std::string& overlayFilename = ovPrefix + "_" + std::to_string(ovID) + ".bin";
+	const fs::path& overlayPath = overlayDir / overlayFilename;
+
+	RETURN_ON_ERROR(loadBackupFile(overlayPath, binary))
+
+	return true;
+
+}
+
+
+
+bool saveOverlay(const BuildSettings& settings, CodeTarget target, std::vector<u8>& binary, OverlayEntry& entry, std::vector<fs::path>& changedOutputs, std::ostream& log) {
+
+	if (!isOverlay(target)) {
+		log << DERROR << "Target " << getCodeTargetName(target) << " does not represent a valid overlay target" << std::endl;
+		return false;
+	}
+
+	u32 ovID = getOverlayID(target);
+	std::string ovPrefix = "overlay" + getProcessorID(target);
+	fs::path overlayPath = settings.nitroFSDir / ovPrefix / (ovPrefix + "_" + std::to_string(ovID) + ".bin");
+
+	RETURN_ON_ERROR(writeOutputFile(overlayPath, binary, "overlay", changedOutputs))
+
+	entry.flags = binary.size() | (entry.flags & 0xFF000000);
+
+	return true;
+
+}
+
+
+
+bool compressOverlay(std::vector<u8>& binary) {
+
+	std::vector<u8> compressed = binary;
+	BLZ::compress(compressed);
+
+	if (compressed.size() >= binary.size()) {
+		return false;
+	}
+
+	binary.swap(compressed);
+
+	return true;
+
+}
+
+
+
+bool loadOverlayTable(const BuildSettings& settings, OverlayTable& ovt) {
+
+	for (u32 a = 0; a < 2; a++) {
+
+		const fs::path& ovtPath = settings.backupDir / (a ? "arm9ovt.bin" : "arm7ovt.bin");
+		u32 ovtSize = fs::file_size(ovtPath);
+
+		std::ifstream ovtFile(ovtPath, std::ios::in | std::ios::binary);
+
+		if (!ovtFile.is_open()) {
+			std::cout << DERROR << "Failed to open overlay table file " << ovtPath.string() << std::endl;
+			return false;
+		}
+
+		u32 overlays = ovtSize / 32;
+		OverlayEntry entry{};
+
+		for (u32 i = 0; i < overlays; i++) {
+
+			ovtFile.read(reinterpret_cast<char*>(&entry), 32);
+			ovt[a ? ov9Target(entry.ovID) : ov7Target(entry.ovID)] = entry;
+
+		}
+
+		ovtFile.close();
+
+	}
+
+	return true;
+
+}
+
+
+
+bool saveOverlayTable(const BuildSettings& settings, const OverlayTable& ovt, std::vector<fs::path>& changedOutputs) {
+
+	auto ovtIter = ovt.begin();
+
+	for (u32 a = 0; a < 2; a++) {
+
+		const fs::path& ovtPath = settings.nitroFSDir / (a ? "arm9ovt.bin" : "arm7ovt.bin");
+		std::vector<u8> ovtData;
+
+		for (auto& it = ovtIter; it != ovt.end(); it++) {
+
+			if (!a && isARM9Target(it->first)) {
+				break;
+			}
+
+			const u8* entry = reinterpret_cast<const u8*>(&it->second);
+			ovtData.insert(ovtData.end(), entry, entry + 32);
+
+		}
+
+		RETURN_ON_ERROR(writeOutputFile(ovtPath, ovtData, "overlay table", changedOutputs))
+
+	}
+
+	return true;
+
+}
+
+
+
+
+bool backupNitroFSFile(const BuildSettings& settings, const std::string& path) {
+
+	fs::path filePath = settings.nitroFSDir / path;
+	fs::path fileBackup = settings.backupDir / path;
+
+	if (!fs::exists(fileBackup) || !fs::is_regular_file(fileBackup)) {
+
+		if (!fs::exists(filePath) || !fs::is_regular_file(filePath)) {
+			std::cout << DERROR << "Failed to find NitroFS file " << filePath.string() << std::endl;
+			return false;
+		}
+
+		bool copied = false;
+
+		try {
+
+			copied = fs::copy_file(filePath, fileBackup);
+
+		} catch (fs::filesystem_error& e) {
+
+			std::cout << DERROR << "Failed to copy NitroFS file " << filePath.string() << " to backup directory: " << e.what() << std::endl;
+			return false;
+
+		}
+
+		if (!copied) {
+			std::cout << DERROR << "Failed to copy NitroFS file " << filePath.string() << " to backup directory" << std::endl;
+			return false;
+		}
+
+	}
+
+	return true;
+
+}
+
+
+
+bool backupFiles(const BuildSettings& settings, OverlayTable& ovt) {
+
+	const fs::path& nobackupPath = settings.backupDir / ".nobackup";
+
+	if (fs::exists(nobackupPath) && fs::is_regular_file(nobackupPath)) {
+		RETURN_ON_ERROR(loadOverlayTable(settings, ovt))
+		return true;
+	}
+
+	std::cout << DINFO << "Backing up NitroFS files" << std::endl;
+
+	const fs::path& backup9Path = settings.backupDir / "overlay9";
+	const fs::path& backup7Path = settings.backupDir / "overlay7";
+	const fs::path& backup9cPath = settings.backupDir / "overlay9c";
+	const fs::path& backup7cPath = settings.backupDir / "overlay7c";
+
+	std::cout << DINFO << "Backing up ROM header" << std::endl;
+	RETURN_ON_ERROR(backupNitroFSFile(settings, "header.bin"))
+
+	std::cout << DINFO << "Backing up overlay tables" << std::endl;
+	RETURN_ON_ERROR(backupNitroFSFile(settings, "arm7ovt.bin"))
+	RETURN_ON_ERROR(backupNitroFSFile(settings, "arm9ovt.bin"))
+	RETURN_ON_ERROR(loadOverlayTable(settings, ovt))
+
+	RETURN_ON_ERROR(createDirectory(backup9Path, "overlay"))
+	RETURN_ON_ERROR(createDirectory(backup7Path, "overlay"))
+	RETURN_ON_ERROR(createDirectory(backup9cPath, "compressed overlay"))
+	RETURN_ON_ERROR(createDirectory(backup7cPath, "compressed overlay"))
+
+	std::cout << DINFO << "Backing up ARM binaries" << std::endl;
+
+	for (u32 a = 0; a < 2; a++) {
+
+		CodeTarget target = a ? arm9Target : arm7Target;
+		const std::string& armFilename = getCodeTargetName(target) + ".bin";
+
+		RETURN_ON_ERROR(backupNitroFSFile(settings, armFilename))
+
+		fs::path armPath = settings.backupDir / armFilename;
+		u32 armSize = fs::file_size(armPath);
+
+		std::ifstream armFile(armPath, std::ios::in | std::ios::binary);
+
+		if (!armFile.is_open()) {
+			std::cout << DERROR << "Failed to open ARM binary file " << armPath.string() << std::endl;
+			return false;
+		}
+
+		std::vector<u8> binary;
+		binary.resize(armSize);
+		armFile.read(reinterpret_cast<char*>(binary.data()), armSize);
+		armFile.close();
+
+		ARMBinaryProperties properties{};
+		RETURN_ON_ERROR(loadARMBinaryProperties(settings, target, binary, properties))
+
+		if (properties.compressedEnd) {
+
+			const std::string& armcBinary = getCodeTargetName(target) + "c.bin";
+			fs::path armcPath = settings.backupDir / armcBinary;
+
+			try {
+				fs::rename(armPath, armcPath);
+			} catch (fs::filesystem_error& e) {
+				std::cout << DERROR << "Failed to move ARM binary " << armPath.string() << ": " << e.what() << std::endl;
+				return false;
+			}
+
+			BLZ::decompress(binary);
+			*reinterpret_cast<u32*>(&binary[properties.moduleParams + 0x14]) = 0;
+			properties.compressedEnd = 0;
+
+			std::ofstream armdFile(armPath, std::ios::out | std::ios::binary | std::ios::trunc);
+
+			if (!armdFile.is_open()) {
+				std::cout << DERROR << "Failed to open decompressed ARM binary file " << armPath.string() << std::endl;
+				return false;
+			}
+
+			armdFile.write(reinterpret_cast<const char*>(binary.data()), binary.size());
+			armdFile.close();
+
+		}
+
+	}
+
+	std::cout << DINFO << "Backing up overlays" << std::endl;
+
+	for (const auto& e : ovt) {
+
+		u32 ovID = e.second.ovID;
+		const std::string procID = getProcessorID(e.first);
+		const std::string& overlaySubpath = "overlay" + procID + "_" + std::to_string(ovID) + ".bin";
+
+		RETURN_ON_ERROR(backupNitroFSFile(settings, "overlay" + procID + "/" + overlaySubpath))
+
+		if (e.second.flags & OverlayEntry::compressFlag) {
+
+			fs::path overlayPath = (procID == "9" ? backup9Path : backup7Path) / overlaySubpath;
+			fs::path overlaycPath = (procID == "9" ? backup9cPath : backup7cPath) / overlaySubpath;
+
+			try {
+				fs::rename(overlayPath, overlaycPath);
+			} catch (fs::filesystem_error& e) {
+				std::cout << DERROR << "Failed to move overlay " << overlayPath.string() << ": " << e.what() << std::endl;
+				return false;
+			}
+
+			std::ifstream overlaycFile(overlaycPath, std::ios::in | std::ios::binary);
+
+			if (!overlaycFile.is_open()) {
+				std::cout << DERROR << "Failed to open compressed overlay file " << overlaycPath.string() << std::endl;
+				return false;
+			}
+
+			std::vector<u8> binary;
+			binary.resize(fs::file_size(overlaycPath));
+			overlaycFile.read(reinterpret_cast<char*>(binary.data()), binary.size());
+
+			BLZ::decompress(binary);
+
+			std::ofstream overlaydFile(overlayPath, std::ios::out | std::ios::binary | std::ios::trunc);
+
+			if (!overlaydFile.is_open()) {
+				std::cout << DERROR << "Failed to open decompressed overlay file " << overlayPath.string() << std::endl;
+				return false;
+			}
+
+			overlaydFile.write(reinterpret_cast<const char*>(binary.data()), binary.size());
+			overlaydFile.close();
+
+		}
+
+	}
+
+	std::ofstream nobackupFile(nobackupPath);
+
+	if (!nobackupFile.is_open()) {
+		std::cout << DERROR << "Fatal error: Failed to secure backup state" << std::endl;
+		return false;
+	}
+
+	nobackupFile.close();
+
+	return true;
+
+}
+
+
+bool loadBackupFile(const fs::path& p, std::vector<u8>& data) {
+
+	const std::string& key = getPathString(p);
+
+	//Backups never change while their configuration is loaded, so repeated builds can share them
+	if (backupFileCache.contains(key)) {
+		data = backupFileCache.at(key);
+		return true;
+	}
+
+	std::ifstream file(p, std::ios::in | std::ios::binary);
+
+	if (!file.is_open()) {
+		std::cout << DERROR << "Failed to open backup file " << p.string() << std::endl;
+		return false;
+	}
+
+	data.resize(fs::file_size(p));
+	file.read(reinterpret_cast<char*>(data.data()), data.size());
+	file.close();
+
+	backupFileCache[key] = data;
+
+	return true;
+
+}
+
+
+
+bool loadROMHeader(const BuildSettings& settings, std::vector<u8>& header) {
+
+	fs::path headerPath = settings.backupDir / "header.bin";
+	u32 headerSize = fs::file_size(headerPath);
+
+	if (headerSize < 256) {
+		std::cout << DERROR << "Invalid ROM header file " << headerPath.string() << ": Expected a minimum of 256 bytes, got " << headerSize << " bytes" << std::endl;
+		return false;
+	}
+
+	std::ifstream headerFile(headerPath, std::ios::in | std::ios::binary);
+
+	if (!headerFile.is_open()) {
+		std::cout << DERROR << "Failed to open ROM header file " << headerPath.string() << std::endl;
+		return false;
+	}
+
+	header.resize(256);
+	headerFile.read(reinterpret_cast<char*>(header.data()), 256);
+	headerFile.close();
+
+	return true;
+
+}
+
+
+
+
+bool getPatchData(const LinkedImages& images, const Patch& patch, std::span<const u8>& data, std::ostream& log) {
+
+	bool arm9 = isARM9Target(patch.codeTarget);
+	std::span<const u8> linked = images.getLinkedData(arm9);
+
+	if (linked.empty()) {
+		log << DERROR << "Failed to find linked " << (arm9 ? "arm9" : "arm7") << " code for patch target " << getCodeTargetName(patch.codeTarget) << std::endl;
+		return false;
+	}
+
+	if (static_cast<u64>(patch.binOffset) + patch.binSize > linked.size()) {
+		log << DERROR << "Patch section out of bounds: Filesize=0x" << std::uppercase << std::hex << linked.size() << ", offset=0x" << patch.binOffset << ", size=0x" << patch.binSize << std::endl;
+		return false;
+	}
+
+	data = linked.subspan(patch.binOffset, patch.binSize);
+
+	return true;
+
+}
+
+
+
+
+bool getSectionAddressOffset(const SectionMap& sections, CodeTarget target, u32 address, u32 size, u32& offset, std::ostream& log) {
+
+	auto targetIt = sections.find(target);
+
+	if (targetIt == sections.end()) {
+		log << DWARNING << "Section " << getCodeTargetName(target) << " neither represents a valid binary nor an overlay" << std::endl;
+		return false;
+	}
+
+	const std::vector<SectionData>& targetSections = targetIt->second;
+
+	//The only candidate is the last section starting at or before the address
+	auto it = std::upper_bound(targetSections.begin(), targetSections.end(), address, [](u32 a, const SectionData& section) {
+		return a < section.start;
+	});
+
+	if (it == targetSections.begin()) {
+		return false;
+	}
+
+	const SectionData& sdat = *std::prev(it);
+
+	if ((address + size) > sdat.end) {
+		return false;
+	}
+
+	offset = address - sdat.start + sdat.destination;
+
+	return true;
+
+}
+
+
+
+void reportSectionMiss(const SectionMap& sections, CodeTarget target, u32 address, u32 size, std::ostream& log) {
+
+	log << DWARNING << "Address 0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << address << " not in section " << getCodeTargetName(target);
+
+	auto targetIt = sections.find(target);
+
+	if (targetIt == sections.end() || targetIt->second.empty()) {
+		log << std::endl;
+		return;
+	}
+
+	const std::vector<SectionData>& targetSections = targetIt->second;
+
+	auto it = std::upper_bound(targetSections.begin(), targetSections.end(), address, [](u32 a, const SectionData& section) {
+		return a < section.start;
+	});
+
+	//Picks whichever neighbour is closer, a section the access only overflows counts as distance 0
+	const SectionData* nearest = nullptr;
+	u32 distance = 0xFFFFFFFF;
+
+	if (it != targetSections.end()) {
+		nearest = &*it;
+		distance = it->start - address;
+	}
+
+	if (it != targetSections.begin()) {
+
+		const SectionData& previous = *std::prev(it);
+		u32 previousDistance = address >= previous.end ? address - previous.end : 0;
+
+		if (previousDistance <= distance) {
+			nearest = &previous;
+		}
+
+	}
+
+	log << ", nearest section spans 0x" << std::setw(8) << nearest->start << "-0x" << std::setw(8) << nearest->end;
+
+	if (address < nearest->end && address + size > nearest->end) {
+		log << " (access of " << std::dec << size << " bytes overflows its end)";
+	}
+
+	log << std::endl;
+
+}
+
+
+
+void addSection(SectionMap& sections, CodeTarget target, const SectionData& section) {
+
+	std::vector<SectionData>& targetSections = sections[target];
+
+	auto it = std::upper_bound(targetSections.begin(), targetSections.end(), section.start, [](u32 start, const SectionData& s) {
+		return start < s.start;
+	});
+
+	targetSections.insert(it, section);
+
+}
+
+
+
+
+void checkSafeInstruction(u32 opcode, std::ostream& log) {
+
+	u32 condition = (opcode & 0xF0000000) >> 28;
+	u32 code2 = (opcode & 0x0E000000) >> 25;
+
+	if (condition != 0xF) {
+
+		bool bit4 = (opcode & 0x10) >> 4;
+		bool bit7 = (opcode & 0x80) >> 7;
+		u32 ext47 = (opcode & 0xF0) >> 4;
+		bool sbit = (opcode & 0x100000) >> 20;
+		u32 code3 = (opcode & 0x1E00000) >> 21;
+		u32 reg0 = (opcode & 0xF0000) >> 16;
+		u32 reg1 = (opcode & 0xF000) >> 12;
+
+		switch (code2) {
+
+			case 0:
+
+				if (sbit && !bit4) {
+					log << DWARNING << "Data processing instruction 0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << opcode << " potentially unsafe: CPSR non-secured" << std::endl;
+				} else if (sbit && !bit7 && bit4) {
+					log << DWARNING << "Data processing instruction 0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << opcode << " potentially unsafe: CPSR non-secured" << std::endl;
+				} else if (sbit && ext47 == 0x90 && ((code3 & 0xE) == 0 || (code3 & 0xC) == 4)) {
+					log << DWARNING << "Multiply instruction 0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << opcode << " potentially unsafe: CPSR non-secured" << std::endl;
+				} else if (!sbit && code3 == 9 && ext47 == 1) {
+					log << DWARNING << "Branch exchange instruction 0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << opcode << " has potential side-effects: Orphaned code block after instruction" << std::endl;
+				} else if (!sbit && (code3 & 0xD) == 9 && ext47 == 0) {
+					log << DWARNING << "PSR move instruction 0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << opcode << " potentially unsafe: CPSR non-secured" << std::endl;
+				} else if (!sbit && (code3 & 0xC) == 8 && ext47 == 5) {
+					log << DWARNING << "Saturating ALU instruction 0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << opcode << " potentially unsafe: CPSR non-secured" << std::endl;
+				} else if (!sbit && code3 == 9 && ext47 == 7) {
+					log << DWARNING << "Breakpoint instruction 0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << opcode << " potentially unsafe: Breakpoint out of place" << std::endl;
+				} else if (!sbit && ((code3 == 8 && (ext47 & 0x9) == 8) || (code3 == 9 && (ext47 & 0xB) == 8))) {
+					log << DWARNING << "Signed multiply (type 2) instruction 0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << opcode << " potentially unsafe: CPSR non-secured" << std::endl;
+				} else if (bit4 && ext47 > 9 && (reg0 == 0xF || reg1 == 0xF)) {
+					log << DWARNING << "Load/Store instruction 0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << opcode << " potentially unsafe: Broken PC-relative expression" << std::endl;
+				} else if (bit4 && !bit7 && (((code3 & 0xC) == 0x1000 && sbit) || ((code3 & 0xC) != 0x1000)) && (reg0 == 0xF || reg1 == 0xF)) {
+					log << DWARNING << "Data processing instruction 0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << opcode << " potentially unsafe: Broken PC-relative expression" << std::endl;
+				}
+
+				break;
+
+			case 1:
+
+				if (sbit) {
+					log << DWARNING << "Load/Store instruction 0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << opcode << " potentially unsafe: CPSR non-secured" << std::endl;
+				} else if (!sbit && (code3 & 0xD) == 9) {
+					log << DWARNING << "PSR move instruction 0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << opcode << " potentially unsafe: CPSR non-secured" << std::endl;
+				}
+
+				break;
+
+			case 2:
+
+				if (reg0 == 0xF || reg1 == 0xF) {
+					log << DWARNING << "Load/Store instruction 0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << opcode << " potentially unsafe: Broken PC-relative expression" << std::endl;
+				}
+
+				break;
+
+			case 3:
+				break;
+
+			case 4:
+
+				if (opcode & (1 << 15)) {
+					log << DWARNING << "Load/Store multiple instruction 0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << opcode << " potentially unsafe: PC used in register list" << std::endl;
+				}
+
+				break;
+
+			case 5:
+				log << DWARNING << "Branch instruction 0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << opcode << " potentially unsafe: Broken branch offset" << std::endl;
+				break;
+
+			case 6:
+				log << DWARNING << "Coprocessor load/store instruction 0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << opcode << " potentially unsafe: Broken PC-relative expression" << std::endl;
+				break;
+
+			case 7:
+
+				if (reg0 == 0xF || reg1 == 0xF) {
+					log << DWARNING << "Coprocessor load/store instruction 0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << opcode << " potentially unsafe: Broken PC-relative expression" << std::endl;
+				}
+
+				break;
+
+		}
+
+	} else {
+
+		if (code2 == 5) {
+			log << DWARNING << "Branch instruction 0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << opcode << " potentially unsafe: Broken branch offset" << std::endl;
+		}
+
+	}
+
+}
+
+
+
+
+u32 getSafeThunkSize(const Hook& hook) {
+	return hook.safeFlags ? 28 : 20;
+}
+
+
+
+void analyzeSafeHook(const ElfImage& image, const ElfSection& section, const std::vector<ElfSection>& relocationSections, const std::vector<ElfSymbol>& mappingSymbols, u32 sectionIndex, bool thumb, Hook& hook) {
+
+	SafeHookUsage usage{ 0, false, false };
+	std::set<u32> relocatedOffsets;
+	const u8* code = nullptr;
+
+	if (section.type != 1 || !getElfData(image, section.offset, section.size, code)) {
+		return;
+	}
+
+	for (const ElfSection& relocations : relocationSections) {
+
+		const u8* entries = nullptr;
+		u32 entrySize = relocations.type == 4 ? 12 : 8;
+
+		if (relocations.info != sectionIndex || !getElfData(image, relocations.offset, relocations.size, entries)) {
+			continue;
+		}
+
+		for (u32 i = 0; i < relocations.size / entrySize; i++) {
+			relocatedOffsets.insert(*reinterpret_cast<const u32*>(&entries[i * entrySize]));
+		}
+
+	}
+
+	char mode = thumb ? 't' : 'a';
+	u32 mapping = 0;
+
+	for (u32 offset = 0; offset < section.size && !usage.external;) {
+
+		for (; mapping < mappingSymbols.size() && mappingSymbols[mapping].value <= offset; mapping++) {
+
+			if (mappingSymbols[mapping].section == sectionIndex) {
+				mode = mappingSymbols[mapping].name[1];
+			}
+
+		}
+
+		if (mode == 'd') {
+
+			auto next = std::find_if(mappingSymbols.begin() + mapping, mappingSymbols.end(), [sectionIndex](const ElfSymbol& s) {
+				return s.section == sectionIndex;
+			});
+
+			offset = next != mappingSymbols.end() ? next->value : section.size;
+
+		} else if (mode == 't' && offset + 2 <= section.size) {
+
+			analyzeThumbInstruction(*reinterpret_cast<const u16*>(&code[offset]), offset, section.size, relocatedOffsets.contains(offset), usage);
+			offset += 2;
+
+		} else if (mode == 'a' && offset + 4 <= section.size) {
+
+			analyzeARMInstruction(*reinterpret_cast<const u32*>(&code[offset]), offset, section.size, relocatedOffsets.contains(offset), usage);
+			offset += 4;
+
+		} else {
+
+			usage.external = true;
+
+		}
+
+	}
+
+	//Writes to pc other than plain returns leave the function
+	if (usage.registers & 0x8000) {
+		usage.external = true;
+	}
+
+	//The callee preserves r4-r11 and sp (AAPCS), so only scratch registers it writes need to be saved
+	u32 registers = usage.external ? callerSavedRegisters : (usage.registers & callerSavedRegisters);
+	bool flags = usage.external || usage.flags;
+
+	//lr is overwritten by the call, r4 holds the flags across it
+	registers |= 0x4000;
+
+	if (flags) {
+		registers |= 0x10;
+	}
+
+	//Keep the stack pointer 8-byte aligned relative to the hooked code
+	if (std::popcount(registers) % 2) {
+		registers |= (registers + 1) & ~registers;
+	}
+
+	hook.safeRegisters = registers;
+	hook.safeFlags = flags;
+
+}
+
+
+
+void analyzeARMInstruction(u32 opcode, u32 offset, u32 size, bool relocated, SafeHookUsage& usage) {
+
+	u32 condition = (opcode & 0xF0000000) >> 28;
+	u32 code2 = (opcode & 0x0E000000) >> 25;
+	u32 rn = (opcode & 0xF0000) >> 16;
+	u32 rd = (opcode & 0xF000) >> 12;
+	bool sbit = (opcode & 0x100000) >> 20;
+	bool writeback = !(opcode & 0x1000000) || (opcode & 0x200000);
+
+	if (condition == 0xF) {
+
+		//blx (immediate) calls other code, pld has no side-effects
+		if ((opcode & 0xFD70F000) != 0xF550F000) {
+			usage.external = true;
+		}
+
+		return;
+
+	}
+
+	switch (code2) {
+
+		case 0:
+
+			if ((opcode & 0x0FFFFFD0) == 0x012FFF10) {
+
+				//Only bx lr returns to the thunk
+				if ((opcode & 0x20) || (opcode & 0xF) != 14) {
+					usage.external = true;
+				}
+
+			} else if ((opcode & 0x90) == 0x90) {
+
+				u32 type = (opcode & 0x60) >> 5;
+
+				if (type == 0 && (opcode & 0x1000000)) {
+					usage.registers |= 1 << rd;
+				} else if (type == 0) {
+
+					usage.registers |= 1 << rn;
+					usage.flags |= sbit;
+
+					if (opcode & 0x800000) {
+						usage.registers |= 1 << rd;
+					}
+
+				} else {
+
+					if (sbit) {
+						usage.registers |= 1 << rd;
+					} else if (type == 2) {
+						usage.registers |= 3 << rd;
+					}
+
+					if (writeback) {
+						usage.registers |= 1 << rn;
+					}
+
+				}
+
+			} else if ((opcode & 0x01900000) == 0x01000000) {
+
+				if ((opcode & 0x0FBF0FFF) == 0x010F0000 || (opcode & 0x0FFF0FF0) == 0x016F0F10) {
+					usage.registers |= 1 << rd;
+				} else if ((opcode & 0x0FB0FFF0) == 0x0120F000) {
+					usage.flags = true;
+				} else if ((opcode & 0xF0) == 0x50 || (opcode & 0x90) == 0x80) {
+					usage.registers |= 1 << rd | 1 << rn;
+					usage.flags = true;
+				} else {
+					usage.external = true;
+				}
+
+			} else {
+
+				u32 operation = (opcode & 0x1E00000) >> 21;
+
+				if ((opcode & 0x0FFFFFFF) != 0x01A0F00E && (operation < 8 || operation > 11)) {
+					usage.registers |= 1 << rd;
+				}
+
+				usage.flags |= sbit;
+
+			}
+
+			break;
+
+		case 1:
+
+			if ((opcode & 0x01900000) == 0x01000000) {
+
+				if ((opcode & 0x0FB0F000) == 0x0320F000) {
+					usage.flags = true;
+				} else {
+					usage.external = true;
+				}
+
+			} else {
+
+				u32 operation = (opcode & 0x1E00000) >> 21;
+
+				if (operation < 8 || operation > 11) {
+					usage.registers |= 1 << rd;
+				}
+
+				usage.flags |= sbit;
+
+			}
+
+			break;
+
+		case 2:
+		case 3:
+
+			if (code2 == 3 && (opcode & 0x10)) {
+				usage.external = true;
+				break;
+			}
+
+			if (sbit && (opcode & 0x0FFFFFFF) != 0x049DF004) {
+				usage.registers |= 1 << rd;
+			}
+
+			if (writeback) {
+				usage.registers |= 1 << rn;
+			}
+
+			break;
+
+		case 4:
+
+			if (sbit) {
+				usage.registers |= (opcode & 0xFFFF) & (rn == 13 ? 0x7FFF : 0xFFFF);
+			}
+
+			if (opcode & 0x200000) {
+				usage.registers |= 1 << rn;
+			}
+
+			break;
+
+		case 5:
+
+			if ((opcode & 0x1000000) || relocated) {
+				usage.external = true;
+			} else {
+
+				s64 target = static_cast<s64>(offset) + 8 + signExtend(opcode & 0xFFFFFF, 24) * 4;
+
+				if (target < 0 || target >= size) {
+					usage.external = true;
+				}
+
+			}
+
+			break;
+
+		case 7:
+
+			if (opcode & 0x1000000) {
+				usage.external = true;
+			} else if ((opcode & 0x100010) == 0x100010) {
+
+				if (rd == 15) {
+					usage.flags = true;
+				} else {
+					usage.registers |= 1 << rd;
+				}
+
+			}
+
+			break;
+
+		default:
+			usage.external = true;
+			break;
+
+	}
+
+}
+
+
+
+void analyzeThumbInstruction(u16 opcode, u32 offset, u32 size, bool relocated, SafeHookUsage& usage) {
+
+	u32 rd = opcode & 7;
+	u32 rdHigh = (opcode & 0x700) >> 8;
+	bool load = opcode & 0x800;
+
+	switch (opcode >> 13) {
+
+		case 0:
+
+			usage.registers |= 1 << rd;
+			usage.flags = true;
+			break;
+
+		case 1:
+
+			if ((opcode & 0x1800) != 0x0800) {
+				usage.registers |= 1 << rdHigh;
+			}
+
+			usage.flags = true;
+			break;
+
+		case 2:
+
+			if ((opcode >> 10) == 0x10) {
+
+				u32 operation = (opcode & 0x3C0) >> 6;
+
+				if (operation != 8 && operation != 10 && operation != 11) {
+					usage.registers |= 1 << rd;
+				}
 
-		const std::string& extension = source.extension().string();
-		fs::path objectPath = getObjectPath(settings, source);
-		fs::path depPath = getDependencyPath(settings, source);
-		s32 status = 0;
-		std::string cmd;
-		std::string defines;
+				usage.flags = true;
+
+			} else if ((opcode >> 10) == 0x11) {
+
+				u32 operation = (opcode & 0x300) >> 8;
+				u32 rdFull = rd | (opcode & 0x80) >> 4;
+				u32 rm = (opcode & 0x78) >> 3;
+
+				if (operation == 3) {
+
+					//Only bx lr returns to the thunk
+					if ((opcode & 0x80) || rm != 14) {
+						usage.external = true;
+					}
+
+				} else if (operation == 1) {
+					usage.flags = true;
+				} else if (operation != 2 || rdFull != 15 || rm != 14) {
+					usage.registers |= 1 << rdFull;
+				}
+
+			} else if ((opcode >> 11) == 9) {
+				usage.registers |= 1 << rdHigh;
+			} else if ((opcode & 0xE00) >= 0x600) {
+				usage.registers |= 1 << rd;
+			}
+
+			break;
+
+		case 3:
+
+			if (load) {
+				usage.registers |= 1 << rd;
+			}
+
+			break;
+
+		case 4:
+
+			if (load) {
+				usage.registers |= 1 << ((opcode & 0x1000) ? rdHigh : rd);
+			}
+
+			break;
+
+		case 5:
+
+			if (!(opcode & 0x1000)) {
+				usage.registers |= 1 << rdHigh;
+			} else if ((opcode & 0x600) == 0x400) {
+
+				if (load) {
+					usage.registers |= opcode & 0xFF;
+				}
+
+			} else if ((opcode & 0xF00) != 0) {
+				usage.external = true;
+			}
+
+			break;
+
+		case 6:
+
+			if (!(opcode & 0x1000)) {
+
+				if (load) {
+					usage.registers |= opcode & 0xFF;
+				}
+
+				usage.registers |= 1 << rdHigh;
+
+			} else if ((opcode & 0xE00) == 0xE00 || relocated) {
+				usage.external = true;
+			} else {
+
+				s64 target = static_cast<s64>(offset) + 4 + signExtend(opcode & 0xFF, 8) * 2;
+
+				if (target < 0 || target >= size) {
+					usage.external = true;
+				}
+
+			}
+
+			break;
+
+		case 7:
+
+			if ((opcode >> 11) == 0x1C && !relocated) {
+
+				s64 target = static_cast<s64>(offset) + 4 + signExtend(opcode & 0x7FF, 11) * 2;
+
+				if (target < 0 || target >= size) {
+					usage.external = true;
+				}
+
+			} else {
+				usage.external = true;
+			}
+
+			break;
+
+	}
+
+}
+
+
+
+
+bool collectHooks(const BuildSettings& settings, const CodeTargetMap& codeTargets, ObjectHookMap& objectHooks, HookSymbols& hookSymbols, u64& objectsHash) {
+
+	std::cout << DINFO << "Collecting hooks" << std::endl;
+
+	std::vector<CodeTarget> targets;
+	std::vector<std::pair<CodeTarget, std::string>> objects;
+	std::vector<std::string> pendingObjects;
+
+	for (const auto& e : codeTargets) {
+		targets.push_back(e.first);
+	}
+
+	//Merging in a fixed order keeps the result independent of thread scheduling
+	std::sort(targets.begin(), targets.end());
+
+	for (CodeTarget target : targets) {
+
+		for (const fs::path& srcPath : codeTargets.at(target)) {
+
+			const std::string& objPath = getPathString(getObjectPath(settings, srcPath));
+			objects.emplace_back(target, objPath);
+
+			//Objects parsed right after compilation or unchanged since the last build are already known
+			if (!objectHooks.contains(objPath)) {
+				pendingObjects.push_back(objPath);
+			}
+
+		}
+
+	}
+
+	std::vector<ObjectHooks> pendingHooks(pendingObjects.size());
+	std::atomic_uint objectIndex = 0;
+	std::atomic_bool successful = true;
+
+	auto parseFunction = [&]() {
+
+		while (successful) {
+
+			u32 i = objectIndex.fetch_add(1);
+
+			if (i >= pendingObjects.size()) {
+				return;
+			}
+
+			if (!parseObjectHooks(settings, pendingObjects[i], pendingHooks[i])) {
+				successful = false;
+			}
+
+		}
+
+	};
+
+	u32 threadCount = std::max(std::min(settings.threadCount, static_cast<u32>(pendingObjects.size())), 1u);
+	std::vector<std::thread> threads;
+
+	for (u32 i = 1; i < threadCount; i++) {
+		threads.emplace_back(parseFunction);
+	}
+
+	parseFunction();
+
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+
+	if (!successful) {
+		return false;
+	}
+
+	for (u32 i = 0; i < pendingObjects.size(); i++) {
+		objectHooks[pendingObjects[i]] = std::move(pendingHooks[i]);
+	}
+
+	for (const auto& e : objects) {
+
+		const ObjectHooks& hooks = objectHooks.at(e.second);
+		HookMap& hookMap = hookSymbols.getSymbolMap(isARM9Target(e.first));
+
+		for (const ObjectHook& objectHook : hooks.hooks) {
+			hookMap[objectHook.symbol] = objectHook.hook;
+		}
+
+		if (hooks.safeBytes) {
+			hookSymbols.incSafe(e.first, hooks.safeBytes);
+		}
+
+		if (hooks.veneerBytes) {
+			hookSymbols.incVeneer(e.first, hooks.veneerBytes);
+		}
+
+		objectsHash = hashData(reinterpret_cast<const u8*>(&hooks.hash), sizeof(u64), objectsHash);
+
+	}
+
+	return true;
+
+}
+
+
+
+void pruneObjectHooks(const BuildSettings& settings, const CodeTargetMap& codeTargets, ObjectHookMap& objectHooks) {
+
+	std::set<std::string> objectSet;
+
+	for (const auto& e : codeTargets) {
+
+		for (const fs::path& srcPath : e.second) {
+			objectSet.insert(getPathString(getObjectPath(settings, srcPath)));
+		}
+
+	}
+
+	//Objects that left the build must not linger across watch iterations
+	std::erase_if(objectHooks, [&objectSet](const auto& e) {
+		return !objectSet.contains(e.first);
+	});
+
+	saveHookTable(settings, objectHooks);
+
+}
+
+
+
+bool parseObjectHooks(const BuildSettings& settings, const fs::path& objPath, ObjectHooks& hooks) {
+
+	hooks.hooks.clear();
+	hooks.safeBytes = 0;
+	hooks.veneerBytes = 0;
+	hooks.time = 0;
+	hooks.size = 0;
+	hooks.hash = 0;
+
+	if (!fs::exists(objPath) || !fs::is_regular_file(objPath)) {
+		std::cout << DERROR << "Fatal error: Failed to find object file " << objPath.string() << std::endl;
+		return false;
+	}
+
+	ElfImage image;
+
+	if (!openElfImage(objPath, image)) {
+		std::cout << DERROR << "Fatal error: Failed to open object file " << objPath.string() << std::endl;
+		return false;
+	}
+
+	hooks.time = timeLastModified(objPath);
+	hooks.size = image.size;
+	hooks.hash = hashData(image.data, image.size);
+
+	std::unordered_map<u32, Hook> hookSections;
+	std::unordered_map<u32, ElfSection> safeSections;
+	std::vector<ElfSection> relocationSections;
+
+	ElfSection symtab{};
+	ElfSection strtab{};
+
+	for (u32 i = 0; i < image.sectionCount; i++) {
+
+		ElfSection section;
+		getElfSection(image, i, section);
+
+		std::string_view shname = section.name;
+
+		if (shname.starts_with(".hook") || shname.starts_with(".rlnk") || shname.starts_with(".safe") || shname.starts_with(".over")) {
+
+			HookType hookType = HookType::None;
+			u32 hookEndIndex = shname.find_first_of('.', 1);
+			std::string_view hookTypename = shname.substr(1, hookEndIndex - 1);
+
+			if (hookTypename == "hook") {
+				hookType = HookType::Hook;
+			} else if (hookTypename == "rlnk") {
+				hookType = HookType::Link;
+			} else if (hookTypename == "safe") {
+				hookType = HookType::Safe;
+			} else if (hookTypename == "over") {
+				hookType = HookType::Replace;
+			}
+
+			u32 targetEndIndex = shname.find_last_of('.');
+			std::string target(shname.substr(hookEndIndex + 1, targetEndIndex - hookEndIndex - 1));
+			std::string address(shname.substr(targetEndIndex + 1));
+
+			CodeTarget hookTarget = getCodeTarget(target);
+
+			if (hookTarget == invalidTarget) {
+				std::cout << DWARNING + ("Invalid hook target " + target) + "\n" << std::flush;
+				continue;
+			}
+
+			u32 hookAddress;
+
+			try {
+				hookAddress = std::stoul(address, nullptr, 16);
+			} catch (std::exception&) {
+				std::cout << DWARNING + ("Invalid hook address " + address) + "\n" << std::flush;
+				continue;
+			}
+
+			if (hookType == HookType::Safe) {
+
+				//Objects are parsed concurrently, so the message is formatted locally instead of on the shared stream
+				if (hookAddress & 1) {
+
+					std::stringstream warning;
+					warning << DWARNING << "Cannot make safe hook at 0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << hookAddress << " from Thumb mode\n";
+					std::cout << warning.str() << std::flush;
+
+					continue;
+
+				}
+
+				safeSections[i] = section;
+
+			}
+
+			hookSections[i] = Hook{ hookTarget, hookType, hookAddress, 0xFFFFFFFF, allSafeRegisters, false };
+
+		}
+
+		if (section.type == 9 || section.type == 4) {
+			relocationSections.push_back(section);
+		}
+
+		if (shname == ".symtab") {
+			symtab = section;
+		}
+
+		if (shname == ".strtab") {
+			strtab = section;
+		}
+
+	}
+
+	if (!symtab.offset) {
+		std::cout << DERROR << "Error while parsing object file " << objPath.string() << ": Missing symbol table" << std::endl;
+		closeElfImage(image);
+		return false;
+	}
+
+	if (!strtab.offset) {
+		std::cout << DERROR << "Error while parsing object file " << objPath.string() << ": Missing string table" << std::endl;
+		closeElfImage(image);
+		return false;
+	}
+
+	ElfSymbol symbol;
+	std::vector<std::pair<u32, ElfSymbol>> safeFunctions;
+	std::vector<ElfSymbol> mappingSymbols;
+
+	for (u32 i = 0; getElfSymbol(image, symtab, strtab, i, symbol); i++) {
+
+		if (hookSections.contains(symbol.section) && symbol.value < 2 && !symbol.name.empty() && symbol.name[0] != '$') {
+
+			const Hook& hook = hookSections[symbol.section];
+			bool arm9 = isARM9Target(hook.codeTarget);
+			hooks.hooks.push_back(ObjectHook{ std::string(symbol.name), hook });
+
+			//The Thumb bit of the function is known before linking, so each hook needing a veneer reserves one
+			if (needsVeneer(hook.hookType, hook.hookAddress & 1, symbol.value & 1, arm9)) {
+				hooks.veneerBytes += getVeneerSize(arm9);
+			}
+
+			if (safeSections.contains(symbol.section)) {
+				safeFunctions.emplace_back(hooks.hooks.size() - 1, symbol);
+			}
+
+		}
+
+		//Mapping symbols ($a, $t, $d) tell ARM code, Thumb code and literal pools apart
+		if (settings.analyzeSafeHooks && safeSections.contains(symbol.section) && symbol.name.size() >= 2 && symbol.name[0] == '$') {
+			mappingSymbols.push_back(symbol);
+		}
+
+	}
+
+	std::sort(mappingSymbols.begin(), mappingSymbols.end(), [](const ElfSymbol& a, const ElfSymbol& b) {
+		return a.value < b.value;
+	});
+
+	for (const auto& [index, function] : safeFunctions) {
+
+		Hook& hook = hooks.hooks[index].hook;
+
+		if (settings.analyzeSafeHooks) {
+			analyzeSafeHook(image, safeSections[function.section], relocationSections, mappingSymbols, function.section, function.value & 1, hook);
+		}
+
+		hooks.safeBytes += getSafeThunkSize(hook);
+
+	}
+
+	closeElfImage(image);
+
+	return true;
+
+}
+
+
+
+void loadHookTable(const BuildSettings& settings, const FileTree* tree, ObjectHookMap& objectHooks) {
+
+	fs::path tablePath = settings.buildDir / "hooks.bin";
+
+	if (!fs::exists(tablePath) || !fs::is_regular_file(tablePath)) {
+		return;
+	}
+
+	std::ifstream tableFile(tablePath, std::ios::in | std::ios::binary);
+
+	if (!tableFile.is_open()) {
+		std::cout << DWARNING << "Failed to open hook table " << tablePath.string() << std::endl;
+		return;
+	}
+
+	u32 magic = 0;
+	u32 version = 0;
+	u32 analyzed = 0;
+	u32 objectCount = 0;
+	tableFile.read(reinterpret_cast<char*>(&magic), 4);
+	tableFile.read(reinterpret_cast<char*>(&version), 4);
+	tableFile.read(reinterpret_cast<char*>(&analyzed), 4);
+	tableFile.read(reinterpret_cast<char*>(&objectCount), 4);
+
+	//Safe hook register masks depend on whether the hook functions were analyzed
+	if (magic != hookTableMagic || version != hookTableVersion || analyzed != settings.analyzeSafeHooks) {
+		return;
+	}
+
+	for (u32 i = 0; i < objectCount && tableFile; i++) {
+
+		u16 length = 0;
+		tableFile.read(reinterpret_cast<char*>(&length), 2);
+
+		std::string objPath;
+		objPath.resize(length);
+		tableFile.read(&objPath[0], length);
+
+		ObjectHooks hooks{};
+		u32 hookCount = 0;
+		tableFile.read(reinterpret_cast<char*>(&hooks.time), 8);
+		tableFile.read(reinterpret_cast<char*>(&hooks.size), 8);
+		tableFile.read(reinterpret_cast<char*>(&hooks.hash), 8);
+		tableFile.read(reinterpret_cast<char*>(&hooks.safeBytes), 4);
+		tableFile.read(reinterpret_cast<char*>(&hooks.veneerBytes), 4);
+		tableFile.read(reinterpret_cast<char*>(&hookCount), 4);
+
+		for (u32 j = 0; j < hookCount && tableFile; j++) {
+
+			ObjectHook objectHook{};
+			u32 hookType = 0;
+			u32 safeFlags = 0;
+
+			tableFile.read(reinterpret_cast<char*>(&length), 2);
+			objectHook.symbol.resize(length);
+			tableFile.read(&objectHook.symbol[0], length);
+			tableFile.read(reinterpret_cast<char*>(&objectHook.hook.codeTarget), 4);
+			tableFile.read(reinterpret_cast<char*>(&hookType), 4);
+			tableFile.read(reinterpret_cast<char*>(&objectHook.hook.hookAddress), 4);
+			tableFile.read(reinterpret_cast<char*>(&objectHook.hook.safeRegisters), 4);
+			tableFile.read(reinterpret_cast<char*>(&safeFlags), 4);
+
+			objectHook.hook.hookType = static_cast<HookType>(hookType);
+			objectHook.hook.safeFlags = safeFlags;
+			objectHook.hook.funcAddress = 0xFFFFFFFF;
+			hooks.hooks.push_back(std::move(objectHook));
+
+		}
+
+		//Entries of objects written since the table was saved are dropped and parsed again
+		const FileTreeEntry* treeEntry = tree ? findFileTreeEntry(*tree, objPath) : nullptr;
+		u64 time = 0;
+		u64 size = 0;
+
+		if (treeEntry) {
+
+			time = treeEntry->time;
+			size = treeEntry->size;
+
+		} else {
+
+			std::error_code ec;
+			fs::directory_entry entry(objPath, ec);
+
+			if (ec || !entry.is_regular_file(ec)) {
+				continue;
+			}
+
+			time = std::chrono::duration_cast<std::chrono::milliseconds>(entry.last_write_time(ec).time_since_epoch()).count();
+			size = entry.file_size(ec);
+
+		}
 
-		if (!isCompilableFile(source)) {
-			continue;
+		if (hooks.time == time && hooks.size == size) {
+			objectHooks[objPath] = std::move(hooks);
 		}
 
-		std::string objectPathString = getPathString(objectPath);
+	}
 
-		if (tracker.compilationObjects.contains(objectPathString)) {
-			std::cout << DERROR << "Fatal error: Multiple references to object file " << objectPathString << std::endl;
-			return false;
-		}
+	if (!tableFile) {
+		std::cout << DWARNING << "Hook table " << tablePath.string() << " is corrupted, reparsing all objects" << std::endl;
+		objectHooks.clear();
+	}
 
-		tracker.compilationObjects.insert(objectPathString);
+	tableFile.close();
 
-		if (!needsCompilation(settings, tracker, source)) {
-			trackDependencies(settings, tracker, depPath, true);
-			continue;
-		}
+}
 
-		if (extension == ".cpp") {
-			std::cout << DINFO << "Compiling C++ source " << source.string() << std::endl;
-			flags = &settings.flags.cpp;
-			defines += " -D__FFC_LANG_CPP";
-		} else if (extension == ".c") {
-			std::cout << DINFO << "Compiling C source " << source.string() << std::endl;
-			flags = &settings.flags.c;
-			defines += " -D__FFC_LANG_C";
-		} else {
-			std::cout << DINFO << "Compiling ASM source " << source.string() << std::endl;
-			flags = &settings.flags.assembly;
-			defines += " -D__FFC_LANG_ASM";
-		}
 
-		if (isARM9Target(target)) {
 
-			arch = &settings.flags.arm9;
-			defines += " -D__FFC_ARCH_NUM=9";
+void saveHookTable(const BuildSettings& settings, const ObjectHookMap& objectHooks) {
 
-		} else {
+	fs::path tablePath = settings.buildDir / "hooks.bin";
+	std::ofstream tableFile(tablePath, std::ios::out | std::ios::binary | std::ios::trunc);
 
-			arch = &settings.flags.arm7;
-			defines += " -D__FFC_ARCH_NUM=7";
+	if (!tableFile.is_open()) {
+		std::cout << DWARNING << "Failed to open hook table " << tablePath.string() << std::endl;
+		return;
+	}
 
-		}
+	u32 analyzed = settings.analyzeSafeHooks;
+	u32 objectCount = objectHooks.size();
+	tableFile.write(reinterpret_cast<const char*>(&hookTableMagic), 4);
+	tableFile.write(reinterpret_cast<const char*>(&hookTableVersion), 4);
+	tableFile.write(reinterpret_cast<const char*>(&analyzed), 4);
+	tableFile.write(reinterpret_cast<const char*>(&objectCount), 4);
 
-		cmd = settings.executables.gcc + " " + *flags + " " + *arch + " -c " + source.string() + " -o " + objectPathString + " -MMD -MF " + depPath.string() + includeFlags + defines;
-		status = std::system(cmd.c_str());
+	for (const auto& e : objectHooks) {
 
-		if (status) {
+		const std::string& objPath = e.first;
+		const ObjectHooks& hooks = e.second;
+		u16 length = objPath.length();
+		u32 hookCount = hooks.hooks.size();
 
-			std::cout << DWARNING << "Failed with status " << status << std::endl;
-			status = 0;
-			state = false;
+		tableFile.write(reinterpret_cast<const char*>(&length), 2);
+		tableFile.write(objPath.data(), length);
+		tableFile.write(reinterpret_cast<const char*>(&hooks.time), 8);
+		tableFile.write(reinterpret_cast<const char*>(&hooks.size), 8);
+		tableFile.write(reinterpret_cast<const char*>(&hooks.hash), 8);
+		tableFile.write(reinterpret_cast<const char*>(&hooks.safeBytes), 4);
+		tableFile.write(reinterpret_cast<const char*>(&hooks.veneerBytes), 4);
+		tableFile.write(reinterpret_cast<const char*>(&hookCount), 4);
 
-			if (settings.pedantic) {
-				return state;
-			}
+		for (const ObjectHook& objectHook : hooks.hooks) {
 
-		} else {
+			u32 hookType = static_cast<u32>(objectHook.hook.hookType);
+			u32 safeFlags = objectHook.hook.safeFlags;
+			length = objectHook.symbol.length();
 
-			trackDependencies(settings, tracker, depPath, false);
+			tableFile.write(reinterpret_cast<const char*>(&length), 2);
+			tableFile.write(objectHook.symbol.data(), length);
+			tableFile.write(reinterpret_cast<const char*>(&objectHook.hook.codeTarget), 4);
+			tableFile.write(reinterpret_cast<const char*>(&hookType), 4);
+			tableFile.write(reinterpret_cast<const char*>(&objectHook.hook.hookAddress), 4);
+			tableFile.write(reinterpret_cast<const char*>(&objectHook.hook.safeRegisters), 4);
+			tableFile.write(reinterpret_cast<const char*>(&safeFlags), 4);
 
 		}
 
 	}
 
-	return state;
+	tableFile.close();
 
 }
-*/
 
 
 
-bool populateCodeTargets(const BuildSettings& settings, Document& root, CodeTargetMap& codeTargets) {
+bool parseElf(const BuildSettings& settings, bool arm9, HookSymbols& hookSymbols, std::vector<Fixup>& fixups, LinkedImages& images) {
 
-	std::cout << DINFO << "Parsing code target configuration" << std::endl;
+	std::cout << DINFO << "Fixing hook symbol addresses" << std::endl;
 
-	if (!root["main"].IsObject()) {
-		std::cout << DERROR << "Missing JSON object 'main'" << std::endl;
+	const std::string& elfFilename = arm9 ? "arm9.elf" : "arm7.elf";
+	fs::path elfPath = settings.buildDir / elfFilename;
+
+	if (!fs::exists(elfPath) || !fs::is_regular_file(elfPath)) {
+		return true;
+	}
+
+	ElfImage& image = images.getImage(arm9);
+
+	if (!openElfImage(elfPath, image)) {
+		std::cout << DERROR << "Fatal error: Failed to open " << elfFilename << std::endl;
 		return false;
 	}
 
-	const Value& codeNode = root["main"].GetObject();
+	ElfSection symtab{};
+	ElfSection strtab{};
 
-	for (auto& v : codeNode.GetObject()) {
+	HookMap& hooks = hookSymbols.getSymbolMap(arm9);
+	std::map<CodeTarget, Patch> elfBinaries;
 
-		std::string target = v.name.GetString();
+	for (u32 i = 0; i < image.sectionCount; i++) {
 
-		if (target == "default-target") {
-			continue;
-		}
+		ElfSection section;
+		getElfSection(image, i, section);
 
-		CodeTarget codeTarget = getCodeTarget(target);
+		std::string_view shname = section.name;
+
+		if (shname == ".symtab") {
+
+			symtab = section;
+
+		} else if (shname == ".strtab") {
+
+			strtab = section;
+
+		} else if (shname.starts_with(".text")) {
+
+			CodeTarget target = getCodeTarget(std::string(shname.substr(6)));
+
+			if (target == invalidTarget) {
+				std::cout << DERROR << "Invalid code target for section " << shname << std::endl;
+				return false;
+			}
+
+			elfBinaries[target].codeTarget = target;
+			elfBinaries[target].ramAddress = section.address;
+			elfBinaries[target].binOffset = section.offset;
+			elfBinaries[target].binSize = section.size;
+
+		} else if (shname.starts_with(".bss")) {
+
+			CodeTarget target = getCodeTarget(std::string(shname.substr(5)));
+
+			if (target == invalidTarget) {
+				std::cout << DERROR << "Invalid code target for section " << shname << std::endl;
+				return false;
+			}
+
+			elfBinaries[target].bssSize = section.size;
+			elfBinaries[target].bssAlign = section.align;
+
+		} else if (shname.starts_with(".over")) {
+
+			u32 subsectionIndex = shname.find_last_of('.');
+			CodeTarget target = getCodeTarget(std::string(shname.substr(6, subsectionIndex - 6)));
+
+			if (target == invalidTarget) {
+				std::cout << DERROR << "Invalid code target for section " << shname << std::endl;
+				return false;
+			}
+
+			u32 rplcAddress = 0;
+
+			try {
+				rplcAddress = std::stoul(std::string(shname.substr(subsectionIndex + 1)), nullptr, 16);
+			} catch (std::exception&) {
+				std::cout << DWARNING << "Invalid replace address " << shname.substr(subsectionIndex + 1) << std::endl;
+				continue;
+			}
+
+			fixups.push_back(Patch{ target, rplcAddress, section.offset, section.size, noBSS, noBSS });
 
-		if (codeTarget != invalidTarget) {
-			RETURN_ON_ERROR(getSourceSet(codeNode, target, settings.sourceDir, codeTargets[codeTarget]))
-		} else {
-			std::cout << DERROR << "Invalid code target " << target << std::endl;
-			return false;
 		}
 
 	}
 
-	if (codeNode["default-target"].IsString()) {
 
-		std::string defaultTarget = codeNode["default-target"].GetString();
-		CodeTarget codeTarget = getCodeTarget(defaultTarget);
 
-		if (codeTarget != invalidTarget) {
-			scanDefaultTarget(codeTargets, codeTarget, settings.sourceDir);
-		} else {
-			std::cout << DERROR << "Invalid default target " << defaultTarget << std::endl;
-			return false;
+	if (!symtab.offset) {
+		std::cout << DERROR << "Error while parsing " << elfFilename << ": Missing symbol table" << std::endl;
+		return false;
+	}
+
+	if (!strtab.offset) {
+		std::cout << DERROR << "Error while parsing " << elfFilename << ": Missing string table" << std::endl;
+		return false;
+	}
+
+
+	//Symbol names are looked up in place instead of copying the whole string table
+	std::unordered_map<std::string_view, Hook*> hookSyms;
+	hookSyms.reserve(hooks.size());
+
+	for (auto& e : hooks) {
+		hookSyms[e.first] = &e.second;
+	}
+
+	ElfSymbol symbol;
+
+	for (u32 i = 0; getElfSymbol(image, symtab, strtab, i, symbol); i++) {
+
+		auto it = hookSyms.find(symbol.name);
+
+		if (it != hookSyms.end()) {
+			it->second->funcAddress = symbol.value;
+		} else if (symbol.name.starts_with("__ffc_init_start_")) {
+			elfBinaries[getCodeTarget(std::string(symbol.name.substr(17)))].initStart = symbol.value;
+		} else if (symbol.name.starts_with("__ffc_init_end_")) {
+			elfBinaries[getCodeTarget(std::string(symbol.name.substr(15)))].initEnd = symbol.value;
+		} else if (symbol.name.starts_with("__ffc_veneer_start_")) {
+			elfBinaries[getCodeTarget(std::string(symbol.name.substr(19)))].veneerStart = symbol.value;
+		} else if (symbol.name.starts_with("__ffc_veneer_end_")) {
+			elfBinaries[getCodeTarget(std::string(symbol.name.substr(17)))].veneerEnd = symbol.value;
 		}
 
 	}
 
+	for (const auto& e : elfBinaries) {
+		fixups.push_back(e.second);
+	}
+
 	return true;
 
 }
 
 
 
+void appendHookFixups(HookSymbols& hookSymbols, std::vector<Fixup>& fixups) {
 
-bool generateLinkerScripts(const BuildSettings& buildSettings, const PatchSettings& patchSettings, CodeTargetMap& codeTargets, HookSymbols& hookSymbols) {
+	for (const auto& e : hookSymbols.hooks7) {
+		fixups.push_back(e.second);
+	}
 
-	if (codeTargets.empty()) {
-		std::cout << DERROR << "No input files, cancelling" << std::endl;
-		return false;
+	for (const auto& e : hookSymbols.hooks9) {
+		fixups.push_back(e.second);
 	}
 
-	for (auto& e : codeTargets) {
+	std::sort(fixups.begin(), fixups.end(), [](const Fixup& a, const Fixup& b) {
+
+		CodeTarget ca = invalidTarget;
+		CodeTarget cb = invalidTarget;
+		bool pa = std::holds_alternative<Patch>(a);
+		bool pb = std::holds_alternative<Patch>(b);
 
-		std::set<fs::path> tempSet;
+		if (pa) {
+			ca = std::get<Patch>(a).codeTarget;
+		} else {
+			ca = std::get<Hook>(a).codeTarget;
+		}
 
-		for (fs::path sourceFile : e.second) {
-			tempSet.insert(fs::relative(sourceFile, buildSettings.sourceDir).replace_extension(".o").string());
+		if (pb) {
+			cb = std::get<Patch>(b).codeTarget;
+		} else {
+			cb = std::get<Hook>(b).codeTarget;
 		}
 
-		e.second.swap(tempSet);
+		if (ca == cb) {
 
-	}
+			if (pa && pb) {
 
-	for (u32 a = 0; a < 2; a++) {
+				u32 ba = std::get<Patch>(a).bssSize;
+				u32 bb = std::get<Patch>(b).bssSize;
 
-		const std::string& procName = a ? "arm9" : "arm7";
-		const std::string& armLinkerFilename = procName + ".x";
-		const fs::path& scriptPath = buildSettings.buildDir / armLinkerFilename;
-		u32 armStart = a ? patchSettings.arm9.start : patchSettings.arm7.start;
-		u32 armEnd = a ? patchSettings.arm9.end : patchSettings.arm7.end;
+				return ba > bb;
 
-		if (fs::exists(scriptPath) && fs::is_regular_file(scriptPath)) {
-			removeFile(scriptPath, "old script");
-		}
+			} else {
+
+				return pb;
+
+			}
+
+		} else {
 
-		std::string linkerScript = "/* Auto-generated linker script */\n\n";
+			return ca < cb;
 
-		if (a && !buildSettings.symbol9File.empty()) {
-			linkerScript += "INCLUDE " + buildSettings.symbol9File.string() + "\n";
-		} else if (!a && !buildSettings.symbol7File.empty()) {
-			linkerScript += "INCLUDE " + buildSettings.symbol7File.string() + "\n";
 		}
 
-		linkerScript += "SEARCH_DIR(" + buildSettings.objectDir.string() + ")\n\n";
-		linkerScript += "INPUT(\n";
+	});
 
-		u32 inputFiles = 0;
+}
 
-		for (const auto& e : codeTargets) {
 
-			if (a != isARM9Target(e.first)) {
-				continue;
-			}
 
-			u32 i = 0;
-			u32 targetInputFiles = e.second.size();
-			const std::string& target = getCodeTargetName(e.first);
-			linkerScript += "/* " + target + " */\t";
+bool openElfImage(const fs::path& p, ElfImage& image) {
 
-			if (target.size() < 6) {
-				linkerScript += "\t";
-			}
+	image = ElfImage{};
 
-			for (const fs::path& sourceFile : e.second) {
+#ifdef _WIN32
 
-				linkerScript += sourceFile.string();
+	image.file = CreateFileW(p.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	LARGE_INTEGER fileSize{};
 
-				if (i && (i % 4 == 3) && i != targetInputFiles - 1) {
-					linkerScript += "\n\t\t\t\t";
-				} else if (i != targetInputFiles - 1) {
-					linkerScript += " ";
-				}
+	if (image.file == INVALID_HANDLE_VALUE || !GetFileSizeEx(image.file, &fileSize)) {
+		std::cout << DERROR << "Failed to open " << p.string() << std::endl;
+		closeElfImage(image);
+		return false;
+	}
 
-				i++;
+	image.size = fileSize.QuadPart;
+	image.mapping = image.size ? CreateFileMappingW(image.file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+	image.data = image.mapping ? static_cast<const u8*>(MapViewOfFile(image.mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
 
-			}
+#else
 
-			linkerScript += "\n";
-			inputFiles += i;
+	int fd = open(p.c_str(), O_RDONLY | O_CLOEXEC);
+	struct stat fileStat{};
 
-		}
+	if (fd < 0 || fstat(fd, &fileStat)) {
 
-		if (!inputFiles) {
-			continue;
+		std::cout << DERROR << "Failed to open " << p.string() << std::endl;
+
+		if (fd >= 0) {
+			close(fd);
 		}
 
+		return false;
 
-		linkerScript += ")\n\n";
-		linkerScript += "MEMORY\n{\n";
-		linkerScript += "\tldpatch (rwx): ORIGIN = 0x00000000, LENGTH = 1000000\n";
-		linkerScript += "\t" + procName + " (rwx): ORIGIN = " + getHexString(armStart) + ", LENGTH = " + std::to_string(armEnd - armStart) + '\n';
-		
-		linkerScript += "}\n\n";
-		linkerScript += "SECTIONS\n{\n";
+	}
 
-		static const std::string sections[] = {
-			"(.safe.*)", "(.hook.*)", "(.rlnk.*)", "(.text)", "(.text.*)", "(.rodata)", "(.rodata.*)", "(.init_array)", "(.data)", "(.bss)", "(.bss.*)"
-		};
+	image.size = fileStat.st_size;
 
-		static constexpr u32 sectionCount = 9;
-		
-		for (const auto& e : codeTargets) {
+	if (image.size) {
 
-			if (a != isARM9Target(e.first)) {
-				continue;
-			}
+		void* mapping = mmap(nullptr, image.size, PROT_READ, MAP_PRIVATE, fd, 0);
+		image.data = mapping != MAP_FAILED ? static_cast<const u8*>(mapping) : nullptr;
 
-			const std::string& indent = isBinary(e.first) ? "\t" : "\t\t";
+	}
 
-			const std::string& target = getCodeTargetName(e.first);
-			linkerScript += "\t.text." + target + " : ALIGN(4) {\n";
-			linkerScript += "\t\t. += " + std::to_string(hookSymbols.safeCounts[e.first]) + ";\n";
+	close(fd);
 
-			for (u32 i = 0; i < sectionCount; i++) {
+#endif
 
-				for (const fs::path& sourceFile : e.second) {
-					linkerScript += "\t\t" + sourceFile.string() + sections[i] + "\n";
-				}
+	if (!image.data) {
+		std::cout << DERROR << "Failed to map " << p.string() << std::endl;
+		closeElfImage(image);
+		return false;
+	}
 
-			}
+	//Only 32 bit little endian files with a section header table inside the image are accepted, everything else is read unchecked
+	if (image.size < 0x34 || std::memcmp(image.data, "\x7F" "ELF", 4) || image.data[4] != 1 || image.data[5] != 1) {
+		std::cout << DERROR << "Invalid ELF file " << p.string() << std::endl;
+		closeElfImage(image);
+		return false;
+	}
 
-			linkerScript += "\t\t. = ALIGN(4);\n\t} >" + target + " AT>ldpatch\n\n";
-			linkerScript += "\t.bss." + target + " : ALIGN(4) {\n";
+	image.sectionHeaders = *reinterpret_cast<const u32*>(&image.data[0x20]);
+	image.sectionCount = *reinterpret_cast<const u16*>(&image.data[0x30]);
+	u16 entrySize = *reinterpret_cast<const u16*>(&image.data[0x2E]);
+	u16 namesIndex = *reinterpret_cast<const u16*>(&image.data[0x32]);
 
-			for (const fs::path& sourceFile : e.second) {
-				linkerScript += "\t\t" + sourceFile.string() + sections[9] + "\n";
-				linkerScript += "\t\t" + sourceFile.string() + sections[10] + "\n";
-			}
+	if ((image.sectionCount && entrySize != 0x28) || image.sectionHeaders + static_cast<u64>(image.sectionCount) * 0x28 > image.size || namesIndex >= image.sectionCount) {
+		std::cout << DERROR << "Corrupted section header table in " << p.string() << std::endl;
+		closeElfImage(image);
+		return false;
+	}
 
-			linkerScript += "\t\t. = ALIGN(4); \n\t} >" + target + " AT>ldpatch\n\n";
+	image.namesOffset = *reinterpret_cast<const u32*>(&image.data[image.sectionHeaders + namesIndex * 0x28 + 0x10]);
+	image.namesSize = *reinterpret_cast<const u32*>(&image.data[image.sectionHeaders + namesIndex * 0x28 + 0x14]);
 
-		}
+	return true;
 
-		HookMap& hooks = hookSymbols.getSymbolMap(a);
+}
 
-		for (auto it = hooks.begin(); it != hooks.end();) {
 
-			if (it->second.hookType != HookType::Replace) {
-				it++;
-				continue;
-			}
 
-			std::stringstream hookAddressStream;
-			hookAddressStream << "0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << it->second.hookAddress;
-			const std::string& hookAddress = hookAddressStream.str();
-			const std::string& section = ".over." + getCodeTargetName(it->second.codeTarget) + "." + hookAddress;
+void closeElfImage(ElfImage& image) {
 
-			linkerScript += "\t" + section + " " + hookAddress + " : SUBALIGN(1) {\n\t\t*(" + section + ")\n\t} AT>ldpatch\n\n";
+#ifdef _WIN32
 
-			it = hooks.erase(it);
+	if (image.data) {
+		UnmapViewOfFile(image.data);
+	}
 
-		}
+	if (image.mapping) {
+		CloseHandle(image.mapping);
+	}
 
-		linkerScript += "\t/DISCARD/ : {*(.*)}\n";
-		linkerScript += "}\n";
+	if (image.file != INVALID_HANDLE_VALUE) {
+		CloseHandle(image.file);
+	}
 
-		std::ofstream scriptFile(scriptPath, std::ios::out | std::ios::trunc);
+	image.mapping = nullptr;
+	image.file = INVALID_HANDLE_VALUE;
 
-		if (!scriptFile.is_open()) {
-			std::cout << DERROR << "Failed to open " << procName << " linker script file " << armLinkerFilename << std::endl;
-			return false;
-		}
+#else
 
-		scriptFile.write(linkerScript.c_str(), linkerScript.size());
-		scriptFile.close();
+	if (image.data) {
+		munmap(const_cast<u8*>(image.data), image.size);
+	}
+
+#endif
+
+	image.data = nullptr;
+	image.size = 0;
+
+}
+
+
+
+bool getElfSection(const ElfImage& image, u32 index, ElfSection& section) {
+
+	if (index >= image.sectionCount) {
+		return false;
+	}
+
+	u32 header = image.sectionHeaders + index * 0x28;
+
+	section.name = getElfString(image, image.namesOffset, image.namesSize, *reinterpret_cast<const u32*>(&image.data[header]));
+	section.type = *reinterpret_cast<const u32*>(&image.data[header + 0x04]);
+	section.flags = *reinterpret_cast<const u32*>(&image.data[header + 0x08]);
+	section.address = *reinterpret_cast<const u32*>(&image.data[header + 0x0C]);
+	section.offset = *reinterpret_cast<const u32*>(&image.data[header + 0x10]);
+	section.size = *reinterpret_cast<const u32*>(&image.data[header + 0x14]);
+	section.link = *reinterpret_cast<const u32*>(&image.data[header + 0x18]);
+	section.info = *reinterpret_cast<const u32*>(&image.data[header + 0x1C]);
+	section.align = *reinterpret_cast<const u32*>(&image.data[header + 0x20]);
+
+	return true;
+
+}
 
-		std::cout << DINFO << "Generated linker script " << armLinkerFilename << std::endl;
 
-	}
 
-	return true;
+bool getElfSymbol(const ElfImage& image, const ElfSection& symtab, const ElfSection& strtab, u32 index, ElfSymbol& symbol) {
+
+	u64 entry = static_cast<u64>(symtab.offset) + index * 0x10;
+
+	if (index >= symtab.size / 0x10 || entry + 0x10 > image.size) {
+		return false;
+	}
+
+	symbol.name = getElfString(image, strtab.offset, strtab.size, *reinterpret_cast<const u32*>(&image.data[entry]));
+	symbol.value = *reinterpret_cast<const u32*>(&image.data[entry + 0x04]);
+	symbol.size = *reinterpret_cast<const u32*>(&image.data[entry + 0x08]);
+	symbol.type = image.data[entry + 0x0C] & 0xF;
+	symbol.binding = image.data[entry + 0x0C] >> 4;
+	symbol.section = *reinterpret_cast<const u16*>(&image.data[entry + 0x0E]);
+
+	return true;
+
+}
+
+
+
+std::string_view getElfString(const ElfImage& image, u32 tableOffset, u32 tableSize, u32 offset) {
+
+	u64 tableEnd = std::min(static_cast<u64>(tableOffset) + tableSize, image.size);
+
+	if (static_cast<u64>(tableOffset) + offset >= tableEnd) {
+		return std::string_view();
+	}
+
+	const char* begin = reinterpret_cast<const char*>(&image.data[tableOffset + offset]);
+	const void* end = std::memchr(begin, '\0', tableEnd - tableOffset - offset);
+
+	//Unterminated strings are treated as missing rather than read past the table
+	return end ? std::string_view(begin, static_cast<const char*>(end) - begin) : std::string_view();
+
+}
+
+
+
+bool getElfData(const ElfImage& image, u32 offset, u32 size, const u8*& data) {
+
+	if (static_cast<u64>(offset) + size > image.size) {
+		return false;
+	}
+
+	data = &image.data[offset];
+
+	return true;
+
+}
+
+
 
+void closeLinkedImages(LinkedImages& images) {
+	closeElfImage(images.arm7);
+	closeElfImage(images.arm9);
 }
 
 
 
+bool createBuildDirectories(const BuildSettings& settings, FileTree& tree) {
 
-bool linkSource(const BuildSettings& settings) {
+	RETURN_ON_ERROR(createDirectory(settings.objectDir, "object"))
+	RETURN_ON_ERROR(createDirectory(settings.depsDir, "dependency"))
+	RETURN_ON_ERROR(scanFileTree(settings.objectDir, tree))
+	RETURN_ON_ERROR(scanFileTree(settings.depsDir, tree))
 
-	std::string libraryImport = settings.useAEABI ? " -lgcc -L" + settings.libraryDir.string() : "";
+	std::vector<const FileTreeEntry*> sourceEntries;
+	std::vector<fs::path> missingDirs;
 
-	for (u32 a = 0; a < 2; a++) {
+	listFileTree(tree, settings.sourceDir, sourceEntries);
 
-		const std::string& archName = a ? "arm9" : "arm7";
-		const fs::path& armLinkerFilename = settings.buildDir / (archName + ".x");
-		const fs::path& elfOutputFilename = settings.buildDir / (archName + ".elf");
+	for (const FileTreeEntry* entry : sourceEntries) {
 
-		if (!fs::exists(armLinkerFilename) || !fs::is_regular_file(armLinkerFilename)) {
+		if (entry->type != fs::file_type::directory) {
 			continue;
 		}
 
-		std::cout << DINFO << "Linking " << armLinkerFilename.string() << std::endl;
+		const fs::path& relativePath = entry->path.lexically_relative(settings.sourceDir);
 
-		std::string cmd = settings.executables.ld + " -T " + armLinkerFilename.string() + " --nmagic" + libraryImport + " -o " + elfOutputFilename.string();
-		s32 status = std::system(cmd.c_str());
+		for (const fs::path& dir : { settings.objectDir / relativePath, settings.depsDir / relativePath }) {
+
+			if (!findFileTreeEntry(tree, dir)) {
+				missingDirs.push_back(dir);
+			}
 
-		if (status) {
-			std::cout << DERROR << "Failed to link objects: Linker returned " << status << std::endl;
-			return false;
 		}
 
 	}
 
-	std::cout << DINFO << "Linking successful" << std::endl;
+	//Tree entries are ordered, so parents are always created before their subdirectories
+	for (const fs::path& dir : missingDirs) {
+
+		std::error_code ec;
+		fs::create_directory(dir, ec);
+
+		if (ec) {
+			std::cout << DERROR << "Failed to create build directory " << dir.string() << ": " << ec.message() << std::endl;
+			return false;
+		}
+
+		tree.entries[getFileTreeKey(dir)] = FileTreeEntry{ dir, fs::file_type::directory, 0, 0 };
+
+	}
 
 	return true;
 
@@ -1300,346 +6774,383 @@ bool linkSource(const BuildSettings& settings) {
 
 
 
-bool patchBinaries(const BuildSettings& buildSettings, const PatchSettings& patchSettings, OverlayTable& ovt, const std::vector<Fixup>& fixups) {
-
-	std::cout << DINFO << "Patching arm9.bin" << std::endl;
+void loadDependencies(const BuildSettings& settings, DependencyTracker& tracker) {
 
-	for (auto& e : fixups) {
+	std::cout << DINFO << "Loading dependencies" << std::endl;
 
-		if (std::holds_alternative<Patch>(e)) {
-			std::cout << DINFO << "Found patch: " << getCodeTargetName(std::get<Patch>(e).codeTarget) << ", start=0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << std::get<Patch>(e).ramAddress << ", size=0x" << std::get<Patch>(e).binSize << ", bss=0x" << std::get<Patch>(e).bssSize << std::endl;
-		} else {
-			std::cout << DINFO << "Found hook: " << getCodeTargetName(std::get<Hook>(e).codeTarget) << ", hook=0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << std::get<Hook>(e).hookAddress << std::endl;
-		}
+	fs::path trackerPath = settings.buildDir / "tracker.bin";
 
-	}
+	tracker.jsonLastModifiedTime = timeLastModified(jsonPath);
+	tracker.contentHash = settings.contentHash;
 
-	SectionMap sections;
+	if (fs::exists(trackerPath) && fs::is_regular_file(trackerPath) && fs::file_size(trackerPath) > 16) {
 
-	for (const auto& e : ovt) {
-		sections.emplace(e.first, SectionData{ e.second.start, e.second.start + e.second.size, 0 });
-	}
+		std::ifstream trackerFile(trackerPath, std::ios::in | std::ios::binary);
 
-	std::vector<u8> binary;
-	CodeTarget currentTarget = invalidTarget;
-	ARMBinaryProperties armBinaryProperties{};
-	std::vector<u8> safePatch;
-	u32 patchStart = 0;
+		if (!trackerFile.is_open()) {
+			std::cout << DERROR << "Failed to open tracking file " << trackerPath.string() << std::endl;
+			return;
+		}
 
+		u32 magic = 0;
+		u32 version = 0;
+		trackerFile.read(reinterpret_cast<char*>(&magic), 4);
+		trackerFile.read(reinterpret_cast<char*>(&version), 4);
 
-	for (u32 i = 0; i < fixups.size(); i++) {
+		if (magic != DependencyTracker::magic || version != DependencyTracker::version) {
+			std::cout << DINFO << "Tracking file format changed, rebuilding all sources" << std::endl;
+			return;
+		}
 
-		const Fixup& fix = fixups[i];
-		bool isPatch = std::holds_alternative<Patch>(fix);
-		CodeTarget newTarget = isPatch ? std::get<Patch>(fix).codeTarget : std::get<Hook>(fix).codeTarget;
+		trackerFile.read(reinterpret_cast<char*>(&tracker.jsonTrackedModifiedTime), 8);
 
-		if (newTarget != currentTarget) {
+		u32 fileCount = 0;
+		trackerFile.read(reinterpret_cast<char*>(&fileCount), 4);
+		tracker.files.resize(fileCount);
 
-			std::cout << DINFO << "Patching target " << getCodeTargetName(newTarget) << std::endl;
+		for (u32 i = 0; i < fileCount && trackerFile; i++) {
 
-			if (isBinary(currentTarget)) {
+			u16 length = 0;
+			trackerFile.read(reinterpret_cast<char*>(&length), 2);
 
-				RETURN_ON_ERROR(saveBinary(buildSettings, currentTarget, armBinaryProperties, binary, false))
+			std::string& entry = tracker.files[i];
+			entry.resize(length);
+			trackerFile.read(&entry[0], length);
 
-			} else if (isOverlay(currentTarget)) {
+			FileState state{};
+			trackerFile.read(reinterpret_cast<char*>(&state.time), 8);
+			trackerFile.read(reinterpret_cast<char*>(&state.size), 8);
+			trackerFile.read(reinterpret_cast<char*>(&state.hash), 8);
 
-				RETURN_ON_ERROR(saveOverlay(buildSettings, currentTarget, binary, ovt))
+			tracker.dependencies[entry] = state;
 
-			}
+		}
 
-			if (isBinary(newTarget)) {
+		u32 fingerprintCount = 0;
+		trackerFile.read(reinterpret_cast<char*>(&fingerprintCount), 4);
 
-				RETURN_ON_ERROR(loadBinary(buildSettings, newTarget, armBinaryProperties, binary))
-				RETURN_ON_ERROR(addBinarySections(sections, newTarget, armBinaryProperties, binary))
+		for (u32 i = 0; i < fingerprintCount && trackerFile; i++) {
 
-			} else if (isOverlay(newTarget)) {
+			u16 length = 0;
+			trackerFile.read(reinterpret_cast<char*>(&length), 2);
 
-				RETURN_ON_ERROR(loadOverlay(buildSettings, newTarget, binary))
+			std::string entry;
+			entry.resize(length);
+			trackerFile.read(&entry[0], length);
 
-			} else {
+			u64 fingerprint = 0;
+			u32 duration = 0;
+			trackerFile.read(reinterpret_cast<char*>(&fingerprint), 8);
+			trackerFile.read(reinterpret_cast<char*>(&duration), 4);
 
-				std::cout << DERROR << "Invalid target detected for " << (isPatch ? "patch" : "hook") << " at address 0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << (isPatch ? std::get<Patch>(fix).ramAddress : std::get<Hook>(fix).hookAddress) << std::endl;
-				return false;
+			tracker.fingerprints[entry] = fingerprint;
 
+			if (duration) {
+				tracker.durations[entry] = duration;
 			}
 
-			for (u32 j = i; j < fixups.size(); j++) {
+		}
 
-				const Fixup& peekFix = fixups[j];
-				bool peekIsPatch = std::holds_alternative<Patch>(peekFix);
-				CodeTarget peekTarget = peekIsPatch ? std::get<Patch>(peekFix).codeTarget : std::get<Hook>(peekFix).codeTarget;
+		u32 graphCount = 0;
+		bool graphValid = true;
+		trackerFile.read(reinterpret_cast<char*>(&graphCount), 4);
 
-				if (peekTarget != newTarget) {
-					break;
-				}
+		for (u32 i = 0; i < graphCount && trackerFile && graphValid; i++) {
 
-				if (peekIsPatch && std::get<Patch>(peekFix).bssSize != noBSS) {
-					patchStart = std::get<Patch>(peekFix).ramAddress;
-					break;
-				}
+			u32 sourceID = 0;
+			u32 depCount = 0;
+			trackerFile.read(reinterpret_cast<char*>(&sourceID), 4);
+			trackerFile.read(reinterpret_cast<char*>(&depCount), 4);
+
+			std::vector<u32> depIDs(depCount);
+			trackerFile.read(reinterpret_cast<char*>(depIDs.data()), depCount * 4);
+
+			graphValid = sourceID < fileCount && std::all_of(depIDs.begin(), depIDs.end(), [fileCount](u32 id) { return id < fileCount; });
 
+			if (graphValid) {
+				tracker.graph[tracker.files[sourceID]] = std::move(depIDs);
 			}
 
-			safePatch.clear();
-			currentTarget = newTarget;
+		}
 
+		if (!trackerFile || !graphValid) {
+			std::cout << DWARNING << "Tracking file " << trackerPath.string() << " is corrupted, rebuilding all sources" << std::endl;
+			tracker.files.clear();
+			tracker.dependencies.clear();
+			tracker.graph.clear();
+			tracker.fingerprints.clear();
+			tracker.durations.clear();
 		}
 
-		if (isPatch) {
+		trackerFile.close();
 
-			const Patch& patch = std::get<Patch>(fix);
+	}
 
-			std::vector<u8> data;
-			RETURN_ON_ERROR(loadPatch(buildSettings, patch, data))
+}
 
-			if (patch.bssSize == noBSS) {
 
-				write(sections, currentTarget, patch.ramAddress, data, binary);
 
-			} else {
 
-				if (isBinary(currentTarget)) {
 
-					bool arm9 = currentTarget == arm9Target;
-					u32 heapRelocation = (arm9 ? patchSettings.arm9.start : patchSettings.arm7.start) + patch.binSize + (patch.bssAlign - patch.binSize % patch.bssAlign) + patch.bssSize;
-					u32 totalPatchSize = patch.binSize + patch.bssSize;
-					u32 kbs = totalPatchSize / 1024;
-					u32 bytes = (totalPatchSize % 1024) * 10 / 1024;
+void trackDependencies(DependencyTracker& tracker, const fs::path& source, const fs::path& dep, bool old) {
 
-					std::cout << DINFO << "Relocating " << getCodeTargetName(currentTarget) << " heap to 0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << heapRelocation << std::dec << ", shrinking by " << kbs << "." << bytes << "KB" << std::endl;
+	std::string srcString = getPathString(source);
+	std::vector<std::string> paths;
 
-					std::copy(safePatch.begin(), safePatch.end(), data.begin());
-					writeWord(sections, currentTarget, arm9 ? patchSettings.arm9.reloc : patchSettings.arm7.reloc, heapRelocation, binary);
-					patchBinary(buildSettings, patch, data, armBinaryProperties, binary);
+	if (old) {
 
-				} else {
+		//Up-to-date units reuse the graph from the last build instead of reparsing their dependency file
+		for (u32 id : tracker.graph.at(srcString)) {
+			paths.push_back(tracker.files[id]);
+		}
 
-					std::cout << DWARNING << "Not yet implemented: Patches for targets other than arm7/arm9" << std::endl;
+	} else {
 
-				}
+		if (!fs::exists(dep) || !fs::is_regular_file(dep)) {
+			std::cout << DWARNING << "Dependency file " << dep.string() << " not generated, disabling dependency tracking for target" << std::endl;
+			return;
+		}
 
-			}
+		if (!parseDependencyFile(dep, paths)) {
+			return;
+		}
 
-		} else {
+	}
 
-			const Hook& hook = std::get<Hook>(fix);
+	if (std::find(paths.begin(), paths.end(), srcString) == paths.end()) {
+		paths.push_back(srcString);
+	}
 
-			u32 hookAddress = hook.hookAddress;
-			u32 funcAddress = hook.funcAddress;
+	for (const std::string& path : paths) {
 
-			bool hookThumb = hookAddress & 1;
-			bool funcThumb = funcAddress & 1;
-			hookAddress &= ~1;
-			funcAddress &= ~1;
+		FileState state{};
 
-			if (!hookThumb && (hookAddress % 4) == 2) {
-				std::cout << DWARNING << "Address 0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << " is not a valid ARM address: Did you forget to set the thumb bit?" << std::endl;
-				continue;
-			}
+		if (!tracker.trackers.contains(path) && queryFileState(tracker, path, state)) {
+			tracker.trackers[path] = state;
+		}
+
+	}
 
-			std::cout << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << hookAddress << ", " << funcAddress << std::endl;
+	tracker.graphTrackers[srcString] = std::move(paths);
 
-			switch (hook.hookType) {
+}
 
-				case HookType::Hook:
 
-					if (!hookThumb && !funcThumb) {
 
-						s32 signedOffset = (funcAddress - hookAddress - 8) / 4;
-						u32 opcode = COND_AL | ARM_B | (signedOffset & 0xFFFFFF);
-						writeWord(sections, currentTarget, hookAddress, opcode, binary);
+bool parseDependencyFile(const fs::path& dep, std::vector<std::string>& paths) {
 
-					} else if (!hookThumb && funcThumb) {
+	std::ifstream depsFile(dep, std::ios::in | std::ios::binary);
 
-						std::cout << DWARNING << "Error in hook from 0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << hook.hookAddress << " to 0x" << hook.funcAddress << ": Cannot create opcode 'b' for ARM -> Thumb transition" << std::endl;
-						break;
+	if (!depsFile.is_open()) {
+		std::cout << DERROR << "Failed to open dependency file " << dep.string() << std::endl;
+		return false;
+	}
 
-					} else if (hookThumb && !funcThumb) {
+	std::string content;
+	content.resize(fs::file_size(dep));
+	depsFile.read(content.data(), content.size());
+	depsFile.close();
 
-						std::cout << DWARNING << "Error in hook from 0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << hook.hookAddress << " to 0x" << hook.funcAddress << ": Cannot create opcode 'b' for Thumb -> ARM transition" << std::endl;
-						break;
+	//Skip the rule target, which may itself contain a drive letter colon
+	u64 i = 0;
 
-					} else {
+	while (i < content.size() && !(content[i] == ':' && (i + 1 == content.size() || std::isspace(static_cast<u8>(content[i + 1]))))) {
+		i++;
+	}
 
-						std::cout << DWARNING << "Error in hook from 0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << hook.hookAddress << " to 0x" << hook.funcAddress << ": Cannot create opcode 'b' for Thumb -> Thumb transition" << std::endl;
-						break;
+	std::string path;
+	i++;
 
-					}
+	for (; i < content.size(); i++) {
 
-					break;
+		char c = content[i];
 
-				case HookType::Link:
+		if (c == '\\' && i + 1 < content.size()) {
 
-					if (hookThumb != funcThumb && !isARM9Target(currentTarget)) {
-						std::cout << DWARNING << "Cannot create thumb-interworking veneer: blx not supported on armv4" << std::endl;
-						break;
-					}
+			char next = content[i + 1];
 
-					if (!hookThumb && !funcThumb) {
+			if (next == '\n' || next == '\r') {
 
-						s32 signedOffset = (funcAddress - hookAddress - 8) / 4;
-						u32 opcode = COND_AL | ARM_BL | (signedOffset & 0xFFFFFF);
-						writeWord(sections, currentTarget, hookAddress, opcode, binary);
+				//Line continuation
+				i += (next == '\r' && i + 2 < content.size() && content[i + 2] == '\n') ? 2 : 1;
+				c = ' ';
 
-					} else if (!hookThumb && funcThumb) {
+			} else if (next == ' ' || next == ':' || next == '#') {
 
-						s32 signedOffset = (funcAddress - hookAddress - 8) / 4;
-						u32 opcode = ARM_BLX | ((funcAddress % 4 / 2) << 23) | (signedOffset & 0xFFFFFF);
-						writeWord(sections, currentTarget, hookAddress, opcode, binary);
+				//Escaped character, including GCC's escaped drive letter colon
+				path += next;
+				i++;
+				continue;
 
-					} else if (hookThumb && !funcThumb) {
+			}
 
-						s32 signedOffset = (funcAddress - hookAddress - 4) / 2;
-						u16 opcode0 = THUMB_BL0 | (signedOffset & 0x3FF800) >> 11;
-						u16 opcode1 = THUMB_BLX1 | (signedOffset & 0x7FF);
-						writeWord(sections, currentTarget, hookAddress, opcode1 << 16 | opcode0, binary);
+		}
 
-					} else {
+		if (c == '\n' || c == '\r') {
+			break;
+		}
 
-						s32 signedOffset = (funcAddress - hookAddress - 4) / 2;
-						u16 opcode0 = THUMB_BL0 | (signedOffset & 0x3FF800) >> 11;
-						u16 opcode1 = THUMB_BL1 | (signedOffset & 0x7FF);
-						writeWord(sections, currentTarget, hookAddress, opcode1 << 16 | opcode0, binary);
+		if (c == ' ' || c == '\t') {
 
-					}
+			if (!path.empty()) {
+				paths.push_back(getPathString(path));
+				path.clear();
+			}
 
-					break;
+		} else {
 
-				case HookType::Safe:
+			path += c;
 
-					if (!hookThumb) {
+		}
 
-						if (funcThumb && !isARM9Target(currentTarget)) {
-							std::cout << DWARNING << "Cannot create thumb-interworking veneer: blx (immediate) not supported on armv4" << std::endl;
-							break;
-						}
+	}
 
-						u32 safeOffset = safePatch.size();
-						s32 signedOffset0 = (patchStart + safeOffset - hookAddress - 8) / 4;
-						s32 signedOffset1 = (funcAddress - patchStart - safeOffset - 16) / 4;
-						s32 signedOffset2 = (hookAddress - patchStart - safeOffset - 20) / 4;
+	if (!path.empty()) {
+		paths.push_back(getPathString(path));
+	}
 
-						u32 hookOpcode = COND_AL | ARM_B | (signedOffset0 & 0xFFFFFF);
-						u32 replaceOpcode = readWord(sections, currentTarget, hookAddress, binary);
-						checkSafeInstruction(replaceOpcode);
+	return true;
 
-						u32 opcode0 = replaceOpcode;
-						u32 opcode1 = COND_AL | ARM_PUSH | 0xD5FFF;
-						u32 opcode2 = COND_AL | (funcThumb ? ARM_BLX : ARM_BL) | (signedOffset1 & 0xFFFFFF);
-						u32 opcode3 = COND_AL | ARM_POP | 0xD5FFF;
-						u32 opcode4 = COND_AL | ARM_B | (signedOffset2 & 0xFFFFFF);
+}
 
-						writeWord(sections, currentTarget, hookAddress, hookOpcode, binary);
 
-						safePatch.resize(safeOffset + 20);
-						*reinterpret_cast<u32*>(&safePatch[safeOffset]) = opcode0;
-						*reinterpret_cast<u32*>(&safePatch[safeOffset + 4]) = opcode1;
-						*reinterpret_cast<u32*>(&safePatch[safeOffset + 8]) = opcode2;
-						*reinterpret_cast<u32*>(&safePatch[safeOffset + 12]) = opcode3;
-						*reinterpret_cast<u32*>(&safePatch[safeOffset + 16]) = opcode4;
 
-					} else {
-						std::cout << DERROR << "Fatal error: Safe hook hooked in Thumb mode" << std::endl;
-					}
 
-					break;
+void saveDependencies(const BuildSettings& settings, DependencyTracker& tracker) {
 
-				default:
-					break;
+	fs::path trackerPath = settings.buildDir / "tracker.bin";
 
-			}
+	if (fs::exists(trackerPath) && fs::is_regular_file(trackerPath)) {
+		removeFile(trackerPath, "tracker");
+	}
 
-		}
+	std::ofstream trackerFile(trackerPath, std::ios::out | std::ios::binary);
 
+	if (!trackerFile.is_open()) {
+		std::cout << DERROR << "Failed to open tracking file " << trackerPath.string() << std::endl;
+		return;
 	}
 
-	if (isBinary(currentTarget)) {
+	trackerFile.write(reinterpret_cast<const char*>(&DependencyTracker::magic), 4);
+	trackerFile.write(reinterpret_cast<const char*>(&DependencyTracker::version), 4);
+	trackerFile.write(reinterpret_cast<const char*>(&tracker.jsonLastModifiedTime), 8);
+
+	std::unordered_map<std::string, u32> fileIDs;
+	u32 fileCount = tracker.trackers.size();
+	trackerFile.write(reinterpret_cast<const char*>(&fileCount), 4);
 
-		RETURN_ON_ERROR(saveBinary(buildSettings, currentTarget, armBinaryProperties, binary, false))
+	for (auto& e : tracker.trackers) {
 
-	} else if (isOverlay(currentTarget)) {
+		const std::string& path = e.first;
+		u16 length = path.length();
+		const FileState& state = e.second;
+		trackerFile.write(reinterpret_cast<const char*>(&length), 2);
+		trackerFile.write(reinterpret_cast<const char*>(&path[0]), length);
+		trackerFile.write(reinterpret_cast<const char*>(&state.time), 8);
+		trackerFile.write(reinterpret_cast<const char*>(&state.size), 8);
+		trackerFile.write(reinterpret_cast<const char*>(&state.hash), 8);
 
-		RETURN_ON_ERROR(saveOverlay(buildSettings, currentTarget, binary, ovt))
+		fileIDs[path] = fileIDs.size();
 
 	}
 
-	return true;
+	u32 fingerprintCount = tracker.fingerprintTrackers.size();
+	trackerFile.write(reinterpret_cast<const char*>(&fingerprintCount), 4);
 
-}
+	for (auto& e : tracker.fingerprintTrackers) {
 
+		const std::string& path = e.first;
+		u16 length = path.length();
+		u32 duration = tracker.durationTrackers.contains(path) ? tracker.durationTrackers.at(path) : 0;
+		trackerFile.write(reinterpret_cast<const char*>(&length), 2);
+		trackerFile.write(reinterpret_cast<const char*>(&path[0]), length);
+		trackerFile.write(reinterpret_cast<const char*>(&e.second), 8);
+		trackerFile.write(reinterpret_cast<const char*>(&duration), 4);
 
+	}
 
+	//Units with a missing file in their graph are left out so they get rebuilt next time
+	std::vector<std::pair<u32, std::vector<u32>>> graph;
 
-bool generateFileIDs(const BuildSettings& settings, const DependencyTracker& tracker, const OverlayTable& ovt, const FileIDSymbols& fidSymbols) {
+	for (auto& e : tracker.graphTrackers) {
 
-	const fs::path& fidPath = settings.toolchainDir / "internal" / "fid.h";
+		std::vector<u32> depIDs;
 
-	if (!jsonChanged(tracker)) {
-		return true;
-	}
+		for (const std::string& path : e.second) {
 
-	std::cout << DINFO << "Generating file ID symbols" << std::endl;
+			if (!fileIDs.contains(path)) {
+				break;
+			}
 
-	const std::string& fntFilename = "fnt.bin";
+			depIDs.push_back(fileIDs.at(path));
 
-	const fs::path& fntPath = settings.nitroFSDir / fntFilename;
-	u32 fntSize = fs::file_size(fntPath);
-	std::vector<u8> fnt;
+		}
 
-	std::ifstream fntFile(fntPath, std::ios::in | std::ios::binary);
+		if (depIDs.size() == e.second.size()) {
+			graph.emplace_back(fileIDs.at(e.first), std::move(depIDs));
+		}
 
-	if (!fntFile.is_open()) {
-		std::cout << DERROR << "Failed to open filename table " << fntPath.string() << std::endl;
-		return false;
 	}
 
-	fnt.resize(fntSize);
-	fntFile.read(reinterpret_cast<char*>(fnt.data()), fntSize);
-	fntFile.close();
+	u32 graphCount = graph.size();
+	trackerFile.write(reinterpret_cast<const char*>(&graphCount), 4);
 
-	u16 freeOverlayFileID = 0;
+	for (auto& e : graph) {
+
+		u32 depCount = e.second.size();
+		trackerFile.write(reinterpret_cast<const char*>(&e.first), 4);
+		trackerFile.write(reinterpret_cast<const char*>(&depCount), 4);
+		trackerFile.write(reinterpret_cast<const char*>(e.second.data()), depCount * 4);
 
-	for (const auto& e : ovt) {
-		freeOverlayFileID = std::max(static_cast<u32>(freeOverlayFileID), e.second.fileID + 1);
 	}
 
-	NDSDirectory rootDir = NFSFSH::readFntTree(fnt);
-	u16 freeFileID = std::max(freeOverlayFileID, NFSFSH::findNextFreeFileID(rootDir));
-	u16 freeDirID = NFSFSH::findNextFreeDirID(rootDir);
+	trackerFile.close();
 
-	NFSFSH::addNewFiles(rootDir, settings.nitroFSDir / "root", freeFileID, freeDirID);
+}
 
-	std::unordered_map<std::string, u16> fids;
 
-	for (const auto& e : fidSymbols) {
 
-		const std::string& symbol = e.first;
-		const fs::path& filePath = e.second;
 
-		fids[symbol] = NFSFSH::getFileID(rootDir, fs::relative(filePath, settings.nitroFSDir / "root"));
+bool initObjectCache(const BuildSettings& settings, ObjectCache& cache) {
 
+	if (settings.cacheDir.empty()) {
+		cache.enabled = false;
+		return true;
 	}
 
-	std::ofstream fidFile(fidPath, std::ios::out | std::ios::trunc);
+	std::error_code ec;
+	fs::create_directories(settings.cacheDir, ec);
 
-	if (!fidFile.is_open()) {
-		std::cout << DERROR << "Failed to open FID file " << fidPath.string() << std::endl;
+	if (ec) {
+		std::cout << DERROR << "Failed to create object cache directory " << settings.cacheDir.string() << ": " << ec.message() << std::endl;
 		return false;
 	}
 
-	fidFile << "#ifndef FID_H\n#define FID_H\n\n";
-	fidFile << "/* Auto-generated File ID symbols */\n";
-	fidFile << "#ifndef __FFC_LANG_ASM\n\n";
-	fidFile << "\tnamespace FID {\n\n";
+	RETURN_ON_ERROR(hashFile(settings.executables.gcc, cache.compilerHash))
+
+	//Paths below the project root are stripped so that worktrees of the same project share cache entries
+	const fs::path& root = fs::current_path();
+	std::string escapedRoot = root.string();
+
+	for (u32 i = 0; i < escapedRoot.size(); i++) {
+
+		if (escapedRoot[i] == '\\') {
+			escapedRoot.insert(i++, 1, '\\');
+		}
 
-	for (const auto& e : fids) {
-		fidFile << "\t\tconstexpr unsigned short " << e.first << " = " << e.second << ";\n";
 	}
 
-	fidFile << "\n\t};\n";
-	fidFile << "\n#endif\n";
-	fidFile << "\n#endif  // FID_H";
-	fidFile.close();
+	cache.basePaths = { escapedRoot, root.string(), getPathString(root) };
+
+	//Debug information and __FILE__ would otherwise still carry the root of the worktree that filled the entry
+	cache.flags = { "-ffile-prefix-map=" + root.string() + "=." };
+	cache.directory = settings.cacheDir;
+	cache.maxSize = settings.cacheMaxSize;
+	cache.hits = 0;
+	cache.misses = 0;
+	cache.enabled = true;
+
+	std::cout << DINFO << "Using object cache " << cache.directory.string() << std::endl;
 
 	return true;
 
@@ -1647,240 +7158,276 @@ bool generateFileIDs(const BuildSettings& settings, const DependencyTracker& tra
 
 
 
+bool getCacheKey(const ObjectCache& cache, const fs::path& preprocessedPath, const std::vector<std::string>& args, u64& key) {
 
-void write(const SectionMap& sections, CodeTarget target, u32 address, const std::vector<u8>& data, std::vector<u8>& binary) {
+	std::ifstream preprocessedFile(preprocessedPath, std::ios::in | std::ios::binary);
 
-	u32 offset = 0;
+	if (!preprocessedFile.is_open()) {
+		std::cout << DWARNING << "Failed to open preprocessed file " << preprocessedPath.string() << ", bypassing object cache" << std::endl;
+		return false;
+	}
 
-	if (!getSectionAddressOffset(sections, target, address, data.size(), offset)) {
-		std::cout << DWARNING << "Address 0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << address << " not in section " << getCodeTargetName(target) << std::endl;
-		return;
+	std::string source;
+	source.resize(fs::file_size(preprocessedPath));
+	preprocessedFile.read(source.data(), source.size());
+	preprocessedFile.close();
+
+	std::string cmd;
+
+	for (u32 i = 1; i < args.size(); i++) {
+		cmd += args[i];
+		cmd += '\0';
 	}
 
-	std::copy(data.begin(), data.end(), binary.begin() + offset);
+	normalizeCachePaths(cache, source);
+	normalizeCachePaths(cache, cmd);
 
-}
+	u64 cmdHash = hashData(reinterpret_cast<const u8*>(cmd.data()), cmd.size(), cache.compilerHash);
+	key = hashData(reinterpret_cast<const u8*>(source.data()), source.size(), cmdHash);
 
+	return true;
 
+}
 
-void writeHalfword(const SectionMap& sections, CodeTarget target, u32 address, u16 value, std::vector<u8>& binary) {
 
-	u32 offset = 0;
 
-	if (!getSectionAddressOffset(sections, target, address, 2, offset)) {
-		std::cout << DWARNING << "Address 0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << address << " not in section " << getCodeTargetName(target) << std::endl;
-		return;
-	}
+void normalizeCachePaths(const ObjectCache& cache, std::string& s) {
 
-	*reinterpret_cast<u16*>(&binary[offset]) = value;
+	for (const std::string& basePath : cache.basePaths) {
 
-}
+		if (basePath.empty()) {
+			continue;
+		}
 
+		std::string normalized;
+		normalized.reserve(s.size());
 
+		u64 offset = 0;
+		u64 match = 0;
 
-void writeWord(const SectionMap& sections, CodeTarget target, u32 address, u32 value, std::vector<u8>& binary) {
+		while ((match = s.find(basePath, offset)) != std::string::npos) {
+			normalized.append(s, offset, match - offset);
+			offset = match + basePath.size();
+		}
 
-	u32 offset = 0;
+		normalized.append(s, offset);
+		s.swap(normalized);
 
-	if (!getSectionAddressOffset(sections, target, address, 4, offset)) {
-		std::cout << DWARNING << "Address 0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << address << " not in section " << getCodeTargetName(target) << std::endl;
-		return;
 	}
 
-	*reinterpret_cast<u32*>(&binary[offset]) = value;
-
 }
 
 
 
-u32 readWord(const SectionMap& sections, CodeTarget target, u32 address, std::vector<u8>& binary) {
+fs::path getCachePath(const ObjectCache& cache, u64 key) {
 
-	u32 offset = 0;
+	std::stringstream ss;
+	ss << std::hex << std::uppercase << std::setw(16) << std::setfill('0') << key;
 
-	if (!getSectionAddressOffset(sections, target, address, 4, offset)) {
-		std::cout << DWARNING << "Address 0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << address << " not in section " << getCodeTargetName(target) << std::endl;
-		return 0;
-	}
+	const std::string& name = ss.str();
 
-	return *reinterpret_cast<u32*>(&binary[offset]);
+	return cache.directory / name.substr(0, 2) / (name.substr(2) + ".o");
 
 }
 
 
 
-bool fixBinarySections(SectionMap& sections, CodeTarget target, u32 offset) {
+bool fetchCachedObject(const ObjectCache& cache, u64 key, const fs::path& objectPath) {
 
-	if (!isBinary(target)) {
-		std::cout << DERROR << "Target " << getCodeTargetName(target) << " does not represent a valid ARM binary target" << std::endl;
+	const fs::path& cachePath = getCachePath(cache, key);
+	std::error_code ec;
+
+	if (!fs::is_regular_file(cachePath, ec)) {
 		return false;
 	}
 
-	auto targetIt = sections.equal_range(target);
-
-	for (auto& it = targetIt.first; it != targetIt.second; it++) {
-
-		if (it->second.destination) {
-			it->second.destination += offset;
-		}
+	fs::copy_file(cachePath, objectPath, fs::copy_options::overwrite_existing, ec);
 
+	if (ec) {
+		std::cout << DWARNING << "Failed to restore cached object " << cachePath.string() << ": " << ec.message() << std::endl;
+		return false;
 	}
 
+	//The modification time of cache entries serves as their LRU timestamp
+	fs::last_write_time(cachePath, fs::file_time_type::clock::now(), ec);
+
 	return true;
 
 }
 
 
 
+void storeCachedObject(const ObjectCache& cache, u64 key, const fs::path& objectPath) {
 
-bool addBinarySections(SectionMap& sections, CodeTarget target, const ARMBinaryProperties& properties, const std::vector<u8>& binary) {
+	const fs::path& cachePath = getCachePath(cache, key);
+	fs::path tempPath = cachePath;
+	tempPath += "." + std::to_string(std::random_device()()) + ".tmp";
+	std::error_code ec;
 
-	if (!isBinary(target)) {
-		std::cout << DERROR << "Target " << getCodeTargetName(target) << " does not represent a valid ARM binary target" << std::endl;
-		return false;
+	fs::create_directory(cachePath.parent_path(), ec);
+	fs::copy_file(objectPath, tempPath, fs::copy_options::overwrite_existing, ec);
+
+	//Renaming keeps concurrent builds from reading partially written entries
+	if (!ec) {
+		fs::rename(tempPath, cachePath, ec);
 	}
 
-	sections.emplace(target, SectionData{ properties.offset, properties.offset + properties.autoloadRead, 0 });
-	u32 readPtr = properties.autoloadRead;
+	if (ec) {
+		std::cout << DWARNING << "Failed to store " << objectPath.string() << " in object cache: " << ec.message() << std::endl;
+		fs::remove(tempPath, ec);
+	}
 
-	for (u32 i = 0; i < (properties.autoloadEnd - properties.autoloadStart) / 12; i++) {
+}
 
-		u32 start = *reinterpret_cast<const u32*>(&binary[properties.autoloadStart + i * 12]);
-		u32 size = *reinterpret_cast<const u32*>(&binary[properties.autoloadStart + i * 12 + 4]);
 
-		sections.emplace(target, SectionData{ start, start + size, readPtr });
-		readPtr += size;
 
-	}
+void trimObjectCache(const ObjectCache& cache) {
 
-	return true;
+	struct CacheEntry {
+		fs::path path;
+		fs::file_time_type time;
+		u64 size;
+	};
 
-}
+	std::vector<CacheEntry> entries;
+	u64 cacheSize = 0;
+	std::error_code ec;
 
+	for (const fs::directory_entry& entry : fs::recursive_directory_iterator(cache.directory, ec)) {
 
+		if (entry.is_regular_file(ec) && entry.path().extension() == ".o") {
 
+			u64 size = entry.file_size(ec);
+			entries.push_back(CacheEntry{ entry.path(), entry.last_write_time(ec), size });
+			cacheSize += size;
 
-bool loadBinary(const BuildSettings& settings, CodeTarget target, ARMBinaryProperties& properties, std::vector<u8>& binary) {
+		}
 
-	if (!isBinary(target)) {
-		std::cout << DERROR << "Target " << getCodeTargetName(target) << " does not represent a valid ARM binary target" << std::endl;
-		return false;
 	}
 
-	fs::path armPath = settings.backupDir / (getCodeTargetName(target) + ".bin");
-	u32 armSize = fs::file_size(armPath);
+	if (cacheSize <= cache.maxSize) {
+		return;
+	}
+
+	std::sort(entries.begin(), entries.end(), [](const CacheEntry& a, const CacheEntry& b) {
+		return a.time < b.time;
+	});
 
-	std::ifstream armFile(armPath, std::ios::in | std::ios::binary);
+	//Trim to 90% to avoid evicting on every subsequent build
+	u64 targetSize = cache.maxSize / 10 * 9;
+	u64 trimmedSize = 0;
 
-	if (!armFile.is_open()) {
-		std::cout << DERROR << "Failed to open ARM binary file " << armPath.string() << std::endl;
-		return false;
-	}
+	for (const CacheEntry& entry : entries) {
 
-	binary.resize(armSize);
-	armFile.read(reinterpret_cast<char*>(binary.data()), armSize);
-	armFile.close();
+		if (cacheSize <= targetSize) {
+			break;
+		}
 
-	RETURN_ON_ERROR(loadARMBinaryProperties(settings, target, binary, properties))
+		if (fs::remove(entry.path, ec)) {
+			cacheSize -= entry.size;
+			trimmedSize += entry.size;
+		}
 
-	return true;
+	}
+
+	std::cout << DINFO << "Evicted " << (trimmedSize >> 10) << "KB from object cache" << std::endl;
 
 }
 
 
 
 
-void patchBinary(const BuildSettings& settings, const Patch& patchInfo, const std::vector<u8>& patch, const ARMBinaryProperties& properties, std::vector<u8>& binary) {
+bool needsCompilation(DependencyTracker& tracker, const fs::path& source, const fs::path& objectPath, u64 fingerprint) {
 
-	u32 patchSize = patch.size();
-	binary.resize(binary.size() + patchInfo.binSize + 12);
+	std::string srcString = getPathString(source);
+	FileState state{};
 
-	std::copy(binary.begin() + properties.autoloadStart, binary.begin() + properties.autoloadEnd, binary.begin() + properties.autoloadStart + patchSize + 12);
-	std::copy(binary.begin() + properties.autoloadRead, binary.begin() + properties.autoloadStart, binary.begin() + properties.autoloadRead + patch.size());
-	std::copy(patch.begin(), patch.end(), binary.begin() + properties.autoloadRead);
+	if (!tracker.fingerprints.contains(srcString) || tracker.fingerprints.at(srcString) != fingerprint) {
+		return true;
+	}
 
-	*reinterpret_cast<u32*>(&binary[properties.autoloadStart + patchSize]) = patchInfo.ramAddress;
-	*reinterpret_cast<u32*>(&binary[properties.autoloadStart + patchSize + 4]) = patchInfo.binSize;
-	*reinterpret_cast<u32*>(&binary[properties.autoloadStart + patchSize + 8]) = patchInfo.bssSize;
+	if (!tracker.graph.contains(srcString)) {
+		return true;
+	}
 
-	*reinterpret_cast<u32*>(&binary[properties.moduleParams]) = properties.offset + properties.autoloadStart + patchSize;
-	*reinterpret_cast<u32*>(&binary[properties.moduleParams + 4]) = properties.offset + properties.autoloadEnd + patchSize + 12;
+	if (!queryFileState(tracker, srcString, state) || fileChanged(tracker, srcString, state)) {
+		return true;
+	}
 
-}
+	const FileTreeEntry* objectEntry = tracker.fileTree ? findFileTreeEntry(*tracker.fileTree, objectPath) : nullptr;
+	std::error_code ec;
 
+	if (objectEntry ? objectEntry->type != fs::file_type::regular : !fs::is_regular_file(objectPath, ec)) {
+		return true;
+	}
 
+	for (u32 id : tracker.graph.at(srcString)) {
 
+		const std::string& path = tracker.files[id];
 
-bool saveBinary(const BuildSettings& settings, CodeTarget target, const ARMBinaryProperties& properties, std::vector<u8>& binary, bool compress) {
+		if (!queryFileState(tracker, path, state) || fileChanged(tracker, path, state)) {
+			V_PRINT("Dependency " << path << " changed")
+			return true;
+		}
 
-	if (!isBinary(target)) {
-		std::cout << DERROR << "Target " << getCodeTargetName(target) << " does not represent a valid ARM binary target" << std::endl;
-		return false;
 	}
 
-	fs::path armPath = settings.nitroFSDir / (getCodeTargetName(target) + ".bin");
-	u32 finalSize = binary.size();
+	return false;
 
-	if (compress) {
+}
 
-		std::cout << DINFO << "Recompressing ARM binary file " << armPath.string() << std::endl;
 
-		u32 blockSize = target == arm9Target ? 0x4000 : 0x400;
-		u32 nextCompressableBlock = ((properties.offset + blockSize - 1) / blockSize) * blockSize;
 
-		if (nextCompressableBlock - properties.offset < (blockSize / 4)) {
-			nextCompressableBlock += blockSize;
-		}
+bool queryFileState(DependencyTracker& tracker, const std::string& path, FileState& state) {
 
-		nextCompressableBlock -= properties.offset;
+	if (tracker.fileStates.contains(path)) {
+		state = tracker.fileStates.at(path);
+		return true;
+	}
 
-		if (nextCompressableBlock > binary.size()) {
-			std::cout << DERROR << "Cannot compress " << getCodeTargetName(target) << ".bin: Requested offset exceeds " << getCodeTargetName(target) << ".bin size" << std::endl;
+	const FileTreeEntry* treeEntry = tracker.fileTree ? findFileTreeEntry(*tracker.fileTree, path) : nullptr;
+
+	if (treeEntry) {
+
+		if (treeEntry->type != fs::file_type::regular) {
 			return false;
 		}
 
-		std::vector<u8> armc(binary.begin() + nextCompressableBlock, binary.end());
+		state.time = treeEntry->time;
+		state.size = treeEntry->size;
 
-		BLZ::compress(armc);
+	} else {
 
-		finalSize = nextCompressableBlock + armc.size();
+		std::error_code ec;
+		fs::directory_entry entry(path, ec);
 
-		if (finalSize > binary.size()) {
-			std::cout << DERROR << "Cannot BLZ compress " << getCodeTargetName(target) << ".bin: Compression non-effective" << std::endl;
+		if (ec || !entry.is_regular_file(ec)) {
 			return false;
 		}
 
-		std::copy(armc.begin(), armc.end(), binary.begin() + nextCompressableBlock);
-		*reinterpret_cast<u32*>(&binary[properties.moduleParams + 0x14]) = finalSize + properties.offset;
+		state.time = std::chrono::duration_cast<std::chrono::milliseconds>(entry.last_write_time(ec).time_since_epoch()).count();
+		state.size = entry.file_size(ec);
 
 	}
 
-	std::ofstream armFile(armPath, std::ios::out | std::ios::binary | std::ios::trunc);
+	state.hash = 0;
 
-	if (!armFile.is_open()) {
-		std::cout << DERROR << "Failed to open " << armPath.string() << std::endl;
-		return false;
-	}
+	if (tracker.dependencies.contains(path)) {
 
-	armFile.write(reinterpret_cast<const char*>(binary.data()), finalSize);
-	armFile.close();
+		const FileState& trackedState = tracker.dependencies.at(path);
 
-	fs::path headerPath = settings.nitroFSDir / "header.bin";
+		//Only rehash when the timestamp or size suggests an edit
+		if (trackedState.time == state.time && trackedState.size == state.size) {
+			state.hash = trackedState.hash;
+		}
 
-	if (!fs::exists(headerPath) || !fs::is_regular_file(headerPath)) {
-		std::cout << DERROR << "Fatal error: header.bin not found" << std::endl;
-		return false;
 	}
 
-	std::fstream headerFile(headerPath, std::ios::in | std::ios::out | std::ios::binary);
-
-	if (!headerFile.is_open()) {
-		std::cout << DERROR << "Failed to open header.bin" << std::endl;
+	if (tracker.contentHash && !state.hash && !hashFile(path, state.hash)) {
 		return false;
 	}
 
-	headerFile.seekp(0x2C + (target != arm9Target) * 0x10);
-	headerFile.write(reinterpret_cast<const char*>(&finalSize), 4);
-	headerFile.close();
+	tracker.fileStates[path] = state;
 
 	return true;
 
@@ -1888,176 +7435,172 @@ bool saveBinary(const BuildSettings& settings, CodeTarget target, const ARMBinar
 
 
 
-bool loadOverlay(const BuildSettings& settings, CodeTarget target, std::vector<u8>& binary) {
+bool fileChanged(const DependencyTracker& tracker, const std::string& path, const FileState& state) {
 
-	if (!isOverlay(target)) {
-		std::cout << DERROR << "Target " << getCodeTargetName(target) << " does not represent a valid overlay target" << std::endl;
-		return false;
+	if (!tracker.dependencies.contains(path)) {
+		return true;
 	}
 
-	u32 ovID = getOverlayID(target);
+	const FileState& trackedState = tracker.dependencies.at(path);
 
-	const std::string& ovPrefix = "overlay" + getProcessorID(target);
-	const fs::path& overlayDir = settings.backupDir / ovPrefix;
-	const std::string& overlayFilename = ovPrefix + "_" + std::to_string(ovID) + ".bin";
-	const fs::path& overlayPath = overlayDir / overlayFilename;
-	u32 overlaySize = fs::file_size(overlayPath);
+	if (tracker.contentHash) {
+		return state.size != trackedState.size || state.hash != trackedState.hash;
+	} else {
+		return state.time != trackedState.time;
+	}
 
-	std::ifstream overlayFile(overlayPath, std::ios::in | std::ios::binary);
+}
 
-	if (!overlayFile.is_open()) {
-		std::cout << DERROR << "Failed to open overlay file " << overlayPath.string() << std::endl;
-		return false;
-	}
 
-	binary.resize(overlaySize);
-	overlayFile.read(reinterpret_cast<char*>(binary.data()), overlaySize);
-	overlayFile.close();
 
-	return true;
+void deleteUnreferencedObjects(const BuildSettings& settings, const DependencyTracker& tracker, const FileTree& tree) {
 
-}
+	std::vector<fs::path> purgePaths;
+	std::vector<fs::path> purgeDirs;
+	std::vector<const FileTreeEntry*> entries;
 
+	listFileTree(tree, settings.objectDir, entries);
 
+	for (const FileTreeEntry* entry : entries) {
 
-bool saveOverlay(const BuildSettings& settings, CodeTarget target, std::vector<u8>& binary, OverlayTable& ovt) {
+		const fs::path& relativePath = entry->path.lexically_relative(settings.objectDir);
 
-	if (!isOverlay(target)) {
-		std::cout << DERROR << "Target " << getCodeTargetName(target) << " does not represent a valid overlay target" << std::endl;
-		return false;
-	}
+		if (entry->type == fs::file_type::regular) {
 
-	OverlayEntry& entry = ovt[target];
+			if (!tracker.compilationObjects.contains(getPathString(entry->path))) {
 
-	//if (entry.flags & OverlayEntry::compressFlag) {
-	//	std::cout << DINFO << "Compressing overlay " << getCodeTargetName(target) << std::endl;
-	//	BLZ::compress(binary);
-	//}
-	entry.flags &= ~entry.compressFlag;
+				purgePaths.push_back(entry->path);
+				purgePaths.push_back((settings.depsDir / relativePath).replace_extension(".d"));
 
-	u32 ovID = getOverlayID(target);
-	std::string ovPrefix = "overlay" + getProcessorID(target);
-	fs::path overlayPath = settings.nitroFSDir / ovPrefix / (ovPrefix + "_" + std::to_string(ovID) + ".bin");
+			}
 
-	std::cout << DINFO << "Saving overlay " << getCodeTargetName(target) << " to filesystem" << std::endl;
+		} else if (entry->type == fs::file_type::directory && !findFileTreeEntry(tree, settings.sourceDir / relativePath)) {
 
-	std::ofstream overlayFile(overlayPath, std::ios::out | std::ios::binary | std::ios::trunc);
+			purgeDirs.push_back(entry->path);
+			purgeDirs.push_back(settings.depsDir / relativePath);
 
-	if (!overlayFile.is_open()) {
-		std::cout << DERROR << "Failed to open overlay file " << overlayPath.string() << std::endl;
-		return false;
-	}
+		}
 
-	overlayFile.write(reinterpret_cast<const char*>(binary.data()), binary.size());
-	overlayFile.close();
+	}
 
-	entry.flags = fs::file_size(overlayPath) | (entry.flags & 0xFF000000);
+	for (const fs::path& p : purgePaths) {
+		removeFile(p, "orphaned");
+	}
 
-	return true;
+	for (const fs::path& p : purgeDirs) {
+		removeDirectory(p, "orphaned");
+	}
 
 }
 
 
 
-bool loadOverlayTable(const BuildSettings& settings, OverlayTable& ovt) {
+bool loadARMBinaryProperties(const BuildSettings& settings, CodeTarget target, const std::vector<u8>& binary, ARMBinaryProperties& properties) {
 
-	for (u32 a = 0; a < 2; a++) {
+	if (!isBinary(target)) {
+		std::cout << DERROR << "Target " << getCodeTargetName(target) << " does not represent a valid ARM binary target" << std::endl;
+		return false;
+	}
 
-		const fs::path& ovtPath = settings.backupDir / (a ? "arm9ovt.bin" : "arm7ovt.bin");
-		u32 ovtSize = fs::file_size(ovtPath);
+	std::vector<u8> header;
+	RETURN_ON_ERROR(loadROMHeader(settings, header))
 
-		std::ifstream ovtFile(ovtPath, std::ios::in | std::ios::binary);
+	bool arm9 = target == arm9Target;
+	u32 armEntry = *reinterpret_cast<const u32*>(&header[0x24 + !arm9 * 0x10]);
+	u32 armOffset = *reinterpret_cast<const u32*>(&header[0x28 + !arm9 * 0x10]);
+	u32 armSize = binary.size();
+	u32 entryOffset = armEntry - armOffset;
+	u32 moduleParams = -1;
+	u32 a, b, c;
 
-		if (!ovtFile.is_open()) {
-			std::cout << DERROR << "Failed to open overlay table file " << ovtPath.string() << std::endl;
-			return false;
-		}
+	if (arm9) {
 
-		u32 overlays = ovtSize / 32;
-		OverlayEntry entry{};
+		for (u32 i = entryOffset; i < (armSize - 4) && i < (entryOffset + 0x400); i += 4) {
 
-		for (u32 i = 0; i < overlays; i++) {
+			a = *reinterpret_cast<const u32*>(&binary[i + 0]);
+			b = *reinterpret_cast<const u32*>(&binary[i + 4]);
 
-			ovtFile.read(reinterpret_cast<char*>(&entry), 32);
-			ovt[a ? ov9Target(entry.ovID) : ov7Target(entry.ovID)] = entry;
+			if (a == 0xDEC00621 && b == 0x2106C0DE) {
+				moduleParams = i - 0x1C;
+			}
 
 		}
 
-		ovtFile.close();
+	} else {
 
-	}
+		for (u32 i = entryOffset; i < (armSize - 8) && i < (entryOffset + 0x1A0); i += 4) {
 
-	return true;
+			a = *reinterpret_cast<const u32*>(&binary[i + 0]);
+			b = *reinterpret_cast<const u32*>(&binary[i + 4]);
+			c = *reinterpret_cast<const u32*>(&binary[i + 8]);
 
-}
+			if (a == 0xE5901000 && b == 0xE5902004 && c == 0xE5903008 && i) {
 
+				a = *reinterpret_cast<const u32*>(&binary[i - 4]);
 
+				if ((a & 0xFFFFF000) == 0xE59F0000) {
 
-bool saveOverlayTable(const BuildSettings& settings, const OverlayTable& ovt) {
+					a &= 0xFFF;
+					a += i + 4;
 
-	auto ovtIter = ovt.begin();
+					if (a < armSize) {
 
-	for (u32 a = 0; a < 2; a++) {
+						a = *reinterpret_cast<const u32*>(&binary[a]);
+						a -= armOffset;
 
-		const fs::path& ovtPath = settings.nitroFSDir / (a ? "arm9ovt.bin" : "arm7ovt.bin");
-		std::ofstream ovtFile(ovtPath, std::ios::out | std::ios::binary | std::ios::trunc);
+						if (a < armSize) {
+							moduleParams = a;
+						}
 
-		if (!ovtFile.is_open()) {
-			std::cout << DERROR << "Failed to open overlay table file " << ovtPath.string() << std::endl;
-			return false;
-		}
+					}
 
-		for (auto& it = ovtIter; it != ovt.end(); it++) {
+				}
 
-			if (!a && isARM9Target(it->first)) {
-				break;
 			}
 
-			ovtFile.write(reinterpret_cast<const char*>(&it->second), 32);
-
 		}
 
-		ovtFile.close();
-
 	}
 
-	return true;
-
-}
-
-
-
+	if (moduleParams == -1) {
+		std::cout << DERROR << "Failed to find crt0 module params" << std::endl;
+		return false;
+	}
 
-bool backupNitroFSFile(const BuildSettings& settings, const std::string& path) {
+	properties.offset = armOffset;
+	properties.moduleParams = moduleParams;
+	properties.autoloadStart = *reinterpret_cast<const u32*>(&binary[moduleParams + 0x0]) - armOffset;
+	properties.autoloadEnd = *reinterpret_cast<const u32*>(&binary[moduleParams + 0x4]) - armOffset;
+	properties.autoloadRead = *reinterpret_cast<const u32*>(&binary[moduleParams + 0x8]) - armOffset;
+	properties.compressedEnd = *reinterpret_cast<const u32*>(&binary[moduleParams + 0x14]);
 
-	fs::path filePath = settings.nitroFSDir / path;
-	fs::path fileBackup = settings.backupDir / path;
+	if (properties.compressedEnd != 0) {
+		properties.compressedEnd -= armOffset;
+	}
 
-	if (!fs::exists(fileBackup) || !fs::is_regular_file(fileBackup)) {
+	return true;
 
-		if (!fs::exists(filePath) || !fs::is_regular_file(filePath)) {
-			std::cout << DERROR << "Failed to find NitroFS file " << filePath.string() << std::endl;
-			return false;
-		}
+}
 
-		bool copied = false;
 
-		try {
 
-			copied = fs::copy_file(filePath, fileBackup);
+bool executePrebuildCommand(const BuildSettings& buildSettings) {
 
-		} catch (fs::filesystem_error& e) {
+	const std::string& cmd = buildSettings.prebuildCmd;
 
-			std::cout << DERROR << "Failed to copy NitroFS file " << filePath.string() << " to backup directory: " << e.what() << std::endl;
-			return false;
+	if (cmd.empty()) {
+		return true;
+	}
 
-		}
+	std::cout << DINFO << "Executing pre-build step command \"" << cmd << "\"" << std::endl;
 
-		if (!copied) {
-			std::cout << DERROR << "Failed to copy NitroFS file " << filePath.string() << " to backup directory" << std::endl;
-			return false;
-		}
+	RETURN_ON_ERROR(startJobServer(jobServer, buildSettings.threadCount))
+	int status = std::system(cmd.c_str());
+	stopJobServer(jobServer);
 
+	if (status) {
+		std::cout << DERROR << "Pre-build step returned " << status << std::endl;
+		return false;
 	}
 
 	return true;
@@ -2066,1156 +7609,1134 @@ bool backupNitroFSFile(const BuildSettings& settings, const std::string& path) {
 
 
 
-bool backupFiles(const BuildSettings& settings, OverlayTable& ovt) {
+bool executePostbuildCommand(const BuildSettings& buildSettings) {
 
-	const fs::path& nobackupPath = settings.backupDir / ".nobackup";
+	const std::string& cmd = buildSettings.postbuildCmd;
 
-	if (fs::exists(nobackupPath) && fs::is_regular_file(nobackupPath)) {
-		RETURN_ON_ERROR(loadOverlayTable(settings, ovt))
+	if (cmd.empty()) {
 		return true;
 	}
 
-	std::cout << DINFO << "Backing up NitroFS files" << std::endl;
+	std::cout << DINFO << "Executing post-build step command \"" << cmd << "\"" << std::endl;
 
-	const fs::path& backup9Path = settings.backupDir / "overlay9";
-	const fs::path& backup7Path = settings.backupDir / "overlay7";
-	const fs::path& backup9cPath = settings.backupDir / "overlay9c";
-	const fs::path& backup7cPath = settings.backupDir / "overlay7c";
+	RETURN_ON_ERROR(startJobServer(jobServer, buildSettings.threadCount))
+	int status = std::system(cmd.c_str());
+	stopJobServer(jobServer);
 
-	std::cout << DINFO << "Backing up ROM header" << std::endl;
-	RETURN_ON_ERROR(backupNitroFSFile(settings, "header.bin"))
+	if (status) {
+		std::cout << DERROR << "Post-build step returned " << status << std::endl;
+		return false;
+	}
 
-	std::cout << DINFO << "Backing up overlay tables" << std::endl;
-	RETURN_ON_ERROR(backupNitroFSFile(settings, "arm7ovt.bin"))
-	RETURN_ON_ERROR(backupNitroFSFile(settings, "arm9ovt.bin"))
-	RETURN_ON_ERROR(loadOverlayTable(settings, ovt))
+	return true;
 
-	RETURN_ON_ERROR(createDirectory(backup9Path, "overlay"))
-	RETURN_ON_ERROR(createDirectory(backup7Path, "overlay"))
-	RETURN_ON_ERROR(createDirectory(backup9cPath, "compressed overlay"))
-	RETURN_ON_ERROR(createDirectory(backup7cPath, "compressed overlay"))
+}
 
-	std::cout << DINFO << "Backing up ARM binaries" << std::endl;
 
-	for (u32 a = 0; a < 2; a++) {
 
-		CodeTarget target = a ? arm9Target : arm7Target;
-		const std::string& armFilename = getCodeTargetName(target) + ".bin";
+bool executeJobs(std::vector<ProcessJob>& jobs, u32 threadCount, bool pedantic) {
 
-		RETURN_ON_ERROR(backupNitroFSFile(settings, armFilename))
+	std::atomic_bool threadsRunning = true;
+	std::atomic_bool successful = true;
+	std::atomic_uint jobIndex = 0;
 
-		fs::path armPath = settings.backupDir / armFilename;
-		u32 armSize = fs::file_size(armPath);
+	std::mutex processMutex;
+	std::mutex outputMutex;
+	std::unordered_map<u32, Process> runningProcesses;
+	std::vector<u32> jobOrder;
+
+	for (u32 i = 0; i < jobs.size(); i++) {
+		jobOrder.push_back(i);
+	}
 
-		std::ifstream armFile(armPath, std::ios::in | std::ios::binary);
+	std::stable_sort(jobOrder.begin(), jobOrder.end(), [&jobs](u32 a, u32 b) {
+		return jobs[a].priority > jobs[b].priority;
+	});
 
-		if (!armFile.is_open()) {
-			std::cout << DERROR << "Failed to open ARM binary file " << armPath.string() << std::endl;
-			return false;
-		}
+	//Kills every job still in flight so a failed pedantic build does not wait for stragglers
+	auto cancelJobs = [&]() {
 
-		std::vector<u8> binary;
-		binary.resize(armSize);
-		armFile.read(reinterpret_cast<char*>(binary.data()), armSize);
-		armFile.close();
+		std::lock_guard<std::mutex> lock(processMutex);
+		threadsRunning = false;
 
-		ARMBinaryProperties properties{};
-		RETURN_ON_ERROR(loadARMBinaryProperties(settings, target, binary, properties))
+		for (const auto& e : runningProcesses) {
+			killProcess(e.second);
+		}
 
-		if (properties.compressedEnd) {
+	};
 
-			const std::string& armcBinary = getCodeTargetName(target) + "c.bin";
-			fs::path armcPath = settings.backupDir / armcBinary;
+	auto jobsPending = [&]() {
+		return threadsRunning && jobIndex < jobs.size();
+	};
 
-			try {
-				fs::rename(armPath, armcPath);
-			} catch (fs::filesystem_error& e) {
-				std::cout << DERROR << "Failed to move ARM binary " << armPath.string() << ": " << e.what() << std::endl;
-				return false;
-			}
+	auto jobFunction = [&](bool implicitToken) {
 
-			BLZ::decompress(binary);
-			*reinterpret_cast<u32*>(&binary[properties.moduleParams + 0x14]) = 0;
-			properties.compressedEnd = 0;
+		while (threadsRunning) {
 
-			std::ofstream armdFile(armPath, std::ios::out | std::ios::binary | std::ios::trunc);
+			s32 token = -1;
 
-			if (!armdFile.is_open()) {
-				std::cout << DERROR << "Failed to open decompressed ARM binary file " << armPath.string() << std::endl;
-				return false;
+			//Under a jobserver only the first thread runs on the implicit token, all others need one per job
+			if (!implicitToken && !acquireJobToken(jobServer, token, jobsPending)) {
+				return;
 			}
 
-			armdFile.write(reinterpret_cast<const char*>(binary.data()), binary.size());
-			armdFile.close();
+			u32 i = jobIndex.fetch_add(1);
 
-		}
+			if (i >= jobs.size() || !threadsRunning) {
+				releaseJobToken(jobServer, token);
+				return;
+			}
 
-	}
+			ProcessJob& job = jobs[jobOrder[i]];
+			Process process{};
+			auto startTime = std::chrono::steady_clock::now();
 
-	std::cout << DINFO << "Backing up overlays" << std::endl;
+			if (!spawnProcess(job.args, process)) {
 
-	for (const auto& e : ovt) {
+				job.status = -1;
+				releaseJobToken(jobServer, token);
 
-		u32 ovID = e.second.ovID;
-		const std::string procID = getProcessorID(e.first);
-		const std::string& overlaySubpath = "overlay" + procID + "_" + std::to_string(ovID) + ".bin";
+				{
+					std::lock_guard<std::mutex> lock(outputMutex);
+					std::cout << DERROR << "Failed to execute " << job.args.front() << std::endl;
+				}
 
-		RETURN_ON_ERROR(backupNitroFSFile(settings, "overlay" + procID + "/" + overlaySubpath))
+				successful = false;
 
-		if (e.second.flags & OverlayEntry::compressFlag) {
+				if (pedantic) {
+					cancelJobs();
+				}
 
-			fs::path overlayPath = (procID == "9" ? backup9Path : backup7Path) / overlaySubpath;
-			fs::path overlaycPath = (procID == "9" ? backup9cPath : backup7cPath) / overlaySubpath;
+				continue;
 
-			try {
-				fs::rename(overlayPath, overlaycPath);
-			} catch (fs::filesystem_error& e) {
-				std::cout << DERROR << "Failed to move overlay " << overlayPath.string() << ": " << e.what() << std::endl;
-				return false;
 			}
 
-			std::ifstream overlaycFile(overlaycPath, std::ios::in | std::ios::binary);
+			{
+				std::lock_guard<std::mutex> lock(processMutex);
+				runningProcesses[i] = process;
 
-			if (!overlaycFile.is_open()) {
-				std::cout << DERROR << "Failed to open compressed overlay file " << overlaycPath.string() << std::endl;
-				return false;
+				if (!threadsRunning) {
+					killProcess(process);
+				}
 			}
 
-			std::vector<u8> binary;
-			binary.resize(fs::file_size(overlaycPath));
-			overlaycFile.read(reinterpret_cast<char*>(binary.data()), binary.size());
+			job.output = readProcessOutput(process);
 
-			BLZ::decompress(binary);
+			{
+				std::lock_guard<std::mutex> lock(processMutex);
+				runningProcesses.erase(i);
+			}
 
-			std::ofstream overlaydFile(overlayPath, std::ios::out | std::ios::binary | std::ios::trunc);
+			job.status = waitProcess(process);
+			releaseJobToken(jobServer, token);
+			job.duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count();
 
-			if (!overlaydFile.is_open()) {
-				std::cout << DERROR << "Failed to open decompressed overlay file " << overlayPath.string() << std::endl;
-				return false;
+			if (job.status && !threadsRunning) {
+				return;
 			}
 
-			overlaydFile.write(reinterpret_cast<const char*>(binary.data()), binary.size());
-			overlaydFile.close();
+			{
+				std::lock_guard<std::mutex> lock(outputMutex);
 
-		}
+				if (!job.info.empty()) {
+					std::cout << job.info << std::endl;
+				}
 
-	}
+				std::cout << job.output << std::flush;
+			}
 
-	std::ofstream nobackupFile(nobackupPath);
+			if (job.status) {
 
-	if (!nobackupFile.is_open()) {
-		std::cout << DERROR << "Fatal error: Failed to secure backup state" << std::endl;
-		return false;
-	}
+				successful = false;
 
-	nobackupFile.close();
+				if (pedantic) {
+					cancelJobs();
+				}
 
-	return true;
+			} else if (job.finished) {
 
-}
+				//Lets callers process outputs while the remaining jobs still run
+				job.finished();
 
+			}
 
+		}
 
-bool loadROMHeader(const BuildSettings& settings, std::vector<u8>& header) {
+	};
 
-	fs::path headerPath = settings.backupDir / "header.bin";
-	u32 headerSize = fs::file_size(headerPath);
+	threadCount = std::max(std::min(threadCount, static_cast<u32>(jobs.size())), 1u);
+	std::thread* threads = new std::thread[threadCount];
 
-	if (headerSize < 256) {
-		std::cout << DERROR << "Invalid ROM header file " << headerPath.string() << ": Expected a minimum of 256 bytes, got " << headerSize << " bytes" << std::endl;
-		return false;
+	for (u32 i = 0; i < threadCount; i++) {
+		threads[i] = std::thread(jobFunction, i == 0);
 	}
 
-	std::ifstream headerFile(headerPath, std::ios::in | std::ios::binary);
-
-	if (!headerFile.is_open()) {
-		std::cout << DERROR << "Failed to open ROM header file " << headerPath.string() << std::endl;
-		return false;
+	for (u32 i = 0; i < threadCount; i++) {
+		threads[i].join();
 	}
 
-	header.resize(256);
-	headerFile.read(reinterpret_cast<char*>(header.data()), 256);
-	headerFile.close();
+	delete[] threads;
 
-	return true;
+	return successful;
 
 }
 
 
 
+#ifdef _WIN32
 
-bool loadPatch(const BuildSettings& settings, const Patch& patch, std::vector<u8>& binary) {
-
-	fs::path elfPath = settings.buildDir / (isARM9Target(patch.codeTarget) ? "arm9.elf" : "arm7.elf");
+bool spawnProcess(const std::vector<std::string>& args, Process& process) {
 
-	if (!fs::exists(elfPath) || !fs::is_regular_file(elfPath)) {
-		std::cout << DERROR << "Failed to find " << elfPath.string() << std::endl;
-		return false;
-	}
-
-	u32 elfFilesize = fs::file_size(elfPath);
+	//Serialized so that no concurrently spawned process inherits the write end of another job's pipe
+	static std::mutex spawnMutex;
+	std::lock_guard<std::mutex> lock(spawnMutex);
 
-	if (elfFilesize < (patch.binOffset + patch.binSize)) {
-		std::cout << DERROR << "Patch section out of bounds: Filesize=0x" << std::uppercase << std::hex << elfFilesize << ", offset=0x" << patch.binOffset << ", size=0x" << patch.binSize << std::endl;
-		return false;
-	}
+	SECURITY_ATTRIBUTES pipeAttributes{ sizeof(SECURITY_ATTRIBUTES), nullptr, FALSE };
+	HANDLE readPipe = nullptr;
+	HANDLE writePipe = nullptr;
 
-	std::ifstream elfFile(elfPath, std::ios::in | std::ios::binary);
-
-	if (!elfFile.is_open()) {
-		std::cout << DERROR << "Failed to open " << elfPath.string() << std::endl;
+	if (!CreatePipe(&readPipe, &writePipe, &pipeAttributes, 0)) {
 		return false;
 	}
 
-	binary.resize(patch.binSize);
-	elfFile.seekg(patch.binOffset, std::ios::beg);
-	elfFile.read(reinterpret_cast<char*>(binary.data()), patch.binSize);
-	elfFile.close();
-
-	return true;
+	SetHandleInformation(writePipe, HANDLE_FLAG_INHERIT, HANDLE_FLAG_INHERIT);
 
-}
+	std::string cmdLine;
 
+	for (const std::string& arg : args) {
+		cmdLine += (cmdLine.empty() ? "" : " ") + quoteArgument(arg);
+	}
 
+	STARTUPINFOA startupInfo{};
+	startupInfo.cb = sizeof(STARTUPINFOA);
+	startupInfo.dwFlags = STARTF_USESTDHANDLES;
+	startupInfo.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+	startupInfo.hStdOutput = writePipe;
+	startupInfo.hStdError = writePipe;
 
+	PROCESS_INFORMATION processInfo{};
+	BOOL created = CreateProcessA(nullptr, cmdLine.data(), nullptr, nullptr, TRUE, CREATE_SUSPENDED, nullptr, nullptr, &startupInfo, &processInfo);
 
-bool getSectionAddressOffset(const SectionMap& sections, CodeTarget target, u32 address, u32 size, u32& offset) {
+	CloseHandle(writePipe);
 
-	if (!sections.contains(target)) {
-		std::cout << DWARNING << "Section " << getCodeTargetName(target) << " neither represents a valid binary nor an overlay" << std::endl;
+	if (!created) {
+		CloseHandle(readPipe);
 		return false;
 	}
 
-	auto targetIt = sections.equal_range(target);
+	//Placing the process in a job lets us kill gcc together with cc1/as
+	process.job = CreateJobObjectA(nullptr, nullptr);
 
-	for (auto& it = targetIt.first; it != targetIt.second; it++) {
+	if (process.job) {
 
-		const SectionData& sdat = it->second;
+		JOBOBJECT_EXTENDED_LIMIT_INFORMATION limits{};
+		limits.BasicLimitInformation.LimitFlags = JOB_OBJECT_LIMIT_KILL_ON_JOB_CLOSE;
 
-		if (address >= sdat.start && (address + size) <= sdat.end) {
-			offset = address - sdat.start + sdat.destination;
-			return true;
-		}
+		SetInformationJobObject(process.job, JobObjectExtendedLimitInformation, &limits, sizeof(limits));
+		AssignProcessToJobObject(process.job, processInfo.hProcess);
 
 	}
 
-	return false;
+	ResumeThread(processInfo.hThread);
+	CloseHandle(processInfo.hThread);
 
-}
+	process.handle = processInfo.hProcess;
+	process.output = readPipe;
 
+	return true;
 
+}
 
 
-void checkSafeInstruction(u32 opcode) {
 
-	u32 condition = (opcode & 0xF0000000) >> 28;
-	u32 code2 = (opcode & 0x0E000000) >> 25;
+std::string readProcessOutput(Process& process) {
 
-	if (condition != 0xF) {
+	std::string output;
+	char buffer[4096];
+	DWORD bytesRead = 0;
 
-		bool bit4 = (opcode & 0x10) >> 4;
-		bool bit7 = (opcode & 0x80) >> 7;
-		u32 ext47 = (opcode & 0xF0) >> 4;
-		bool sbit = (opcode & 0x100000) >> 20;
-		u32 code3 = (opcode & 0x1E00000) >> 21;
-		u32 reg0 = (opcode & 0xF0000) >> 16;
-		u32 reg1 = (opcode & 0xF000) >> 12;
+	while (ReadFile(process.output, buffer, sizeof(buffer), &bytesRead, nullptr) && bytesRead) {
+		output.append(buffer, bytesRead);
+	}
 
-		switch (code2) {
+	CloseHandle(process.output);
+	process.output = nullptr;
 
-			case 0:
+	return output;
 
-				if (sbit && !bit4) {
-					std::cout << DWARNING << "Data processing instruction 0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << opcode << " potentially unsafe: CPSR non-secured" << std::endl;
-				} else if (sbit && !bit7 && bit4) {
-					std::cout << DWARNING << "Data processing instruction 0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << opcode << " potentially unsafe: CPSR non-secured" << std::endl;
-				} else if (sbit && ext47 == 0x90 && ((code3 & 0xE) == 0 || (code3 & 0xC) == 4)) {
-					std::cout << DWARNING << "Multiply instruction 0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << opcode << " potentially unsafe: CPSR non-secured" << std::endl;
-				} else if (!sbit && code3 == 9 && ext47 == 1) {
-					std::cout << DWARNING << "Branch exchange instruction 0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << opcode << " has potential side-effects: Orphaned code block after instruction" << std::endl;
-				} else if (!sbit && (code3 & 0xD) == 9 && ext47 == 0) {
-					std::cout << DWARNING << "PSR move instruction 0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << opcode << " potentially unsafe: CPSR non-secured" << std::endl;
-				} else if (!sbit && (code3 & 0xC) == 8 && ext47 == 5) {
-					std::cout << DWARNING << "Saturating ALU instruction 0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << opcode << " potentially unsafe: CPSR non-secured" << std::endl;
-				} else if (!sbit && code3 == 9 && ext47 == 7) {
-					std::cout << DWARNING << "Breakpoint instruction 0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << opcode << " potentially unsafe: Breakpoint out of place" << std::endl;
-				} else if (!sbit && ((code3 == 8 && (ext47 & 0x9) == 8) || (code3 == 9 && (ext47 & 0xB) == 8))) {
-					std::cout << DWARNING << "Signed multiply (type 2) instruction 0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << opcode << " potentially unsafe: CPSR non-secured" << std::endl;
-				} else if (bit4 && ext47 > 9 && (reg0 == 0xF || reg1 == 0xF)) {
-					std::cout << DWARNING << "Load/Store instruction 0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << opcode << " potentially unsafe: Broken PC-relative expression" << std::endl;
-				} else if (bit4 && !bit7 && (((code3 & 0xC) == 0x1000 && sbit) || ((code3 & 0xC) != 0x1000)) && (reg0 == 0xF || reg1 == 0xF)) {
-					std::cout << DWARNING << "Data processing instruction 0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << opcode << " potentially unsafe: Broken PC-relative expression" << std::endl;
-				}
+}
 
-				break;
 
-			case 1:
 
-				if (sbit) {
-					std::cout << DWARNING << "Load/Store instruction 0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << opcode << " potentially unsafe: CPSR non-secured" << std::endl;
-				} else if (!sbit && (code3 & 0xD) == 9) {
-					std::cout << DWARNING << "PSR move instruction 0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << opcode << " potentially unsafe: CPSR non-secured" << std::endl;
-				}
+s32 waitProcess(Process& process) {
 
-				break;
+	DWORD exitCode = -1;
 
-			case 2:
+	WaitForSingleObject(process.handle, INFINITE);
+	GetExitCodeProcess(process.handle, &exitCode);
+	CloseHandle(process.handle);
 
-				if (reg0 == 0xF || reg1 == 0xF) {
-					std::cout << DWARNING << "Load/Store instruction 0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << opcode << " potentially unsafe: Broken PC-relative expression" << std::endl;
-				}
+	if (process.job) {
+		CloseHandle(process.job);
+	}
 
-				break;
+	process.handle = nullptr;
+	process.job = nullptr;
 
-			case 3:
-				break;
+	return exitCode;
 
-			case 4:
+}
 
-				if (opcode & (1 << 15)) {
-					std::cout << DWARNING << "Load/Store multiple instruction 0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << opcode << " potentially unsafe: PC used in register list" << std::endl;
-				}
 
-				break;
 
-			case 5:
-				std::cout << DWARNING << "Branch instruction 0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << opcode << " potentially unsafe: Broken branch offset" << std::endl;
-				break;
+void killProcess(const Process& process) {
 
-			case 6:
-				std::cout << DWARNING << "Coprocessor load/store instruction 0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << opcode << " potentially unsafe: Broken PC-relative expression" << std::endl;
-				break;
+	if (process.job) {
+		TerminateJobObject(process.job, -1);
+	} else {
+		TerminateProcess(process.handle, -1);
+	}
 
-			case 7:
+}
 
-				if (reg0 == 0xF || reg1 == 0xF) {
-					std::cout << DWARNING << "Coprocessor load/store instruction 0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << opcode << " potentially unsafe: Broken PC-relative expression" << std::endl;
-				}
+#else
 
-				break;
+bool spawnProcess(const std::vector<std::string>& args, Process& process) {
 
-		}
+	int pipeFds[2];
 
-	} else {
+	if (pipe2(pipeFds, O_CLOEXEC)) {
+		return false;
+	}
 
-		if (code2 == 5) {
-			std::cout << DWARNING << "Branch instruction 0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << opcode << " potentially unsafe: Broken branch offset" << std::endl;
-		}
+	std::vector<char*> argv;
 
+	for (const std::string& arg : args) {
+		argv.push_back(const_cast<char*>(arg.c_str()));
 	}
 
-}
+	argv.push_back(nullptr);
 
+	posix_spawn_file_actions_t fileActions;
+	posix_spawn_file_actions_init(&fileActions);
+	posix_spawn_file_actions_adddup2(&fileActions, pipeFds[1], STDOUT_FILENO);
+	posix_spawn_file_actions_adddup2(&fileActions, pipeFds[1], STDERR_FILENO);
 
+	//Own process group so that gcc can be killed together with cc1/as, which also keeps it from seeing Ctrl+C on the terminal
+	static std::once_flag handlersInstalled;
 
+	std::call_once(handlersInstalled, []() {
 
-bool collectHooks(const BuildSettings& settings, CodeTargetMap& codeTargets, HookSymbols& hookSymbols) {
+		struct sigaction action{};
+		action.sa_handler = forwardSignal;
+		sigemptyset(&action.sa_mask);
 
-	std::cout << DINFO << "Collecting hooks" << std::endl;
+		sigaction(SIGINT, &action, nullptr);
+		sigaction(SIGTERM, &action, nullptr);
 
-	for (auto& e : codeTargets) {
+	});
 
-		bool arm9 = isARM9Target(e.first);
-		std::set<fs::path>& srcPaths = e.second;
+	//Signals are held back until the group is registered so that the handler cannot miss the child, which starts with the old mask
+	sigset_t forwardedSignals;
+	sigset_t oldMask;
+	sigemptyset(&forwardedSignals);
+	sigaddset(&forwardedSignals, SIGINT);
+	sigaddset(&forwardedSignals, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &forwardedSignals, &oldMask);
 
-		for (const fs::path& srcPath : srcPaths) {
+	posix_spawnattr_t attributes;
+	posix_spawnattr_init(&attributes);
+	posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGMASK);
+	posix_spawnattr_setpgroup(&attributes, 0);
+	posix_spawnattr_setsigmask(&attributes, &oldMask);
 
-			const fs::path& objPath = getObjectPath(settings, srcPath);
-			std::cout << objPath.string() << std::endl;
-			if (!fs::exists(objPath) || !fs::is_regular_file(objPath)) {
-				std::cout << DERROR << "Fatal error: Failed to find object file " << objPath.string() << std::endl;
-				return false;
-			}
+	int result = posix_spawnp(&process.pid, argv.front(), &fileActions, &attributes, argv.data(), environ);
 
-			std::ifstream objFile(objPath, std::ios::in | std::ios::binary);
+	posix_spawnattr_destroy(&attributes);
+	posix_spawn_file_actions_destroy(&fileActions);
+	close(pipeFds[1]);
 
-			if (!objFile.is_open()) {
-				std::cout << DERROR << "Fatal error: Failed to open object file " << objPath.string() << std::endl;
-				return false;
-			}
+	bool registered = false;
 
-			std::vector<u8> data;
-			data.resize(fs::file_size(objPath));
+	for (u32 i = 0; !result && !registered && i < std::size(processGroups); i++) {
 
-			objFile.read(reinterpret_cast<char*>(data.data()), data.size());
-			objFile.close();
+		pid_t expected = 0;
+		registered = processGroups[i].compare_exchange_strong(expected, process.pid);
 
-			std::unordered_map<u32, Hook> hookSections;
+	}
 
-			u32 shdr = *reinterpret_cast<u32*>(&data[0x20]);
-			u16 shnum = *reinterpret_cast<u16*>(&data[0x30]);
-			u16 shstrndx = *reinterpret_cast<u16*>(&data[0x32]);
+	pthread_sigmask(SIG_SETMASK, &oldMask, nullptr);
 
-			u32 shstrtab = *reinterpret_cast<u32*>(&data[shdr + shstrndx * 0x28 + 0x10]);
-			u32 symtab = 0;
-			u32 symtabsize = 0;
-			u32 strtab = 0;
+	if (result) {
+		close(pipeFds[0]);
+		return false;
+	}
 
-			for (u32 i = 0; i < shnum; i++) {
+	process.output = pipeFds[0];
 
-				u32 shstrtaboffset = *reinterpret_cast<u32*>(&data[shdr + i * 0x28]);
-				std::string shname(reinterpret_cast<const char*>(&data[shstrtab + shstrtaboffset]));
+	//An unregistered child could not be interrupted anymore, so it is not run at all
+	if (!registered) {
 
-				if (shname.starts_with(".hook") || shname.starts_with(".rlnk") || shname.starts_with(".safe") || shname.starts_with(".over")) {
+		std::cout << DERROR + std::string("Too many running processes to track\n") << std::flush;
 
-					HookType hookType = HookType::None;
-					u32 hookEndIndex = shname.find_first_of('.', 1);
-					std::string hookTypename = shname.substr(1, hookEndIndex - 1);
+		killProcess(process);
+		readProcessOutput(process);
+		waitProcess(process);
 
-					if (hookTypename == "hook") {
-						hookType = HookType::Hook;
-					} else if (hookTypename == "rlnk") {
-						hookType = HookType::Link;
-					} else if (hookTypename == "safe") {
-						hookType = HookType::Safe;
-					} else if (hookTypename == "over") {
-						hookType = HookType::Replace;
-					}
+		return false;
 
-					u32 targetEndIndex = shname.find_last_of('.');
-					std::string target = shname.substr(hookEndIndex + 1, targetEndIndex - hookEndIndex - 1);
-					std::string address = shname.substr(targetEndIndex + 1);
+	}
 
-					CodeTarget hookTarget = getCodeTarget(target);
+	return true;
 
-					if (hookTarget == invalidTarget) {
-						std::cout << DWARNING << "Invalid hook target " << target << std::endl;
-						continue;
-					}
+}
 
-					u32 hookAddress;
 
-					try {
-						hookAddress = std::stoul(address, nullptr, 16);
-					} catch (std::exception&) {
-						std::cout << DWARNING << "Invalid hook address " << address << std::endl;
-						continue;
-					}
 
-					if (hookType == HookType::Safe) {
+std::string readProcessOutput(Process& process) {
 
-						if (hookAddress & 1) {
-							std::cout << DWARNING << "Cannot make safe hook at 0x" << std::setw(8) << std::setfill('0') << std::uppercase << std::hex << hookAddress << " from Thumb mode" << std::endl;
-							continue;
-						}
+	std::string output;
+	char buffer[4096];
 
-						hookSymbols.incSafe(e.first, 20);
+	while (true) {
 
-					}
+		ssize_t bytesRead = read(process.output, buffer, sizeof(buffer));
 
-					hookSections[i] = Hook{ hookTarget, hookType, hookAddress, 0xFFFFFFFF };
+		if (bytesRead < 0 && errno == EINTR) {
+			continue;
+		}
 
-				}
+		if (bytesRead <= 0) {
+			break;
+		}
 
-				if (shname == ".symtab") {
-					symtab = *reinterpret_cast<u32*>(&data[shdr + i * 0x28 + 0x10]);
-					symtabsize = *reinterpret_cast<u32*>(&data[shdr + i * 0x28 + 0x14]);
-				}
+		output.append(buffer, bytesRead);
 
-				if (shname == ".strtab") {
-					strtab = *reinterpret_cast<u32*>(&data[shdr + i * 0x28 + 0x10]);
-				}
+	}
 
-			}
+	close(process.output);
+	process.output = -1;
 
-			if (!symtab) {
-				std::cout << DERROR << "Error while parsing object file " << objPath.string() << ": Missing symbol table" << std::endl;
-				return false;
-			}
+	return output;
 
-			if (!strtab) {
-				std::cout << DERROR << "Error while parsing object file " << objPath.string() << ": Missing string table" << std::endl;
-				return false;
-			}
+}
 
-			for (u32 i = 0; i < symtabsize / 0x10; i++) {
 
-				u32 strtaboffset = *reinterpret_cast<u32*>(&data[symtab + i * 0x10]);
-				u32 symoffset = *reinterpret_cast<u32*>(&data[symtab + i * 0x10 + 0x4]);
-				u16 symsection = *reinterpret_cast<u16*>(&data[symtab + i * 0x10 + 0xE]);
-				std::string symname(reinterpret_cast<const char*>(&data[strtab + strtaboffset]));
-				
-				if (hookSections.contains(symsection) && symoffset < 2 && !symname.empty() && symname[0] != '$') {
-					hookSymbols.getSymbolMap(arm9)[symname] = hookSections[symsection];
-				}
 
-			}
+s32 waitProcess(Process& process) {
+
+	int status = 0;
+
+	while (waitpid(process.pid, &status, 0) < 0) {
 
+		if (errno != EINTR) {
+			return -1;
 		}
 
 	}
 
-	for (auto& [s, h] : hookSymbols.hooks9) {
-		std::cout << s << ": " << std::hex << h.funcAddress << std::endl;
+	for (std::atomic<pid_t>& group : processGroups) {
+
+		pid_t expected = process.pid;
+
+		if (group.compare_exchange_strong(expected, 0)) {
+			break;
+		}
+
 	}
 
-	return true;
+	process.pid = -1;
+
+	return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
 
 }
 
 
 
-bool parseElf(const BuildSettings& settings, HookSymbols& hookSymbols, std::vector<Fixup>& fixups) {
+void killProcess(const Process& process) {
+	kill(-process.pid, SIGKILL);
+}
 
-	std::cout << DINFO << "Fixing hook symbol addresses" << std::endl;
 
-	for (u32 a = 0; a < 2; a++) {
 
-		const std::string& elfFilename = a ? "arm9.elf" : "arm7.elf";
-		fs::path elfPath = settings.buildDir / elfFilename;
+void forwardSignal(int signal) {
 
-		if (!fs::exists(elfPath) || !fs::is_regular_file(elfPath)) {
-			continue;
-		}
+	for (std::atomic<pid_t>& group : processGroups) {
 
-		std::ifstream elfFile(elfPath, std::ios::in | std::ios::binary);
+		pid_t pgid = group.load();
 
-		if (!elfFile.is_open()) {
-			std::cout << DERROR << "Fatal error: Failed to open " << elfFilename << std::endl;
-			return false;
+		if (pgid > 0) {
+			kill(-pgid, signal);
 		}
 
-		std::vector<u8> data;
-		data.resize(fs::file_size(elfPath));
-
-		elfFile.read(reinterpret_cast<char*>(data.data()), data.size());
-		elfFile.close();
-
-		u32 shdr = *reinterpret_cast<u32*>(&data[0x20]);
-		u16 shnum = *reinterpret_cast<u16*>(&data[0x30]);
-		u16 shstrndx = *reinterpret_cast<u16*>(&data[0x32]);
+	}
 
-		u32 shstrtab = *reinterpret_cast<u32*>(&data[shdr + shstrndx * 0x28 + 0x10]);
-		u32 symtab = 0;
-		u32 symtabsize = 0;
-		u32 strtab = 0;
-		u32 strtabsize = 0;
+	//Terminates with the default action of the signal
+	struct sigaction action{};
+	action.sa_handler = SIG_DFL;
+	sigemptyset(&action.sa_mask);
+	sigaction(signal, &action, nullptr);
 
-		HookMap& hooks = hookSymbols.getSymbolMap(a);
-		std::map<CodeTarget, Patch> elfBinaries;
+	raise(signal);
 
-		for (u32 i = 0; i < shnum; i++) {
+}
 
-			u32 shstrtaboffset = *reinterpret_cast<u32*>(&data[shdr + i * 0x28]);
-			std::string shname(reinterpret_cast<const char*>(&data[shstrtab + shstrtaboffset]));
+#endif
 
-			if (shname == ".symtab") {
 
-				symtab = *reinterpret_cast<u32*>(&data[shdr + i * 0x28 + 0x10]);
-				symtabsize = *reinterpret_cast<u32*>(&data[shdr + i * 0x28 + 0x14]);
 
-			} else if (shname == ".strtab") {
+std::vector<std::string> splitArguments(const std::string& s) {
 
-				strtab = *reinterpret_cast<u32*>(&data[shdr + i * 0x28 + 0x10]);
-				strtabsize = *reinterpret_cast<u32*>(&data[shdr + i * 0x28 + 0x14]);
+	std::vector<std::string> args;
+	std::string arg;
+	char quote = 0;
+	bool pending = false;
 
-			} else if (shname.starts_with(".text")) {
+	//Quotes and backslashes follow the shell, except that a backslash before other characters stays, which keeps Windows paths intact
+	for (u32 i = 0; i < s.size(); i++) {
 
-				CodeTarget target = getCodeTarget(shname.substr(6));
+		char c = s[i];
+		char next = i + 1 < s.size() ? s[i + 1] : 0;
+		bool escapable = quote == '"' ? (next == '"' || next == '\\') : (next == '"' || next == '\'' || next == '\\' || next == ' ' || next == '\t');
 
-				if (target == invalidTarget) {
-					std::cout << DERROR << "Invalid code target for section " << shname << std::endl;
-					return false;
-				}
+		if (c == '\\' && quote != '\'' && escapable) {
 
-				elfBinaries[target].codeTarget = target;
-				elfBinaries[target].ramAddress = *reinterpret_cast<u32*>(&data[shdr + i * 0x28 + 0x0C]);
-				elfBinaries[target].binOffset = *reinterpret_cast<u32*>(&data[shdr + i * 0x28 + 0x10]);
-				elfBinaries[target].binSize = *reinterpret_cast<u32*>(&data[shdr + i * 0x28 + 0x14]);
+			arg += next;
+			pending = true;
+			i++;
 
-			} else if (shname.starts_with(".bss")) {
+		} else if ((c == '"' || c == '\'') && (!quote || c == quote)) {
 
-				CodeTarget target = getCodeTarget(shname.substr(5));
+			quote = quote ? 0 : c;
+			pending = true;
 
-				if (target == invalidTarget) {
-					std::cout << DERROR << "Invalid code target for section " << shname << std::endl;
-					return false;
-				}
+		} else if (!quote && (c == ' ' || c == '\t' || c == '\n' || c == '\r')) {
 
-				elfBinaries[target].bssSize = *reinterpret_cast<u32*>(&data[shdr + i * 0x28 + 0x14]);
-				elfBinaries[target].bssAlign = *reinterpret_cast<u32*>(&data[shdr + i * 0x28 + 0x20]);
+			if (pending) {
+				args.push_back(arg);
+				arg.clear();
+				pending = false;
+			}
 
-			} else if (shname.starts_with(".over")) {
+		} else {
 
-				u32 subsectionIndex = shname.find_last_of('.');
-				CodeTarget target = getCodeTarget(shname.substr(6, shname.find_last_of('.') - 6));
+			arg += c;
+			pending = true;
 
-				if (target == invalidTarget) {
-					std::cout << DERROR << "Invalid code target for section " << shname << std::endl;
-					return false;
-				}
+		}
 
-				u32 rplcAddress = 0;
+	}
 
-				try {
-					rplcAddress = std::stoul(shname.substr(subsectionIndex + 1), nullptr, 16);
-				} catch (std::exception&) {
-					std::cout << DWARNING << "Invalid replace address " << rplcAddress << std::endl;
-					continue;
-				}
+	if (pending) {
+		args.push_back(arg);
+	}
 
-				u32 rplcOffset = *reinterpret_cast<u32*>(&data[shdr + i * 0x28 + 0x10]);
-				u32 rplcSize = *reinterpret_cast<u32*>(&data[shdr + i * 0x28 + 0x14]);
+	return args;
 
-				fixups.push_back(Patch{ target, rplcAddress, rplcOffset, rplcSize, noBSS, noBSS });
+}
 
-			}
 
-		}
 
+std::string quoteArgument(const std::string& arg) {
 
-		if (!symtab) {
-			std::cout << DERROR << "Error while parsing " << elfFilename << ": Missing symbol table" << std::endl;
-			return false;
-		}
+	if (!arg.empty() && arg.find_first_of(" \t\"") == std::string::npos) {
+		return arg;
+	}
 
-		if (!strtab) {
-			std::cout << DERROR << "Error while parsing " << elfFilename << ": Missing string table" << std::endl;
-			return false;
-		}
+	//Escapes according to the rules of CommandLineToArgvW
+	std::string quoted = "\"";
+	u32 backslashes = 0;
 
+	for (char c : arg) {
 
-		for (const auto& e : elfBinaries) {
-			fixups.push_back(e.second);
+		if (c == '\\') {
+			backslashes++;
+			continue;
 		}
 
+		quoted.append(c == '"' ? backslashes * 2 + 1 : backslashes, '\\');
+		quoted += c;
+		backslashes = 0;
 
-		std::unordered_map<u32, std::string> hookSyms;
-		u32 strindex = 0;
+	}
 
-		while (strindex < strtabsize) {
+	quoted.append(backslashes * 2, '\\');
+	quoted += '"';
 
-			std::string symname(reinterpret_cast<const char*>(&data[strtab + strindex]));
+	return quoted;
 
-			if (hooks.contains(symname)) {
-				hookSyms[strindex] = symname;
-			}
+}
 
-			strindex += symname.size() + 1;
 
-		}
+void initJobServer(JobServer& server) {
 
-		for (u32 i = 0; i < symtabsize / 0x10; i++) {
+	const char* makeFlags = std::getenv("MAKEFLAGS");
+
+	if (!makeFlags) {
+		return;
+	}
 
-			u32 strtaboffset = *reinterpret_cast<u32*>(&data[symtab + i * 0x10]);
+	std::string flags = makeFlags;
+	std::string auth;
 
-			if (hookSyms.contains(strtaboffset)) {
+	//make 4.2+ passes --jobserver-auth, older versions --jobserver-fds; the last occurrence wins
+	const std::string options[] = { "--jobserver-fds=", "--jobserver-auth=" };
 
-				std::string symname(reinterpret_cast<const char*>(&data[strtab + strtaboffset]));
-				u32 symaddress = *reinterpret_cast<u32*>(&data[symtab + i * 0x10 + 0x4]);
-				hooks[hookSyms[strtaboffset]].funcAddress = symaddress;
+	for (const std::string& option : options) {
 
-			}
+		u64 offset = flags.rfind(option);
 
+		if (offset != std::string::npos) {
+			offset += option.size();
+			auth = flags.substr(offset, flags.find(' ', offset) - offset);
 		}
 
 	}
 
-	for (const auto& e : hookSymbols.hooks7) {
-		fixups.push_back(e.second);
-	}
-
-	for (const auto& e : hookSymbols.hooks9) {
-		fixups.push_back(e.second);
+	if (auth.empty()) {
+		return;
 	}
 
-	std::sort(fixups.begin(), fixups.end(), [](const Fixup& a, const Fixup& b) {
-
-		CodeTarget ca = invalidTarget;
-		CodeTarget cb = invalidTarget;
-		bool pa = std::holds_alternative<Patch>(a);
-		bool pb = std::holds_alternative<Patch>(b);
+#ifdef _WIN32
 
-		if (pa) {
-			ca = std::get<Patch>(a).codeTarget;
-		} else {
-			ca = std::get<Hook>(a).codeTarget;
-		}
+	server.semaphore = OpenSemaphoreA(SYNCHRONIZE | SEMAPHORE_MODIFY_STATE, FALSE, auth.c_str());
 
-		if (pb) {
-			cb = std::get<Patch>(b).codeTarget;
-		} else {
-			cb = std::get<Hook>(b).codeTarget;
-		}
+	if (!server.semaphore) {
+		std::cout << DWARNING << "Failed to open jobserver semaphore " << auth << ", ignoring jobserver" << std::endl;
+		return;
+	}
 
-		if (ca == cb) {
+#else
 
-			if (pa && pb) {
+	if (auth.starts_with("fifo:")) {
 
-				u32 ba = std::get<Patch>(a).bssSize;
-				u32 bb = std::get<Patch>(b).bssSize;
+		server.readFd = open(auth.substr(5).c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+		server.writeFd = server.readFd;
 
-				return ba > bb;
+	} else if (u64 separator = auth.find(','); separator != std::string::npos) {
 
-			} else {
+		server.readFd = std::atoi(auth.substr(0, separator).c_str());
+		server.writeFd = std::atoi(auth.substr(separator + 1).c_str());
 
-				return pb;
+		//A private non-blocking description of the pipe keeps a lost token race from blocking a worker
+		int readFd = open(("/proc/self/fd/" + std::to_string(server.readFd)).c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
 
-			}
+		if (readFd >= 0) {
+			server.readFd = readFd;
+		}
 
-		} else {
+	}
 
-			return ca < cb;
+	//make only passes its descriptors to recipes marked as recursive
+	if (server.readFd < 0 || fcntl(server.readFd, F_GETFD) < 0 || fcntl(server.writeFd, F_GETFD) < 0) {
+		std::cout << DWARNING << "Jobserver " << auth << " is not accessible, ignoring jobserver" << std::endl;
+		server.readFd = -1;
+		server.writeFd = -1;
+		return;
+	}
 
-		}
+#endif
 
-	});
+	server.client = true;
 
-	return true;
+	std::cout << DINFO << "Using jobserver " << auth << std::endl;
 
 }
 
 
 
-bool createObjectDirectories(const BuildSettings& settings) {
+#ifdef _WIN32
 
-	RETURN_ON_ERROR(createDirectory(settings.objectDir, "object"))
-		const fs::path& sourcePath = settings.sourceDir;
+bool acquireJobToken(JobServer& server, s32& token, const std::function<bool()>& keepWaiting) {
 
-	for (const fs::path& source : fs::recursive_directory_iterator(sourcePath)) {
+	token = -1;
 
-		if (fs::is_directory(source)) {
+	if (!server.client) {
+		return true;
+	}
 
-			fs::path objectDir = settings.objectDir / fs::relative(source, settings.sourceDir);
+	while (keepWaiting()) {
 
-			if (fs::exists(objectDir) && fs::is_directory(objectDir)) {
-				continue;
-			}
+		DWORD result = WaitForSingleObject(server.semaphore, 50);
 
-			RETURN_ON_ERROR(createDirectory(objectDir, "object"))
+		if (result == WAIT_OBJECT_0) {
+			token = 0;
+			return true;
+		}
 
+		if (result != WAIT_TIMEOUT) {
+			std::cout << DWARNING << "Failed to acquire jobserver token, ignoring jobserver" << std::endl;
+			server.client = false;
+			return true;
 		}
 
 	}
 
-	return true;
+	return false;
 
 }
 
 
 
-bool createDependencyDirectories(const BuildSettings& settings) {
+void releaseJobToken(JobServer& server, s32 token) {
 
-	RETURN_ON_ERROR(createDirectory(settings.depsDir, "dependency"))
-		const fs::path& sourcePath = settings.sourceDir;
+	if (token >= 0) {
+		ReleaseSemaphore(server.semaphore, 1, nullptr);
+	}
 
-	for (const fs::path& source : fs::recursive_directory_iterator(sourcePath)) {
+}
 
-		if (fs::is_directory(source)) {
 
-			fs::path depsDir = settings.depsDir / fs::relative(source, settings.sourceDir);
 
-			if (fs::exists(depsDir) && fs::is_directory(depsDir)) {
-				continue;
-			}
+bool startJobServer(JobServer& server, u32 slots) {
 
-			RETURN_ON_ERROR(createDirectory(depsDir, "dependency"))
+	if (server.client || slots < 2) {
+		return true;
+	}
 
-		}
+	const std::string& name = "fireflower_jobserver_" + std::to_string(GetCurrentProcessId());
+	server.semaphore = CreateSemaphoreA(nullptr, slots - 1, slots - 1, name.c_str());
 
+	if (!server.semaphore) {
+		std::cout << DERROR << "Failed to create jobserver semaphore" << std::endl;
+		return false;
 	}
 
-	return true;
+	const char* parentFlags = std::getenv("MAKEFLAGS");
+	server.makeFlagsSet = parentFlags;
+	server.makeFlags = parentFlags ? parentFlags : "";
 
-}
+	const std::string& makeFlags = "-j" + std::to_string(slots) + " --jobserver-auth=" + name;
+	_putenv_s("MAKEFLAGS", makeFlags.c_str());
 
+	return true;
 
+}
 
 
-void loadDependencies(const BuildSettings& settings, DependencyTracker& tracker) {
 
-	std::cout << DINFO << "Loading dependencies" << std::endl;
+void stopJobServer(JobServer& server) {
 
-	fs::path trackerPath = settings.buildDir / "tracker.bin";
+	if (server.client || !server.semaphore) {
+		return;
+	}
 
-	tracker.jsonLastModifiedTime = timeLastModified(jsonPath);
+	//An empty value removes the variable
+	_putenv_s("MAKEFLAGS", server.makeFlags.c_str());
+	CloseHandle(server.semaphore);
+	server.semaphore = nullptr;
 
-	if (fs::exists(trackerPath) && fs::is_regular_file(trackerPath) && fs::file_size(trackerPath) > 8) {
+}
 
-		std::ifstream trackerFile(trackerPath, std::ios::in | std::ios::binary);
+#else
 
-		if (!trackerFile.is_open()) {
-			std::cout << DERROR << "Failed to open tracking file " << trackerPath.string() << std::endl;
-			return;
-		}
+bool acquireJobToken(JobServer& server, s32& token, const std::function<bool()>& keepWaiting) {
 
-		trackerFile.read(reinterpret_cast<char*>(&tracker.jsonTrackedModifiedTime), 8);
+	token = -1;
 
-		if (trackerFile.peek() != EOF) {
+	if (!server.client) {
+		return true;
+	}
 
-			while (true) {
+	u8 c = 0;
 
-				u16 length = 0;
-				trackerFile.read(reinterpret_cast<char*>(&length), 2);
+	//Polls in short intervals so that waiting threads notice when no work is left
+	while (keepWaiting()) {
 
-				std::string entry;
-				entry.resize(length);
-				trackerFile.read(&entry[0], length);
+		pollfd pollInfo{ server.readFd, POLLIN, 0 };
+		int ready = poll(&pollInfo, 1, 50);
 
-				u64 date = 0;
-				trackerFile.read(reinterpret_cast<char*>(&date), 8);
+		if (ready < 0 && errno == EINTR) {
+			continue;
+		}
 
-				fs::path p(entry);
+		if (ready < 0) {
+			break;
+		}
 
-				if (fs::exists(p) && fs::is_regular_file(p)) {
-					tracker.dependencies[entry] = date;
-				}
+		if (!ready) {
+			continue;
+		}
 
-				if (trackerFile.peek() == EOF) {
-					break;
-				}
+		ssize_t bytesRead = read(server.readFd, &c, 1);
 
-			}
+		if (bytesRead == 1) {
+			token = c;
+			return true;
+		}
 
+		//Another client may have taken the token between poll and read
+		if (bytesRead < 0 && errno != EINTR && errno != EAGAIN) {
+			break;
 		}
 
-		trackerFile.close();
+	}
 
+	if (!keepWaiting()) {
+		return false;
 	}
 
-}
+	std::cout << DWARNING << "Failed to acquire jobserver token: " << std::strerror(errno) << ", ignoring jobserver" << std::endl;
+	server.client = false;
 
+	return true;
 
+}
 
 
 
-void trackDependencies(const BuildSettings& settings, DependencyTracker& tracker, const fs::path& dep, bool old) {
+void releaseJobToken(JobServer& server, s32 token) {
 
-	if (!fs::exists(dep) || !fs::is_regular_file(dep)) {
-		std::cout << DWARNING << "Dependency file " << dep.string() << " not generated, disabling dependency tracking for target" << std::endl;
+	if (token < 0) {
 		return;
 	}
 
-	std::ifstream depsFile(dep, std::ios::in);
+	u8 c = token;
 
-	if (!depsFile.is_open()) {
-		std::cout << DERROR << "Failed to open dependency file " << dep.string() << std::endl;
-		return;
-	}
+	while (write(server.writeFd, &c, 1) < 0 && errno == EINTR);
 
-	std::string line;
-	fs::path subDep;
-	std::getline(depsFile, line);
+}
 
-	while (std::getline(depsFile, line)) {
 
-		if (line.back() == '\\') {
-			line = line.substr(1, line.length() - 3);
-		} else {
-			line = line.substr(1, line.length() - 1);
-		}
 
-		//Fix for the dependency path bug from GCC
-		if (u32 bugOffset = line.find("\\:"); bugOffset != std::string::npos) {
-			line.replace(bugOffset, 2, ":");
-		}
+bool startJobServer(JobServer& server, u32 slots) {
 
-		subDep = fs::path(line);
-		std::string subDepString = getPathString(subDep);
+	if (server.client || slots < 2) {
+		return true;
+	}
 
-		if (old) {
+	//Left inheritable on purpose so that the pre-/post-build command and its children can reach them
+	int pipeFds[2];
 
-			if (!tracker.oldTrackers.contains(subDepString)) {
-				tracker.oldTrackers[subDepString] = tracker.dependencies[subDepString];
-			}
+	if (pipe(pipeFds)) {
+		std::cout << DERROR << "Failed to create jobserver pipe: " << std::strerror(errno) << std::endl;
+		return false;
+	}
 
-		} else {
+	const std::string tokens(slots - 1, '+');
 
-			if (!tracker.trackers.contains(subDepString)) {
-				tracker.trackers[subDepString] = timeLastModified(subDep);
-			}
+	if (write(pipeFds[1], tokens.data(), tokens.size()) != static_cast<ssize_t>(tokens.size())) {
+		std::cout << DERROR << "Failed to fill jobserver pipe: " << std::strerror(errno) << std::endl;
+		close(pipeFds[0]);
+		close(pipeFds[1]);
+		return false;
+	}
 
-		}
+	server.readFd = pipeFds[0];
+	server.writeFd = pipeFds[1];
 
-	}
+	const std::string& fds = std::to_string(server.readFd) + "," + std::to_string(server.writeFd);
+	const char* parentFlags = std::getenv("MAKEFLAGS");
+	server.makeFlagsSet = parentFlags;
+	server.makeFlags = parentFlags ? parentFlags : "";
 
-	depsFile.close();
+	const std::string& makeFlags = "-j" + std::to_string(slots) + " --jobserver-fds=" + fds + " --jobserver-auth=" + fds;
+	setenv("MAKEFLAGS", makeFlags.c_str(), 1);
 
-}
+	return true;
 
+}
 
 
 
-void saveDependencies(const BuildSettings& settings, DependencyTracker& tracker) {
+void stopJobServer(JobServer& server) {
 
-	fs::path trackerPath = settings.buildDir / "tracker.bin";
+	if (server.client || server.readFd < 0) {
+		return;
+	}
 
-	if (fs::exists(trackerPath) && fs::is_regular_file(trackerPath)) {
-		removeFile(trackerPath, "tracker");
+	if (server.makeFlagsSet) {
+		setenv("MAKEFLAGS", server.makeFlags.c_str(), 1);
+	} else {
+		unsetenv("MAKEFLAGS");
 	}
 
-	for (auto& e : tracker.oldTrackers) {
+	close(server.readFd);
+	close(server.writeFd);
+	server.readFd = -1;
+	server.writeFd = -1;
 
-		if (!tracker.trackers.contains(e.first)) {
-			tracker.trackers[e.first] = e.second;
-		}
+}
 
-	}
+#endif
 
-	std::ofstream trackerFile(trackerPath, std::ios::out | std::ios::binary);
 
-	if (!trackerFile.is_open()) {
-		std::cout << DERROR << "Failed to open tracking file " << trackerPath.string() << std::endl;
-		return;
-	}
+#ifdef _WIN32
 
-	trackerFile.write(reinterpret_cast<const char*>(&tracker.jsonLastModifiedTime), 8);
+bool openFileWatcher(FileWatcher& watcher) {
+	return true;
+}
 
-	for (auto& e : tracker.trackers) {
 
-		std::string path = getPathString(e.first);
-		u16 length = path.length();
-		u64 date = e.second;
-		trackerFile.write(reinterpret_cast<const char*>(&length), 2);
-		trackerFile.write(reinterpret_cast<const char*>(&path[0]), length);
-		trackerFile.write(reinterpret_cast<const char*>(&date), 8);
 
+bool addWatchDirectory(FileWatcher& watcher, const fs::path& dir, bool recursive) {
+
+	WatchedDirectory* directory = new WatchedDirectory{};
+
+	directory->path = dir;
+	directory->recursive = recursive;
+	directory->handle = CreateFileW(dir.c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+	directory->overlapped.hEvent = CreateEventA(nullptr, FALSE, FALSE, nullptr);
+
+	watcher.directories.push_back(directory);
+
+	if (directory->handle == INVALID_HANDLE_VALUE || !directory->overlapped.hEvent || !readDirectoryChanges(*directory)) {
+		std::cout << DERROR << "Failed to watch directory " << dir.string() << std::endl;
+		return false;
 	}
 
-	trackerFile.close();
+	return true;
 
 }
 
 
 
+bool readDirectoryChanges(WatchedDirectory& directory) {
 
-bool needsCompilation(const BuildSettings& settings, const DependencyTracker& tracker, const fs::path& source) {
+	constexpr DWORD notifyFilter = FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE;
 
-	fs::path depsPath = getDependencyPath(settings, source);
-	std::string srcString = getPathString(source);
-
-	if (jsonChanged(tracker)) {
-		return true;
-	}
+	return ReadDirectoryChangesW(directory.handle, directory.buffer, sizeof(directory.buffer), directory.recursive, notifyFilter, nullptr, &directory.overlapped, nullptr);
 
-	if (!tracker.dependencies.contains(srcString)) {
-		return true;
-	}
+}
 
-	if (timeLastModified(source) > tracker.dependencies.at(srcString)) {
-		return true;
-	}
 
 
-	if (!fs::exists(depsPath) || !fs::is_regular_file(depsPath)) {
-		return true;
-	}
+bool waitFileChanges(FileWatcher& watcher, std::set<fs::path>& changes) {
 
-	std::ifstream depsFile(depsPath, std::ios::in);
+	std::vector<HANDLE> events;
+	DWORD timeout = INFINITE;
 
-	if (!depsFile.is_open()) {
-		std::cout << DERROR << "Failed to open dependency file " << depsPath.string() << std::endl;
-		return true;
+	for (const WatchedDirectory* directory : watcher.directories) {
+		events.push_back(directory->overlapped.hEvent);
 	}
 
-	std::string line;
-	fs::path subDep;
-	std::getline(depsFile, line);
-	std::getline(depsFile, line);
+	while (true) {
 
-	while (std::getline(depsFile, line)) {
+		DWORD result = WaitForMultipleObjects(events.size(), events.data(), FALSE, timeout);
 
-		if (line.back() == '\\') {
-			line = line.substr(1, line.length() - 3);
-		} else {
-			line = line.substr(1, line.length() - 1);
+		if (result == WAIT_TIMEOUT) {
+			return true;
 		}
 
-		//Fix for the dependency path bug from GCC
-		if (u32 bugOffset = line.find("\\:"); bugOffset != std::string::npos) {
-			line.replace(bugOffset, 2, ":");
+		if (result >= WAIT_OBJECT_0 + events.size()) {
+			std::cout << DERROR << "Failed to wait for file changes" << std::endl;
+			return false;
 		}
 
-		subDep = fs::path(line);
-		std::string subDepString = getPathString(subDep);
+		WatchedDirectory& directory = *watcher.directories[result - WAIT_OBJECT_0];
+		DWORD bytesRead = 0;
 
-		if (!(fs::exists(subDep) && fs::is_regular_file(subDep) && tracker.dependencies.contains(subDepString) && timeLastModified(subDep) == tracker.dependencies.at(subDepString))) {
-			std::cout << subDep << "; " << timeLastModified(subDep) << "; " << tracker.dependencies.at(subDepString) << std::endl;
-			depsFile.close();
-			return true;
+		if (!GetOverlappedResult(directory.handle, &directory.overlapped, &bytesRead, FALSE)) {
+			std::cout << DERROR << "Failed to read changes of directory " << directory.path.string() << std::endl;
+			return false;
 		}
 
-	}
+		if (!bytesRead) {
 
-	depsFile.close();
+			//The notification buffer overflowed, so the whole directory has to be considered changed
+			changes.insert(directory.path);
 
-	return false;
+		} else {
 
-}
+			const u8* buffer = directory.buffer;
 
+			while (true) {
 
+				const FILE_NOTIFY_INFORMATION* info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(buffer);
+				changes.insert(directory.path / std::wstring(info->FileName, info->FileNameLength / sizeof(WCHAR)));
 
-void deleteUnreferencedObjects(const BuildSettings& settings, const DependencyTracker& tracker) {
+				if (!info->NextEntryOffset) {
+					break;
+				}
 
-	std::vector<fs::path> purgePaths;
+				buffer += info->NextEntryOffset;
 
-	for (const fs::path& object : fs::recursive_directory_iterator(settings.objectDir)) {
+			}
 
-		if (fs::is_regular_file(object)) {
+		}
 
-			std::string objectString = getPathString(object);
+		if (!readDirectoryChanges(directory)) {
+			std::cout << DERROR << "Failed to watch directory " << directory.path.string() << std::endl;
+			return false;
+		}
 
-			if (!tracker.compilationObjects.contains(objectString)) {
+		//Editors tend to save in several steps, so wait for the burst to settle
+		timeout = 50;
 
-				purgePaths.push_back(object);
-				purgePaths.push_back((settings.depsDir / fs::relative(object, settings.objectDir)).replace_extension(".d"));
+	}
 
-			}
+}
 
-		}
 
-	}
 
-	for (const fs::path& object : fs::recursive_directory_iterator(settings.objectDir)) {
+void closeFileWatcher(FileWatcher& watcher) {
 
-		if (fs::is_directory(object) && fs::is_empty(object)) {
+	for (WatchedDirectory* directory : watcher.directories) {
 
-			purgePaths.push_back(object);
-			purgePaths.push_back(settings.depsDir / fs::relative(object, settings.objectDir));
+		if (directory->handle != INVALID_HANDLE_VALUE) {
+			CancelIo(directory->handle);
+			CloseHandle(directory->handle);
+		}
 
+		if (directory->overlapped.hEvent) {
+			CloseHandle(directory->overlapped.hEvent);
 		}
 
-	}
+		delete directory;
 
-	for (const fs::path& p : purgePaths) {
-		removeFile(p, "orphaned");
 	}
 
+	watcher.directories.clear();
+
 }
 
+#else
 
+bool openFileWatcher(FileWatcher& watcher) {
 
-bool loadARMBinaryProperties(const BuildSettings& settings, CodeTarget target, const std::vector<u8>& binary, ARMBinaryProperties& properties) {
+	watcher.fd = inotify_init1(IN_CLOEXEC);
 
-	if (!isBinary(target)) {
-		std::cout << DERROR << "Target " << getCodeTargetName(target) << " does not represent a valid ARM binary target" << std::endl;
+	if (watcher.fd < 0) {
+		std::cout << DERROR << "Failed to initialize file watcher: " << std::strerror(errno) << std::endl;
 		return false;
 	}
 
-	std::vector<u8> header;
-	RETURN_ON_ERROR(loadROMHeader(settings, header))
+	return true;
 
-	bool arm9 = target == arm9Target;
-	u32 armEntry = *reinterpret_cast<const u32*>(&header[0x24 + !arm9 * 0x10]);
-	u32 armOffset = *reinterpret_cast<const u32*>(&header[0x28 + !arm9 * 0x10]);
-	u32 armSize = binary.size();
-	u32 entryOffset = armEntry - armOffset;
-	u32 moduleParams = -1;
-	u32 a, b, c;
+}
 
-	if (arm9) {
 
-		for (u32 i = entryOffset; i < (armSize - 4) && i < (entryOffset + 0x400); i += 4) {
 
-			a = *reinterpret_cast<const u32*>(&binary[i + 0]);
-			b = *reinterpret_cast<const u32*>(&binary[i + 4]);
+bool addWatchDirectory(FileWatcher& watcher, const fs::path& dir, bool recursive) {
 
-			if (a == 0xDEC00621 && b == 0x2106C0DE) {
-				moduleParams = i - 0x1C;
-			}
+	constexpr u32 watchMask = IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR;
 
-		}
+	int wd = inotify_add_watch(watcher.fd, dir.c_str(), watchMask);
 
-	} else {
+	if (wd < 0) {
+		std::cout << DERROR << "Failed to watch directory " << dir.string() << ": " << std::strerror(errno) << std::endl;
+		return false;
+	}
 
-		for (u32 i = entryOffset; i < (armSize - 8) && i < (entryOffset + 0x1A0); i += 4) {
+	watcher.directories[wd] = WatchedDirectory{ dir, recursive };
 
-			a = *reinterpret_cast<const u32*>(&binary[i + 0]);
-			b = *reinterpret_cast<const u32*>(&binary[i + 4]);
-			c = *reinterpret_cast<const u32*>(&binary[i + 8]);
+	if (!recursive) {
+		return true;
+	}
 
-			if (a == 0xE5901000 && b == 0xE5902004 && c == 0xE5903008 && i) {
+	//inotify watches are not recursive, so every subdirectory needs its own
+	std::error_code ec;
 
-				a = *reinterpret_cast<const u32*>(&binary[i - 4]);
+	for (const fs::directory_entry& entry : fs::directory_iterator(dir, ec)) {
 
-				if ((a & 0xFFFFF000) == 0xE59F0000) {
+		if (entry.is_directory(ec) && !entry.is_symlink(ec)) {
+			RETURN_ON_ERROR(addWatchDirectory(watcher, entry.path(), true))
+		}
 
-					a &= 0xFFF;
-					a += i + 4;
+	}
 
-					if (a < armSize) {
+	return true;
+
+}
 
-						a = *reinterpret_cast<const u32*>(&binary[a]);
-						a -= armOffset;
 
-						if (a < armSize) {
-							moduleParams = a;
-						}
 
-					}
+bool waitFileChanges(FileWatcher& watcher, std::set<fs::path>& changes) {
 
-				}
+	alignas(inotify_event) char buffer[0x4000];
+	int timeout = -1;
 
-			}
+	while (true) {
+
+		pollfd pollInfo{ watcher.fd, POLLIN, 0 };
+		int ready = poll(&pollInfo, 1, timeout);
 
+		if (ready < 0 && errno == EINTR) {
+			continue;
 		}
 
-	}
+		if (ready < 0) {
+			std::cout << DERROR << "Failed to wait for file changes: " << std::strerror(errno) << std::endl;
+			return false;
+		}
 
-	if (moduleParams == -1) {
-		std::cout << DERROR << "Failed to find crt0 module params" << std::endl;
-		return false;
-	}
+		if (!ready) {
+			return true;
+		}
 
-	properties.offset = armOffset;
-	properties.moduleParams = moduleParams;
-	properties.autoloadStart = *reinterpret_cast<const u32*>(&binary[moduleParams + 0x0]) - armOffset;
-	properties.autoloadEnd = *reinterpret_cast<const u32*>(&binary[moduleParams + 0x4]) - armOffset;
-	properties.autoloadRead = *reinterpret_cast<const u32*>(&binary[moduleParams + 0x8]) - armOffset;
-	properties.compressedEnd = *reinterpret_cast<const u32*>(&binary[moduleParams + 0x14]);
+		ssize_t bytesRead = read(watcher.fd, buffer, sizeof(buffer));
 
-	if (properties.compressedEnd != 0) {
-		properties.compressedEnd -= armOffset;
-	}
+		if (bytesRead < 0 && (errno == EINTR || errno == EAGAIN)) {
+			continue;
+		}
 
-	return true;
+		if (bytesRead < 0) {
+			std::cout << DERROR << "Failed to read file changes: " << std::strerror(errno) << std::endl;
+			return false;
+		}
 
-}
+		for (ssize_t i = 0; i < bytesRead; ) {
 
+			const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + i);
+			i += sizeof(inotify_event) + event->len;
 
+			if (event->mask & IN_Q_OVERFLOW) {
 
-bool executePrebuildCommand(const BuildSettings& buildSettings) {
+				//Events were lost, so every watched directory has to be considered changed
+				for (const auto& e : watcher.directories) {
+					changes.insert(e.second.path);
+				}
 
-	const std::string& cmd = buildSettings.prebuildCmd;
+				continue;
 
-	if (cmd.empty()) {
-		return true;
-	}
+			}
 
-	std::cout << DINFO << "Executing pre-build step command \"" << cmd << "\"" << std::endl;
-	int status = std::system(cmd.c_str());
+			if (!watcher.directories.contains(event->wd)) {
+				continue;
+			}
 
-	if (status) {
-		std::cout << DERROR << "Pre-build step returned " << status << std::endl;
-		return false;
-	}
+			if (event->mask & IN_IGNORED) {
+				watcher.directories.erase(event->wd);
+				continue;
+			}
 
-	return true;
+			if (!event->len) {
+				continue;
+			}
 
-}
+			WatchedDirectory directory = watcher.directories.at(event->wd);
+			fs::path p = directory.path / event->name;
 
+			if ((event->mask & IN_ISDIR) && (event->mask & (IN_CREATE | IN_MOVED_TO)) && directory.recursive) {
+				addWatchDirectory(watcher, p, true);
+			}
 
+			changes.insert(p);
 
-bool executePostbuildCommand(const BuildSettings& buildSettings) {
+		}
 
-	const std::string& cmd = buildSettings.postbuildCmd;
+		//Editors tend to save in several steps, so wait for the burst to settle
+		timeout = 50;
 
-	if (cmd.empty()) {
-		return true;
 	}
 
-	std::cout << DINFO << "Executing post-build step command \"" << cmd << "\"" << std::endl;
-	int status = std::system(cmd.c_str());
+}
 
-	if (status) {
-		std::cout << DERROR << "Post-build step returned " << status << std::endl;
-		return false;
+
+
+void closeFileWatcher(FileWatcher& watcher) {
+
+	if (watcher.fd >= 0) {
+		close(watcher.fd);
 	}
 
-	return true;
+	watcher.fd = -1;
+	watcher.directories.clear();
 
 }
 
+#endif
+
 
 
 bool removeFile(const fs::path& p, const std::string& name) {
@@ -3297,7 +8818,145 @@ std::string getHexString(u32 hex) {
 
 
 
-bool getSourceSet(const Value& v, const std::string& key, const fs::path& sourceDir, std::set<fs::path>& paths) {
+bool scanFileTree(const fs::path& root, FileTree& tree) {
+
+	std::error_code ec;
+	fs::directory_entry rootEntry(root, ec);
+
+	if (ec || !rootEntry.exists(ec)) {
+		return true;
+	}
+
+	addFileTreeEntry(tree, rootEntry);
+
+	if (!rootEntry.is_directory(ec)) {
+		return true;
+	}
+
+	fs::recursive_directory_iterator it(root, ec);
+
+	for (; !ec && it != fs::recursive_directory_iterator(); it.increment(ec)) {
+		addFileTreeEntry(tree, *it);
+	}
+
+	if (ec) {
+		std::cout << DERROR << "Failed to scan directory " << root.string() << ": " << ec.message() << std::endl;
+		return false;
+	}
+
+	return true;
+
+}
+
+
+
+void addFileTreeEntry(FileTree& tree, const fs::directory_entry& entry) {
+
+	std::error_code ec;
+	FileTreeEntry& treeEntry = tree.entries[getFileTreeKey(entry.path())];
+
+	treeEntry.path = entry.path();
+	treeEntry.type = entry.status(ec).type();
+	treeEntry.time = 0;
+	treeEntry.size = 0;
+
+	if (treeEntry.type == fs::file_type::regular) {
+		treeEntry.time = std::chrono::duration_cast<std::chrono::milliseconds>(entry.last_write_time(ec).time_since_epoch()).count();
+		treeEntry.size = entry.file_size(ec);
+	}
+
+}
+
+
+
+const FileTreeEntry* findFileTreeEntry(const FileTree& tree, const fs::path& p) {
+
+	auto it = tree.entries.find(getFileTreeKey(p));
+
+	return it != tree.entries.end() ? &it->second : nullptr;
+
+}
+
+
+
+void listFileTree(const FileTree& tree, const fs::path& dir, std::vector<const FileTreeEntry*>& entries) {
+
+	const std::string& prefix = getFileTreeKey(dir) + "/";
+
+	for (auto it = tree.entries.lower_bound(prefix); it != tree.entries.end() && it->first.starts_with(prefix); ++it) {
+		entries.push_back(&it->second);
+	}
+
+}
+
+
+
+std::string getFileTreeKey(const fs::path& p) {
+
+	std::string key = getPathString(p);
+
+	while (key.size() > 1 && key.back() == '/') {
+		key.pop_back();
+	}
+
+	return key;
+
+}
+
+
+bool refreshFileTree(FileTree& tree, const fs::path& p) {
+
+	const std::string& key = getFileTreeKey(p);
+	bool existed = tree.entries.contains(key);
+	bool wasDirectory = existed && tree.entries.at(key).type == fs::file_type::directory;
+
+	eraseFileTree(tree, p);
+
+	std::error_code ec;
+	fs::directory_entry entry(p, ec);
+
+	if (ec || !entry.exists(ec)) {
+		return existed;
+	}
+
+	scanFileTree(p, tree);
+
+	//Plain file edits keep the tree layout intact
+	return !existed || wasDirectory || entry.is_directory(ec);
+
+}
+
+
+
+void eraseFileTree(FileTree& tree, const fs::path& p) {
+
+	const std::string& key = getFileTreeKey(p);
+	const std::string& prefix = key + "/";
+
+	tree.entries.erase(key);
+
+	auto it = tree.entries.lower_bound(prefix);
+
+	while (it != tree.entries.end() && it->first.starts_with(prefix)) {
+		it = tree.entries.erase(it);
+	}
+
+}
+
+
+
+bool isSubpath(const fs::path& p, const fs::path& dir) {
+
+	const std::string& key = getFileTreeKey(p);
+	const std::string& dirKey = getFileTreeKey(dir);
+
+	return key == dirKey || key.starts_with(dirKey + "/");
+
+}
+
+
+
+bool getSourceSet(const Value& v, const std::string& key, const fs::path& sourceDir, const FileTree& tree, std::set<fs::path>& paths) {
 
 	const Value& x = v[key.c_str()];
 
@@ -3306,20 +8965,33 @@ bool getSourceSet(const Value& v, const std::string& key, const fs::path& source
 		for (auto& e : x.GetArray()) {
 
 			fs::path p = sourceDir / e.GetString();
+			FileTree pathTree;
+			const FileTree* searchTree = &tree;
+			const FileTreeEntry* entry = findFileTreeEntry(tree, p);
+
+			//Paths outside of the source directory are not part of the initial scan
+			if (!entry) {
+				RETURN_ON_ERROR(scanFileTree(p, pathTree))
+				searchTree = &pathTree;
+				entry = findFileTreeEntry(pathTree, p);
+			}
+
+			if (entry) {
 
-			if (fs::exists(p)) {
+				if (entry->type == fs::file_type::directory) {
 
-				if (fs::is_directory(p)) {
+					std::vector<const FileTreeEntry*> entries;
+					listFileTree(*searchTree, p, entries);
 
-					for (const fs::path& s : fs::recursive_directory_iterator(p)) {
+					for (const FileTreeEntry* s : entries) {
 
-						if (fs::is_regular_file(s) && isCompilableFile(s)) {
-							paths.insert(s);
+						if (s->type == fs::file_type::regular && isCompilableFile(s->path)) {
+							paths.insert(s->path);
 						}
 
 					}
 
-				} else if (fs::is_regular_file(p)) {
+				} else if (entry->type == fs::file_type::regular) {
 
 					if (isCompilableFile(p)) {
 						paths.insert(p);
@@ -3352,11 +9024,16 @@ bool getSourceSet(const Value& v, const std::string& key, const fs::path& source
 
 
 
-void scanDefaultTarget(CodeTargetMap& codeTargets, CodeTarget target, const fs::path& sourceDir) {
+void scanDefaultTarget(CodeTargetMap& codeTargets, CodeTarget target, const fs::path& sourceDir, const FileTree& tree) {
 
-	for (const fs::path& p : fs::recursive_directory_iterator(sourceDir)) {
+	std::vector<const FileTreeEntry*> entries;
+	listFileTree(tree, sourceDir, entries);
 
-		if (fs::is_regular_file(p)) {
+	for (const FileTreeEntry* entry : entries) {
+
+		const fs::path& p = entry->path;
+
+		if (entry->type == fs::file_type::regular) {
 
 			if (!isCompilableFile(p)) {
 				continue;
@@ -3391,12 +9068,36 @@ std::string getPathString(const fs::path& p) {
 
 
 fs::path getObjectPath(const BuildSettings& settings, const fs::path& src) {
-	return (settings.objectDir / fs::relative(src, settings.sourceDir)).replace_extension(".o");
+
+	//Unity sources are generated into the build tree and keep their outputs next to them
+	if (isSubpath(src, settings.unityDir)) {
+		return fs::path(src).replace_extension(".o");
+	}
+
+	return (settings.objectDir / src.lexically_relative(settings.sourceDir)).replace_extension(".o");
+
 }
 
 
 fs::path getDependencyPath(const BuildSettings& settings, const fs::path& src) {
-	return (settings.depsDir / fs::relative(src, settings.sourceDir)).replace_extension(".d");
+
+	if (isSubpath(src, settings.unityDir)) {
+		return fs::path(src).replace_extension(".d");
+	}
+
+	return (settings.depsDir / src.lexically_relative(settings.sourceDir)).replace_extension(".d");
+
+}
+
+
+
+fs::path getLinkerInputPath(const BuildSettings& settings, const fs::path& src) {
+
+	//Objects are passed to the linker relative to its search directory
+	const fs::path& objectPath = getObjectPath(settings, src);
+
+	return isSubpath(objectPath, settings.objectDir) ? objectPath.lexically_relative(settings.objectDir) : objectPath;
+
 }
 
 
@@ -3407,6 +9108,136 @@ u64 timeLastModified(const fs::path& p) {
 
 
 
+u64 hashData(const u8* data, u64 size, u64 seed) {
+
+	//XXH64
+	constexpr u64 prime1 = 0x9E3779B185EBCA87;
+	constexpr u64 prime2 = 0xC2B2AE3D27D4EB4F;
+	constexpr u64 prime3 = 0x165667B19E3779F9;
+	constexpr u64 prime4 = 0x85EBCA77C2B2AE63;
+	constexpr u64 prime5 = 0x27D4EB2F165667C5;
+
+	auto rotl = [](u64 x, u32 r) {
+		return (x << r) | (x >> (64 - r));
+	};
+
+	auto round = [&](u64 acc, u64 lane) {
+		return rotl(acc + lane * prime2, 31) * prime1;
+	};
+
+	auto merge = [&](u64 acc, u64 v) {
+		return (acc ^ round(0, v)) * prime1 + prime4;
+	};
+
+	auto read64 = [](const u8* p) {
+		u64 v;
+		std::memcpy(&v, p, 8);
+		return v;
+	};
+
+	auto read32 = [](const u8* p) {
+		u32 v;
+		std::memcpy(&v, p, 4);
+		return v;
+	};
+
+	const u8* p = data;
+	const u8* end = data + size;
+	u64 h = 0;
+
+	if (size >= 32) {
+
+		u64 v1 = seed + prime1 + prime2;
+		u64 v2 = seed + prime2;
+		u64 v3 = seed;
+		u64 v4 = seed - prime1;
+
+		while (p + 32 <= end) {
+			v1 = round(v1, read64(p));
+			v2 = round(v2, read64(p + 8));
+			v3 = round(v3, read64(p + 16));
+			v4 = round(v4, read64(p + 24));
+			p += 32;
+		}
+
+		h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+		h = merge(h, v1);
+		h = merge(h, v2);
+		h = merge(h, v3);
+		h = merge(h, v4);
+
+	} else {
+
+		h = seed + prime5;
+
+	}
+
+	h += size;
+
+	while (p + 8 <= end) {
+		h = rotl(h ^ round(0, read64(p)), 27) * prime1 + prime4;
+		p += 8;
+	}
+
+	if (p + 4 <= end) {
+		h = rotl(h ^ (read32(p) * prime1), 23) * prime2 + prime3;
+		p += 4;
+	}
+
+	while (p < end) {
+		h = rotl(h ^ (*p * prime5), 11) * prime1;
+		p++;
+	}
+
+	h ^= h >> 33;
+	h *= prime2;
+	h ^= h >> 29;
+	h *= prime3;
+	h ^= h >> 32;
+
+	//Zero is reserved for 'not hashed'
+	return h ? h : 1;
+
+}
+
+
+
+u64 getCommandFingerprint(const std::vector<std::string>& args) {
+
+	std::string cmd;
+
+	for (const std::string& arg : args) {
+		cmd += arg;
+		cmd += '\0';
+	}
+
+	return hashData(reinterpret_cast<const u8*>(cmd.data()), cmd.size());
+
+}
+
+
+
+bool hashFile(const fs::path& p, u64& hash) {
+
+	std::ifstream file(p, std::ios::in | std::ios::binary);
+
+	if (!file.is_open()) {
+		std::cout << DERROR << "Failed to open " << p.string() << " for hashing" << std::endl;
+		return false;
+	}
+
+	std::vector<u8> data(fs::file_size(p));
+	file.read(reinterpret_cast<char*>(data.data()), data.size());
+	file.close();
+
+	hash = hashData(data.data(), data.size());
+
+	return true;
+
+}
+
+
+
 std::string jsonGetTypename(const Value& v) {
 
 	static const char* kTypeNames[] = { "Null", "False", "True", "Object", "Array", "String", "Number" };
@@ -3566,4 +9397,36 @@ bool jsonReadDirArray(const Value& v, const std::string& key, std::vector<fs::pa
 
 	return true;
 
+}
+
+
+
+bool jsonReadPathArray(const Value& v, const std::string& key, std::vector<fs::path>& paths, bool forceExist) {
+
+	const Value& x = v[key.c_str()];
+
+	if (x.IsArray()) {
+
+		for (auto& i : x.GetArray()) {
+
+			fs::path p = fs::absolute((i.GetString()));
+
+			if ((!fs::exists(p) || !fs::is_regular_file(p)) && forceExist) {
+				std::cout << DERROR << "Failed to find file " << p.string() << std::endl;
+				return false;
+			}
+
+			paths.push_back(p);
+
+		}
+
+	} else {
+
+		std::cout << DERROR << "Expected type Array for key '" << key << "', got " << jsonGetTypename(x) << std::endl;
+		return false;
+
+	}
+
+	return true;
+
 }
\ No newline at end of file